@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstdint>
+
+// Number of global operator new calls made by this process so far.
+std::uint64_t allocation_count();
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+// Deterministic synthetic prose for benchmarks: a few thousand made-up words drawn with
+// a Zipf distribution, broken into lines, plus word-level revisions of a document.
+namespace corpus {
+
+inline const std::vector<std::string>& vocabulary() {
+    static const std::vector<std::string> words = [] {
+        static const char* syllables[] = {"ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo", "xe", "zu",
+                                          "an", "el", "in", "or", "us", "the", "ing", "er", "ly", "ed"};
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> syllable(0, 19);
+        std::uniform_int_distribution<int> length(1, 4);
+        std::vector<std::string> result;
+        result.reserve(5000);
+        for (int i = 0; i < 5000; ++i) {
+            std::string word;
+            for (int n = length(rng); n > 0; --n) {
+                word += syllables[syllable(rng)];
+            }
+            result.push_back(word);
+        }
+        return result;
+    }();
+    return words;
+}
+
+inline const std::string& sample_word(std::mt19937& rng) {
+    static const std::discrete_distribution<std::size_t> zipf = [] {
+        std::vector<double> weights(vocabulary().size());
+        for (std::size_t rank = 0; rank < weights.size(); ++rank) {
+            weights[rank] = 1.0 / std::pow(static_cast<double>(rank + 1), 1.07);
+        }
+        return std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+    }();
+    std::discrete_distribution<std::size_t> distribution(zipf);
+    return vocabulary()[distribution(rng)];
+}
+
+inline std::string make_document(std::size_t words, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> line_length(6, 16);
+    std::string text;
+    int until_newline = line_length(rng);
+    for (std::size_t i = 0; i < words; ++i) {
+        text += sample_word(rng);
+        if (--until_newline == 0) {
+            text += '\n';
+            until_newline = line_length(rng);
+        } else {
+            text += ' ';
+        }
+    }
+    return text;
+}
+
+// Replaces, inserts or deletes roughly `edit_rate` of the words of `base`.
+inline std::string make_revision(const std::string& base, double edit_rate, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::string text;
+    std::size_t i = 0;
+    while (i < base.size()) {
+        std::size_t end = base.find_first_of(" \n", i);
+        if (end == std::string::npos) {
+            end = base.size();
+        }
+        char separator = end < base.size() ? base[end] : ' ';
+        double roll = chance(rng);
+        if (roll < edit_rate / 3) {
+            // delete
+        } else if (roll < 2 * edit_rate / 3) {
+            text += sample_word(rng);
+            text += separator;
+        } else {
+            if (roll < edit_rate) {
+                text += sample_word(rng);
+                text += ' ';
+            }
+            text.append(base, i, end - i);
+            text += separator;
+        }
+        i = end + 1;
+    }
+    return text;
+}
+
+} // namespace corpus
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// HdrHistogram-style log-linear histogram: 128 linear sub-buckets per power of two,
+// i.e. better than 1% relative precision from 1us up to ~2^40us.
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts(bucket_index(max_trackable) + 1, 0) {}
+
+    void record(std::uint64_t micros) {
+        micros = std::min(micros, max_trackable);
+        ++counts[bucket_index(micros)];
+        ++total;
+        sum += micros;
+        max_value = std::max(max_value, micros);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    std::uint64_t count() const { return total; }
+    double mean() const { return total ? static_cast<double>(sum) / total : 0.0; }
+    std::uint64_t max() const { return max_value; }
+
+    std::uint64_t percentile(double p) const {
+        if (total == 0) {
+            return 0;
+        }
+        std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * total + 0.5);
+        rank = std::clamp<std::uint64_t>(rank, 1, total);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(bucket_upper(i), max_value);
+            }
+        }
+        return max_value;
+    }
+
+    // Same layout as HdrHistogram's percentile distribution output: five ticks per halving
+    // of the remaining distance to 100%.
+    void print_distribution(std::FILE* out) const {
+        std::fprintf(out, "%12s %14s %10s %14s\n", "Value(us)", "Percentile", "TotalCount", "1/(1-Percentile)");
+        for (int tick = 0; total; ++tick) {
+            double fraction = 1.0 - std::pow(2.0, -tick / 5.0);
+            bool last = fraction * total >= total - 1;
+            if (last) {
+                fraction = 1.0;
+            }
+            std::uint64_t rank = static_cast<std::uint64_t>(fraction * total + 0.5);
+            std::fprintf(out, "%12llu %14.6f %10llu %14.2f\n", static_cast<unsigned long long>(percentile(fraction * 100.0)), fraction,
+                         static_cast<unsigned long long>(rank), last ? 0.0 : 1.0 / (1.0 - fraction));
+            if (last) {
+                break;
+            }
+        }
+        std::fprintf(out, "#[Mean = %.2f, Max = %llu, Total count = %llu]\n", mean(), static_cast<unsigned long long>(max_value),
+                     static_cast<unsigned long long>(total));
+    }
+
+private:
+    static constexpr int sub_bucket_bits = 7;
+    static constexpr std::uint64_t sub_bucket_count = 1ull << sub_bucket_bits;
+    static constexpr std::uint64_t max_trackable = 1ull << 40;
+
+    static int highest_bit(std::uint64_t value) { return 63 - __builtin_clzll(value); }
+
+    static std::size_t bucket_index(std::uint64_t value) {
+        if (value < 2 * sub_bucket_count) {
+            return value;
+        }
+        int shift = highest_bit(value) - sub_bucket_bits;
+        return 2 * sub_bucket_count + (shift - 1) * sub_bucket_count + ((value >> shift) - sub_bucket_count);
+    }
+
+    static std::uint64_t bucket_upper(std::size_t index) {
+        if (index < 2 * sub_bucket_count) {
+            return index;
+        }
+        std::size_t offset = index - 2 * sub_bucket_count;
+        int shift = static_cast<int>(offset / sub_bucket_count) + 1;
+        std::uint64_t sub = offset % sub_bucket_count + sub_bucket_count;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<std::uint64_t> counts;
+    std::uint64_t total = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max_value = 0;
+};
@@ -0,0 +1,301 @@
+// Closed-loop HTTP load generator for rest_api.
+//
+// Every connection keeps exactly one request in flight: it sends a request, waits for the
+// response, records the latency and immediately sends the next one. Requests are drawn
+// from a weighted mix of /compare (synthetic documents), /status and the static UI assets.
+//
+//   load_generator --connections=64 --threads=4 --duration=30 --keep-alive=1 --mix=compare:2,status:1,static:1 --words=500
+//
+// Other options: --host=127.0.0.1 --port=8080.
+
+#include "Corpus.h"
+#include "LatencyHistogram.h"
+
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <boost/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    int connections = 16;
+    int threads = 1;
+    int duration = 10;
+    bool keep_alive = true;
+    int words = 200;
+    std::map<std::string, int> mix = {{"compare", 1}, {"status", 1}, {"static", 1}};
+};
+
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+            throw std::invalid_argument("Unexpected argument: " + arg);
+        }
+        std::string key = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+        if (key == "host") {
+            options.host = value;
+        } else if (key == "port") {
+            options.port = value;
+        } else if (key == "connections") {
+            options.connections = std::stoi(value);
+        } else if (key == "threads") {
+            options.threads = std::stoi(value);
+        } else if (key == "duration") {
+            options.duration = std::stoi(value);
+        } else if (key == "keep-alive") {
+            options.keep_alive = value != "0" && value != "false";
+        } else if (key == "words") {
+            options.words = std::stoi(value);
+        } else if (key == "mix") {
+            options.mix.clear();
+            std::size_t start = 0;
+            while (start < value.size()) {
+                std::size_t end = value.find(',', start);
+                std::string item = value.substr(start, end == std::string::npos ? std::string::npos : end - start);
+                auto colon = item.find(':');
+                options.mix[item.substr(0, colon)] = colon == std::string::npos ? 1 : std::stoi(item.substr(colon + 1));
+                start = end == std::string::npos ? value.size() : end + 1;
+            }
+        } else {
+            throw std::invalid_argument("Unknown option: --" + key);
+        }
+    }
+    return options;
+}
+
+// Pre-built requests; workers pick one at random per iteration.
+class Workload {
+public:
+    explicit Workload(const Options& options) {
+        for (const auto& [kind, weight] : options.mix) {
+            if (kind == "compare") {
+                for (unsigned seed = 1; seed <= 8; ++seed) {
+                    std::string base = corpus::make_document(options.words, seed);
+                    boost::json::object body;
+                    body["str1"] = base;
+                    body["str2"] = corpus::make_revision(base, 0.05, seed + 100);
+                    add(http::verb::post, "/compare", boost::json::serialize(body), weight, options);
+                }
+            } else if (kind == "status") {
+                add(http::verb::get, "/status", "", weight * 8, options);
+            } else if (kind == "static") {
+                for (const char* target : {"/", "/compare/styles.css", "/compare/scripts.js", "/favicon.ico"}) {
+                    add(http::verb::get, target, "", weight * 2, options);
+                }
+            } else {
+                throw std::invalid_argument("Unknown request kind in --mix: " + kind);
+            }
+        }
+        if (requests.empty()) {
+            throw std::invalid_argument("--mix selects no requests");
+        }
+        pick = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+    }
+
+    const http::request<http::string_body>& next(std::mt19937& rng) const {
+        std::discrete_distribution<std::size_t> distribution(pick);
+        return requests[distribution(rng)];
+    }
+
+private:
+    void add(http::verb method, const char* target, std::string body, int weight, const Options& options) {
+        http::request<http::string_body> req{method, target, 11};
+        req.set(http::field::host, options.host);
+        req.set(http::field::user_agent, "rest_api load_generator");
+        req.keep_alive(options.keep_alive);
+        if (method == http::verb::post) {
+            req.set(http::field::content_type, "application/json");
+            req.body() = std::move(body);
+        }
+        req.prepare_payload();
+        requests.push_back(std::move(req));
+        weights.push_back(weight);
+    }
+
+    std::vector<http::request<http::string_body>> requests;
+    std::vector<int> weights;
+    std::discrete_distribution<std::size_t> pick;
+};
+
+struct Totals {
+    LatencyHistogram latency;
+    std::uint64_t completed = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t connects = 0;
+    std::map<unsigned, std::uint64_t> status_counts;
+};
+
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+    Connection(net::io_context& ioc, const tcp::resolver::results_type& endpoints, const Workload& workload,
+               const Options& options, Clock::time_point deadline, unsigned seed)
+        : stream(net::make_strand(ioc)), endpoints(endpoints), workload(workload), options(options), deadline(deadline), rng(seed) {}
+
+    void start() { connect(); }
+
+    const Totals& totals() const { return stats; }
+
+private:
+    void connect() {
+        if (Clock::now() >= deadline) {
+            return;
+        }
+        stream.expires_after(std::chrono::seconds(30));
+        stream.async_connect(endpoints, [self = shared_from_this()](beast::error_code ec, const tcp::endpoint&) {
+            if (ec) {
+                ++self->stats.errors;
+                return;
+            }
+            ++self->stats.connects;
+            self->stream.socket().set_option(tcp::no_delay(true));
+            self->send();
+        });
+    }
+
+    void send() {
+        if (Clock::now() >= deadline) {
+            beast::error_code ec;
+            stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+            return;
+        }
+        request = &workload.next(rng);
+        started = Clock::now();
+        stream.expires_after(std::chrono::seconds(30));
+        http::async_write(stream, *request, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) {
+                self->fail();
+                return;
+            }
+            self->receive();
+        });
+    }
+
+    void receive() {
+        response = {};
+        http::async_read(stream, buffer, response, [self = shared_from_this()](beast::error_code ec, std::size_t) {
+            if (ec) {
+                self->fail();
+                return;
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - self->started);
+            self->stats.latency.record(elapsed.count());
+            ++self->stats.completed;
+            ++self->stats.status_counts[self->response.result_int()];
+            if (self->options.keep_alive && self->response.keep_alive()) {
+                self->send();
+            } else {
+                self->reconnect();
+            }
+        });
+    }
+
+    void fail() {
+        ++stats.errors;
+        reconnect();
+    }
+
+    void reconnect() {
+        beast::error_code ec;
+        stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+        stream.close();
+        buffer.clear();
+        connect();
+    }
+
+    beast::tcp_stream stream;
+    const tcp::resolver::results_type& endpoints;
+    const Workload& workload;
+    const Options& options;
+    Clock::time_point deadline;
+    std::mt19937 rng;
+    beast::flat_buffer buffer;
+    const http::request<http::string_body>* request = nullptr;
+    http::response<http::string_body> response;
+    Clock::time_point started;
+    Totals stats;
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options options = parse_options(argc, argv);
+        Workload workload(options);
+
+        net::io_context ioc{options.threads};
+        tcp::resolver resolver(ioc);
+        const auto endpoints = resolver.resolve(options.host, options.port);
+
+        Clock::time_point begin = Clock::now();
+        Clock::time_point deadline = begin + std::chrono::seconds(options.duration);
+        std::vector<std::shared_ptr<Connection>> connections;
+        for (int i = 0; i < options.connections; ++i) {
+            connections.push_back(std::make_shared<Connection>(ioc, endpoints, workload, options, deadline, 1000 + i));
+            connections.back()->start();
+        }
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < options.threads; ++i) {
+            threads.emplace_back([&ioc] { ioc.run(); });
+        }
+        ioc.run();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        Totals totals;
+        for (const auto& connection : connections) {
+            const Totals& stats = connection->totals();
+            totals.latency.merge(stats.latency);
+            totals.completed += stats.completed;
+            totals.errors += stats.errors;
+            totals.connects += stats.connects;
+            for (const auto& [status, count] : stats.status_counts) {
+                totals.status_counts[status] += count;
+            }
+        }
+
+        std::printf("%d connections, %d threads, keep-alive %s, %.1fs\n", options.connections, options.threads,
+                    options.keep_alive ? "on" : "off", seconds);
+        std::printf("Requests: %llu completed, %llu errors, %llu connects\n", static_cast<unsigned long long>(totals.completed),
+                    static_cast<unsigned long long>(totals.errors), static_cast<unsigned long long>(totals.connects));
+        for (const auto& [status, count] : totals.status_counts) {
+            std::printf("  HTTP %u: %llu\n", status, static_cast<unsigned long long>(count));
+        }
+        std::printf("Throughput: %.1f req/s\n", totals.completed / seconds);
+        std::printf("Latency (us): p50 %llu, p90 %llu, p99 %llu, p99.9 %llu, max %llu\n\n",
+                    static_cast<unsigned long long>(totals.latency.percentile(50)),
+                    static_cast<unsigned long long>(totals.latency.percentile(90)),
+                    static_cast<unsigned long long>(totals.latency.percentile(99)),
+                    static_cast<unsigned long long>(totals.latency.percentile(99.9)),
+                    static_cast<unsigned long long>(totals.latency.max()));
+        totals.latency.print_distribution(stdout);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
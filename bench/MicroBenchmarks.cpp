@@ -0,0 +1,251 @@
+#include "AllocationCounter.h"
+#include "Corpus.h"
+#include "HandlerMemory.h"
+#include "RequestArena.h"
+#include "RestController.h"
+#include "compare/DiffSerializer.h"
+#include "compare/LongestCommonSubsequence.h"
+#include "compare/ParallelDiff.h"
+#include "compare/Similarity.h"
+#include "compare/UnifiedDiff.h"
+#include "compare/Utf8.h"
+
+#include <benchmark/benchmark.h>
+#include <boost/asio.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+#include <boost/beast.hpp>
+
+namespace {
+
+void report_allocations(benchmark::State& state, std::uint64_t before) {
+    state.counters["allocs"] = benchmark::Counter(static_cast<double>(allocation_count() - before), benchmark::Counter::kAvgIterations);
+}
+
+void BM_SplitWords(benchmark::State& state) {
+    const std::string text = corpus::make_document(state.range(0), 1);
+    LongestCommonSubsequence lcs;
+    std::uint64_t before = allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lcs.splitWords(text));
+    }
+    report_allocations(state, before);
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_SplitWords)->Arg(100)->Arg(1000)->Arg(10000);
+
+void BM_Utf8Valid(benchmark::State& state) {
+    const std::string text = corpus::make_document(state.range(0), 1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(utf8_valid(text));
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_Utf8Valid)->Arg(1000)->Arg(10000);
+
+void BM_SplitGraphemes(benchmark::State& state) {
+    const std::string text = corpus::make_document(state.range(0), 1);
+    LongestCommonSubsequence lcs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lcs.splitGraphemes(text));
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_SplitGraphemes)->Arg(100)->Arg(1000);
+
+void BM_StringDiffutil(benchmark::State& state) {
+    const std::string base = corpus::make_document(state.range(0), 1);
+    const std::string revision = corpus::make_revision(base, 0.05, 2);
+    LongestCommonSubsequence lcs;
+    const auto words1 = lcs.splitWords(base);
+    const auto words2 = lcs.splitWords(revision);
+    std::uint64_t before = allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lcs.stringDiffutil(words1, words2));
+    }
+    report_allocations(state, before);
+    state.SetItemsProcessed(state.iterations() * (words1.size() + words2.size()));
+}
+BENCHMARK(BM_StringDiffutil)->Arg(100)->Arg(500)->Arg(2000);
+
+// The /similarity kernels on the same inputs as BM_StringDiffutil.
+template <std::size_t (*Metric)(const std::pmr::vector<std::uint32_t>&, const std::pmr::vector<std::uint32_t>&, std::pmr::memory_resource*)>
+void BM_Similarity(benchmark::State& state) {
+    const std::string base = corpus::make_document(state.range(0), 1);
+    const std::string revision = corpus::make_revision(base, 0.05, 2);
+    LongestCommonSubsequence lcs;
+    const auto words1 = lcs.splitWords(base);
+    const auto words2 = lcs.splitWords(revision);
+    for (auto _ : state) {
+        RequestArena& arena = RequestArena::local();
+        RequestArena::Scope scope(arena);
+        std::pmr::vector<std::uint32_t> symbols1(&arena);
+        std::pmr::vector<std::uint32_t> symbols2(&arena);
+        encode_words(words1, words2, symbols1, symbols2, &arena);
+        benchmark::DoNotOptimize(Metric(symbols1, symbols2, &arena));
+    }
+    state.SetItemsProcessed(state.iterations() * (words1.size() + words2.size()));
+}
+BENCHMARK_TEMPLATE(BM_Similarity, lcs_length)->Name("BM_Similarity/lcs")->Arg(100)->Arg(500)->Arg(2000);
+BENCHMARK_TEMPLATE(BM_Similarity, edit_distance)->Name("BM_Similarity/edit_distance")->Arg(100)->Arg(500)->Arg(2000);
+
+// Unified diff of two revisions from their line diff, and the patch applied back.
+void BM_UnifiedDiff(benchmark::State& state) {
+    const std::string base = corpus::make_document(state.range(0), 1);
+    const std::string revision = corpus::make_revision(base, 0.05, 2);
+    LongestCommonSubsequence lcs;
+    const auto lines1 = lcs.splitLines(base);
+    const auto lines2 = lcs.splitLines(revision);
+    std::pmr::vector<std::uint32_t> symbols1;
+    std::pmr::vector<std::uint32_t> symbols2;
+    encode_words(lines1, lines2, symbols1, symbols2, std::pmr::get_default_resource());
+    std::vector<Operation> operations(lines1.size() + lines2.size());
+    std::string patch;
+    for (auto _ : state) {
+        std::size_t count = lcs.diffSymbols(symbols1.data(), symbols1.size(), symbols2.data(), symbols2.size(), operations.data());
+        patch.clear();
+        write_unified_diff(lines1, lines2, operations.data(), count, 3, patch);
+        benchmark::DoNotOptimize(patch.data());
+    }
+    state.counters["patch_bytes"] = static_cast<double>(patch.size());
+    state.counters["base_bytes"] = static_cast<double>(base.size());
+}
+BENCHMARK(BM_UnifiedDiff)->Arg(1000)->Arg(10000);
+
+void BM_ApplyPatch(benchmark::State& state) {
+    const std::string base = corpus::make_document(state.range(0), 1);
+    const std::string revision = corpus::make_revision(base, 0.05, 2);
+    LongestCommonSubsequence lcs;
+    const auto lines1 = lcs.splitLines(base);
+    const auto lines2 = lcs.splitLines(revision);
+    std::pmr::vector<std::uint32_t> symbols1;
+    std::pmr::vector<std::uint32_t> symbols2;
+    encode_words(lines1, lines2, symbols1, symbols2, std::pmr::get_default_resource());
+    std::vector<Operation> operations(lines1.size() + lines2.size());
+    std::size_t count = lcs.diffSymbols(symbols1.data(), symbols1.size(), symbols2.data(), symbols2.size(), operations.data());
+    std::string patch;
+    write_unified_diff(lines1, lines2, operations.data(), count, 3, patch);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(apply_unified_diff(base, patch));
+    }
+    state.SetBytesProcessed(state.iterations() * (base.size() + patch.size()));
+}
+BENCHMARK(BM_ApplyPatch)->Arg(1000)->Arg(10000);
+
+// Anchored diff of a 20000-word document on 1, 2, 4 and 8 threads (the caller plus helpers).
+void BM_ParallelDiff(benchmark::State& state) {
+    const std::string base = corpus::make_document(20000, 1);
+    const std::string revision = corpus::make_revision(base, 0.05, 2);
+    LongestCommonSubsequence lcs;
+    const auto words1 = lcs.splitWords(base);
+    const auto words2 = lcs.splitWords(revision);
+    std::pmr::vector<std::uint32_t> symbols1;
+    std::pmr::vector<std::uint32_t> symbols2;
+    encode_words(words1, words2, symbols1, symbols2, std::pmr::get_default_resource());
+    WorkStealingPool pool(state.range(0) - 1);
+    for (auto _ : state) {
+        RequestArena& arena = RequestArena::local();
+        RequestArena::Scope scope(arena);
+        ParallelDiff diff(pool, &arena);
+        diff.plan(symbols1, symbols2);
+        benchmark::DoNotOptimize(diff.run(words1, words2));
+    }
+    state.SetItemsProcessed(state.iterations() * (words1.size() + words2.size()));
+}
+BENCHMARK(BM_ParallelDiff)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+// Whole /compare pipeline (tokenize, diff, JSON) with the global heap vs. the request arena.
+void BM_CompareDefaultHeap(benchmark::State& state) {
+    const std::string base = corpus::make_document(state.range(0), 1);
+    const std::string revision = corpus::make_revision(base, 0.05, 2);
+    std::string body;
+    std::uint64_t before = allocation_count();
+    for (auto _ : state) {
+        LongestCommonSubsequence lcs;
+        body.clear();
+        serialize_diffs(lcs.stringDiff(base, revision), body);
+        benchmark::DoNotOptimize(body.data());
+    }
+    report_allocations(state, before);
+}
+BENCHMARK(BM_CompareDefaultHeap)->Arg(100)->Arg(500);
+
+void BM_CompareArena(benchmark::State& state) {
+    const std::string base = corpus::make_document(state.range(0), 1);
+    const std::string revision = corpus::make_revision(base, 0.05, 2);
+    std::string body;
+    std::uint64_t before = allocation_count();
+    for (auto _ : state) {
+        RequestArena& arena = RequestArena::local();
+        RequestArena::Scope scope(arena);
+        LongestCommonSubsequence lcs(&arena);
+        body.clear();
+        serialize_diffs(lcs.stringDiff(base, revision), body, arena.json_storage());
+        benchmark::DoNotOptimize(body.data());
+    }
+    report_allocations(state, before);
+}
+BENCHMARK(BM_CompareArena)->Arg(100)->Arg(500);
+
+void BM_SerializeDiffs(benchmark::State& state) {
+    const std::string base = corpus::make_document(state.range(0), 1);
+    const std::string revision = corpus::make_revision(base, 0.05, 2);
+    LongestCommonSubsequence lcs;
+    const auto diffs = lcs.stringDiff(base, revision);
+    std::string body;
+    for (auto _ : state) {
+        body.clear();
+        serialize_diffs(diffs, body);
+        benchmark::DoNotOptimize(body.data());
+    }
+    state.SetBytesProcessed(state.iterations() * body.size());
+}
+BENCHMARK(BM_SerializeDiffs)->Arg(100)->Arg(1000);
+
+void BM_GetMimeType(benchmark::State& state) {
+    static const char* paths[] = {"/index.html", "/compare/styles.css", "/compare/scripts.js", "/favicon.ico",
+                                  "/images/logo.png", "/compare", "/status", "/api/hello", "/docs/report.JSON"};
+    auto controller = RestController::getInstance();
+    std::size_t i = 0;
+    std::uint64_t before = allocation_count();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(controller->get_mime_type(paths[i++ % std::size(paths)]));
+    }
+    report_allocations(state, before);
+}
+BENCHMARK(BM_GetMimeType);
+
+// A callback-style read: Beast parses one request from a socket pair, with and without
+// HandlerMemory. The allocs counter is the saving from HandlerMemory.
+template <bool CustomAlloc>
+void BM_HttpAsyncRead(benchmark::State& state) {
+    boost::asio::io_context ioc;
+    boost::asio::local::stream_protocol::socket client(ioc);
+    boost::asio::local::stream_protocol::socket server(ioc);
+    boost::asio::local::connect_pair(client, server);
+    const std::string request = "GET /status HTTP/1.1\r\nHost: localhost\r\nUser-Agent: bench\r\n\r\n";
+    boost::beast::flat_buffer buffer;
+    HandlerMemory memory;
+
+    std::uint64_t before = allocation_count();
+    for (auto _ : state) {
+        boost::asio::write(client, boost::asio::buffer(request));
+        boost::beast::http::request<boost::beast::http::string_body> req;
+        auto on_read = [](boost::beast::error_code ec, std::size_t) {
+            if (ec) {
+                throw boost::system::system_error(ec);
+            }
+        };
+        if constexpr (CustomAlloc) {
+            boost::beast::http::async_read(server, buffer, req, make_custom_alloc_handler(memory, on_read));
+        } else {
+            boost::beast::http::async_read(server, buffer, req, on_read);
+        }
+        ioc.restart();
+        ioc.run();
+    }
+    report_allocations(state, before);
+}
+BENCHMARK_TEMPLATE(BM_HttpAsyncRead, false)->Name("BM_HttpAsyncRead/default_allocator");
+BENCHMARK_TEMPLATE(BM_HttpAsyncRead, true)->Name("BM_HttpAsyncRead/handler_memory");
+
+} // namespace
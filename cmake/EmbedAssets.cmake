@@ -0,0 +1,102 @@
+# Generates a C++ source file holding every file under ASSET_DIR as a constexpr table of
+# EmbeddedAsset entries (see include/EmbeddedAssets.h), sorted by path. Each entry carries
+# its mime type, a strong ETag derived from the SHA-1 of the content, and a gzip variant
+# when compression makes the file smaller.
+#
+#   cmake -DASSET_DIR=<dir> -DOUTPUT=<file.cpp> -DWORK_DIR=<scratch dir> -P EmbedAssets.cmake
+#
+# An empty ASSET_DIR produces an empty table.
+
+set(mime_types
+    ".htm=text/html" ".html=text/html" ".php=text/html" ".css=text/css" ".txt=text/plain"
+    ".js=application/javascript" ".json=application/json" ".xml=application/xml"
+    ".swf=application/x-shockwave-flash" ".flv=video/x-flv" ".png=image/png"
+    ".jpe=image/jpeg" ".jpeg=image/jpeg" ".jpg=image/jpeg" ".gif=image/gif" ".bmp=image/bmp"
+    ".ico=image/vnd.microsoft.icon" ".tiff=image/tiff" ".tif=image/tiff"
+    ".svg=image/svg+xml" ".svgz=image/svg+xml")
+
+# Writes the bytes of `file` into `out_var` as adjacent string literals of hex escapes.
+function(to_literal file out_var)
+    file(READ "${file}" hex HEX)
+    if(hex STREQUAL "")
+        set(${out_var} "\"\"" PARENT_SCOPE)
+        return()
+    endif()
+    # 16 bytes per line; CMake regexes have no {n} repetition.
+    string(REPEAT "[0-9a-f]" 32 line)
+    string(REGEX REPLACE "(${line})" "\\1\"\n        \"" hex "${hex}")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "\\\\x\\1" hex "${hex}")
+    string(REGEX REPLACE "\"\n        \"$" "" hex "${hex}")
+    set(${out_var} "\"${hex}\"" PARENT_SCOPE)
+endfunction()
+
+set(files "")
+if(ASSET_DIR)
+    file(GLOB_RECURSE files RELATIVE "${ASSET_DIR}" "${ASSET_DIR}/*")
+    list(SORT files)
+endif()
+
+set(entries "")
+foreach(relative IN LISTS files)
+    set(path "${ASSET_DIR}/${relative}")
+    file(SIZE "${path}" size)
+    file(SHA1 "${path}" sha1)
+    string(SUBSTRING "${sha1}" 0 20 etag)
+
+    get_filename_component(extension "${relative}" LAST_EXT)
+    string(TOLOWER "${extension}" extension)
+    set(mime "application/octet-stream")
+    foreach(pair IN LISTS mime_types)
+        if(pair MATCHES "^${extension}=(.*)$")
+            set(mime "${CMAKE_MATCH_1}")
+        endif()
+    endforeach()
+
+    to_literal("${path}" data)
+
+    set(gzip "{}")
+    set(gzip_path "${WORK_DIR}/${relative}.gz")
+    get_filename_component(gzip_dir "${gzip_path}" DIRECTORY)
+    file(MAKE_DIRECTORY "${gzip_dir}")
+    file(ARCHIVE_CREATE OUTPUT "${gzip_path}" PATHS "${path}" FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)
+    file(SIZE "${gzip_path}" gzip_size)
+    if(gzip_size LESS size)
+        to_literal("${gzip_path}" gzip_data)
+        set(gzip "std::string_view(${gzip_data}, ${gzip_size})")
+    endif()
+
+    string(APPEND entries
+        "    {\"/${relative}\", \"${mime}\", \"\\\"${etag}\\\"\", \"\\\"${etag}-gz\\\"\",\n"
+        "     std::string_view(${data}, ${size}),\n"
+        "     ${gzip}},\n")
+endforeach()
+
+if(entries STREQUAL "")
+    set(table "constexpr const EmbeddedAsset* assets = nullptr;\nconstexpr std::size_t asset_count = 0;")
+else()
+    set(table "constexpr EmbeddedAsset assets[] = {\n${entries}};\nconstexpr std::size_t asset_count = std::size(assets);")
+endif()
+
+file(CONFIGURE OUTPUT "${OUTPUT}" @ONLY CONTENT [=[
+// Generated by cmake/EmbedAssets.cmake. Do not edit.
+#include "EmbeddedAssets.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+@table@
+
+} // namespace
+
+const EmbeddedAsset* find_embedded_asset(std::string_view path) {
+    const EmbeddedAsset* end = assets + asset_count;
+    const EmbeddedAsset* iter = std::lower_bound(assets, end, path, [](const EmbeddedAsset& asset, std::string_view key) { return asset.path < key; });
+    return iter != end && iter->path == path ? iter : nullptr;
+}
+
+std::size_t embedded_asset_count() {
+    return asset_count;
+}
+]=])
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Server.h"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class LogLevel { error, warn, info, debug };
+
+// Server settings. Each setting has a dotted key ("timeouts.idle_ms") and is read from, in
+// increasing precedence: the built-in defaults, a JSON file (nested objects form the key),
+// REST_API_<KEY> environment variables (dots become underscores, e.g.
+// REST_API_TIMEOUTS_IDLE_MS) and --key=value flags. The file is named by --config or
+// REST_API_CONFIG.
+struct Config {
+    struct Compare {
+        std::size_t body_limit = 1024 * 1024;
+        // The diff is quadratic, so both the token counts and the DP table are capped.
+        std::size_t max_tokens = 20000;
+        std::size_t max_cells = 16 * 1024 * 1024;
+        // Inputs of at least parallel_cells (words1 x words2) are split at unique common
+        // words and diffed on `threads` threads (0: one per core); max_cells then applies to
+        // the segments.
+        std::size_t parallel_cells = 1024 * 1024;
+        std::size_t threads = 0;
+    };
+
+    struct Documents {
+        // Memory for documents stored with POST /documents, least recently used evicted first.
+        std::size_t max_bytes = 64 * 1024 * 1024;
+    };
+
+    struct Index {
+        // Documents added with POST /index; further adds are refused.
+        std::size_t max_documents = 10000;
+    };
+
+    struct Sessions {
+        std::size_t shards = 64;
+        std::chrono::seconds ttl{30 * 60};
+        std::string data_dir; // Empty keeps sessions in memory only
+    };
+
+    int port = 8080; // This port should match with the port in the Dockerfile
+    int threads = 1;
+    std::string default_target = "/compare/index.html";
+    std::string ui_prefix = "./ui";
+    std::string mime_types_file;
+    LogLevel log_level = LogLevel::info;
+    std::size_t header_limit = 8 * 1024;
+    std::size_t body_limit = 16 * 1024;
+    std::size_t arena_max_retained = 8 * 1024 * 1024;
+    // How long SIGTERM or a hot restart waits for open connections before closing them.
+    std::chrono::milliseconds drain_timeout{30000};
+    ServerOptions server;
+    Compare compare;
+    Documents documents;
+    Index index;
+    Sessions sessions;
+
+    // The command line, kept so a reload sees the same flags.
+    std::vector<std::string> arguments;
+
+    // Throws std::runtime_error on unknown keys and malformed values.
+    static Config load(int argc, char* argv[]);
+    static Config load(const std::vector<std::string>& arguments);
+
+    // The configuration in effect; replaced as a whole on reload.
+    static std::shared_ptr<const Config> current();
+    static void set_current(std::shared_ptr<const Config> config);
+
+    static bool log_enabled(LogLevel level);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <boost/asio/ip/address.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+// Admission control for accepted connections: a global cap and a per-client-address cap.
+// When the global cap is reached the server stops accepting; release() calls the resume
+// callback once a slot frees up, so excess clients wait in the kernel's listen backlog.
+class ConnectionLimiter {
+public:
+    struct Stats {
+        std::size_t active = 0;
+        std::uint64_t accepted = 0;
+        std::uint64_t rejected_per_ip = 0;
+        std::uint64_t rejected_full = 0; // Accepted while at the global cap (after a reload lowered it)
+    };
+
+    ConnectionLimiter(std::size_t max_connections, std::size_t max_connections_per_ip)
+        : max_connections(max_connections), max_connections_per_ip(max_connections_per_ip) {}
+
+    bool has_capacity() const;
+    // Connections that can still be admitted under the global cap.
+    std::size_t available() const;
+    // False if either cap is reached; the caller closes the connection.
+    bool try_acquire(const boost::asio::ip::address& address);
+    void release(const boost::asio::ip::address& address);
+
+    void on_capacity_available(std::function<void()> callback);
+    // New caps apply to the next admission; existing connections are kept.
+    void set_limits(std::size_t max_connections, std::size_t max_connections_per_ip);
+
+    Stats stats() const;
+
+private:
+    struct AddressHash {
+        std::size_t operator()(const boost::asio::ip::address& address) const;
+    };
+
+    std::size_t max_connections;
+    std::size_t max_connections_per_ip;
+    mutable std::mutex mtx;
+    std::unordered_map<boost::asio::ip::address, std::size_t, AddressHash> per_ip;
+    std::function<void()> resume;
+    Stats counters;
+};
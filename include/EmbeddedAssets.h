@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// A UI file compiled into the binary by cmake/EmbedAssets.cmake. `gzip` is empty when
+// compression would not make the file smaller; each representation has its own ETag.
+struct EmbeddedAsset {
+    std::string_view path;
+    std::string_view mime_type;
+    std::string_view etag;
+    std::string_view gzip_etag;
+    std::string_view data;
+    std::string_view gzip;
+};
+
+// Looks up an asset by request path, e.g. "/compare/index.html".
+const EmbeddedAsset* find_embedded_asset(std::string_view path);
+std::size_t embedded_asset_count();
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Per-connection storage for the state of callback-style Asio operations, after Asio's
+// allocation example. Http2Session and WebSocketSession have at most a read and a write in
+// flight, so two slots cover the hot path; anything larger or concurrent falls back to the
+// global heap. Session's coroutines do not need it: Asio recycles their frames per thread.
+class HandlerMemory {
+public:
+    HandlerMemory() = default;
+    HandlerMemory(const HandlerMemory&) = delete;
+    HandlerMemory& operator=(const HandlerMemory&) = delete;
+
+    void* allocate(std::size_t size) {
+        for (Slot& slot : slots) {
+            if (!slot.in_use && size <= sizeof(slot.storage)) {
+                slot.in_use = true;
+                return &slot.storage;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* pointer) {
+        for (Slot& slot : slots) {
+            if (pointer == &slot.storage) {
+                slot.in_use = false;
+                return;
+            }
+        }
+        ::operator delete(pointer);
+    }
+
+private:
+    struct Slot {
+        alignas(std::max_align_t) unsigned char storage[1024];
+        bool in_use = false;
+    };
+
+    std::array<Slot, 2> slots;
+};
+
+template <class T>
+class HandlerAllocator {
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(HandlerMemory& memory) : memory(&memory) {}
+
+    template <class U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory(other.memory) {}
+
+    T* allocate(std::size_t n) const { return static_cast<T*>(memory->allocate(sizeof(T) * n)); }
+    void deallocate(T* pointer, std::size_t) const { memory->deallocate(pointer); }
+
+    template <class U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept { return memory == other.memory; }
+    template <class U>
+    bool operator!=(const HandlerAllocator<U>& other) const noexcept { return memory != other.memory; }
+
+private:
+    template <class U>
+    friend class HandlerAllocator;
+
+    HandlerMemory* memory;
+};
+
+// Wraps a completion handler so Asio picks up HandlerAllocator as its associated allocator.
+template <class Handler>
+class CustomAllocHandler {
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    CustomAllocHandler(HandlerMemory& memory, Handler handler) : memory(memory), handler(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(memory); }
+
+    template <class... Args>
+    void operator()(Args&&... args) {
+        handler(std::forward<Args>(args)...);
+    }
+
+private:
+    HandlerMemory& memory;
+    Handler handler;
+};
+
+template <class Handler>
+CustomAllocHandler<std::decay_t<Handler>> make_custom_alloc_handler(HandlerMemory& memory, Handler&& handler) {
+    return CustomAllocHandler<std::decay_t<Handler>>(memory, std::forward<Handler>(handler));
+}
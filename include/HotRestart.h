@@ -0,0 +1,28 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Zero-downtime restart by handing the listening socket to a new process. The socket is
+// passed the way systemd socket activation does it (fd 3, LISTEN_FDS=1, LISTEN_PID), so
+// the same code also lets systemd own the socket. The new process reports that it is
+// serving through a pipe (REST_API_READY_FD); only then does the old one drain and exit.
+// Connections that arrive meanwhile wait in the shared listen backlog.
+class HotRestart {
+public:
+    // The listening socket passed in by a previous process or systemd, if any. Checked
+    // once; later calls return the same answer.
+    static std::optional<int> inherited_listener();
+
+    // Tells the process that started this one that it is accepting connections.
+    static void notify_ready();
+
+    // Starts a new copy of this executable with `arguments`, handing it `listen_fd`.
+    // `on_done` runs on `ioc` with true once the new process is ready, or false if it
+    // could not be started or exited first.
+    static void spawn(boost::asio::io_context& ioc, int listen_fd, const std::vector<std::string>& arguments,
+                      std::function<void(bool ready)> on_done);
+};
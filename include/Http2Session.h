@@ -0,0 +1,76 @@
+#pragma once
+
+#include "HandlerMemory.h"
+#include "Session.h"
+#include "TimerWheel.h"
+#include <array>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/http.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+struct nghttp2_session;
+
+// Cleartext HTTP/2 (h2c) on a connection taken over from a Session, either after the
+// client's connection preface (prior knowledge) or after "Upgrade: h2c". nghttp2 does the
+// framing, HPACK and flow control; every stream is dispatched to RestController like an
+// HTTP/1.1 request. Handlers run on the io_context, so the streams of one connection are
+// served in parallel; all nghttp2 calls happen on the connection's strand.
+class Http2Session : public std::enable_shared_from_this<Http2Session>, private TimerWheel::Entry {
+public:
+    using Request = boost::beast::http::request<boost::beast::http::string_body>;
+
+    // The client preface up to the first empty line; Beast's parser stops there with
+    // http::error::bad_version.
+    static constexpr std::string_view preface_head = "PRI * HTTP/2.0\r\n\r\n";
+
+    // `owner` (the Session the connection came from, which holds its connection slot) is
+    // kept alive until the connection closes.
+    Http2Session(boost::asio::ip::tcp::socket socket, std::shared_ptr<void> owner, TimerWheel& wheel, const Session::Timeouts& timeouts);
+    ~Http2Session();
+
+    // The decoded HTTP2-Settings of a request that asks to upgrade to h2c, if it does so
+    // the way RFC 7540 requires.
+    static std::optional<std::string> upgrade_settings(const Request& req);
+
+    // `received` is what has already been read from the socket, starting with the preface.
+    void start(std::string_view received);
+    // After "101 Switching Protocols": `req` is answered as stream 1.
+    void start_upgraded(Request req, std::string_view settings, std::string_view received);
+
+    // Callable from any thread: drain() sends GOAWAY and closes once the open streams are
+    // answered; close() closes now.
+    void drain();
+    void close();
+
+private:
+    struct Stream;
+    struct Callbacks;
+
+    bool init(const std::string* upgrade_settings);
+    bool receive(const char* data, std::size_t size);
+    void read();
+    void write();
+    void dispatch(std::int32_t stream_id);
+    void submit_response(std::int32_t stream_id, Stream& stream);
+    void update_timeout();
+
+    std::shared_ptr<void> lock_owner() override;
+    void on_timeout() override;
+
+    boost::asio::ip::tcp::socket socket_;
+    std::shared_ptr<void> owner_;
+    TimerWheel& wheel_;
+    Session::Timeouts timeouts_;
+    nghttp2_session* session_ = nullptr;
+    std::unordered_map<std::int32_t, std::shared_ptr<Stream>> streams_;
+    std::array<char, 16 * 1024> read_buffer_;
+    std::string write_buffer_;
+    HandlerMemory handler_memory_;
+    bool writing_ = false;
+    bool closed_ = false;
+};
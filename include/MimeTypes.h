@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Maps file extensions to mime types without allocating. The built-in types live in a
+// perfect hash table computed at compile time; extensions are matched case-insensitively.
+class MimeTypes {
+public:
+    // Mime type for the extension of `path`, or an empty view if it is unknown.
+    static std::string_view find(std::string_view path);
+
+    // Adds or replaces mappings from a file in mime.types format: a mime type followed by
+    // its extensions, one type per line, '#' starting a comment. Loaded types take
+    // precedence over the built-in ones. Call at startup, before serving requests.
+    // Returns the number of extensions read.
+    static std::size_t load(const std::string& file_path);
+};
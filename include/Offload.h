@@ -0,0 +1,56 @@
+#pragma once
+
+#include "WorkStealingPool.h"
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/execution/outstanding_work.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/prefer.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Runs `task` on a worker of `pool` and resumes the awaiting coroutine on its own executor
+// (the connection's strand) when it is done, so a coroutine handler can hand CPU-heavy work
+// to the pool without holding up the I/O thread. `task` runs on another thread, so it must
+// not touch the awaiting thread's RequestArena.
+inline boost::asio::awaitable<void> offload_task(WorkStealingPool& pool, std::function<void()> task) {
+    co_await boost::asio::async_initiate<decltype(boost::asio::use_awaitable), void(std::exception_ptr)>(
+        [&pool](auto handler, std::function<void()> task) {
+            // Tracked, so the io_context keeps running while the task does.
+            auto executor = boost::asio::prefer(boost::asio::get_associated_executor(handler), boost::asio::execution::outstanding_work.tracked);
+            // The completion handler is move-only and the pool takes std::function.
+            auto shared = std::make_shared<decltype(handler)>(std::move(handler));
+            pool.post([shared, task = std::move(task), executor]() mutable {
+                std::exception_ptr error;
+                try {
+                    task();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                // Nothing of the connection's is left on the worker once the completion is posted.
+                auto target = std::move(executor);
+                boost::asio::post(target, [shared = std::move(shared), error]() { std::move(*shared)(error); });
+            });
+        },
+        boost::asio::use_awaitable, std::move(task));
+}
+
+// co_await offload(pool, function) returns what function() returns, or rethrows what it threw.
+template <class Function>
+boost::asio::awaitable<std::invoke_result_t<Function&>> offload(WorkStealingPool& pool, Function function) {
+    using Result = std::invoke_result_t<Function&>;
+    // The coroutine is suspended until the task is done, so the task can refer to its locals.
+    if constexpr (std::is_void_v<Result>) {
+        co_await offload_task(pool, [&function]() { function(); });
+    } else {
+        std::optional<Result> result;
+        co_await offload_task(pool, [&function, &result]() { result.emplace(function()); });
+        co_return std::move(*result);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <boost/json.hpp>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Per-worker bump allocator for request scratch memory. Blocks are kept across
+// requests and reused after reset(), so a warmed-up worker serves requests without
+// touching the global heap. Only the memory above max_retained is given back.
+class RequestArena : public std::pmr::memory_resource {
+public:
+    class Scope {
+    public:
+        explicit Scope(RequestArena& arena) : arena(arena) {}
+        ~Scope() { arena.reset(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        RequestArena& arena;
+    };
+
+    explicit RequestArena(std::size_t block_size = 64 * 1024, std::size_t max_retained = 8 * 1024 * 1024);
+
+    // The calling thread's arena; its max_retained follows set_local_max_retained().
+    static RequestArena& local();
+    static void set_local_max_retained(std::size_t bytes);
+
+    void reset();
+
+    boost::json::storage_ptr json_storage() { return boost::json::storage_ptr(&json_resource); }
+
+    std::size_t bytes_reserved() const { return reserved; }
+
+private:
+    // Boost.JSON uses boost::container::pmr, so the arena is exposed to it through an adapter.
+    class JsonResource : public boost::json::memory_resource {
+    public:
+        explicit JsonResource(RequestArena& arena) : arena(arena) {}
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override { return arena.allocate(bytes, alignment); }
+        void do_deallocate(void*, std::size_t, std::size_t) override {}
+        bool do_is_equal(const boost::json::memory_resource& other) const noexcept override { return this == &other; }
+
+        RequestArena& arena;
+    };
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    std::vector<Block> blocks;
+    std::size_t current = 0;
+    std::size_t offset = 0;
+    std::size_t reserved = 0;
+    std::size_t block_size;
+    std::size_t max_retained;
+    JsonResource json_resource{*this};
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <boost/beast/http.hpp>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Writes HTTP/1.1 response headers without going through Beast's serializer. Headers
+// that are the same for every response of a route are serialized once into a template;
+// only the status line, the fields a handler set, Date and Content-Length are written
+// per response.
+class ResponseHeaders {
+public:
+    using Response = boost::beast::http::response<boost::beast::http::string_body>;
+    using FieldList = std::vector<std::pair<boost::beast::http::field, std::string>>;
+
+    // Serialized fields, and the field of each line for finding the ones a response overrides.
+    struct Template {
+        std::string text;                              // "Name: value\r\n" lines
+        std::vector<boost::beast::http::field> fields; // One per line, in order
+    };
+
+    // Template for `fields`. A field listed more than once keeps its last value, so a route's
+    // own fields can follow the common ones and replace them.
+    static Template make_template(const FieldList& fields);
+
+    // Appends the complete header block of `res` to `out`, with `static_headers` after the
+    // status line. Template fields that `res` also sets are left out, so the handler's value
+    // wins. Content-Length is taken from the body, so the response doesn't need
+    // prepare_payload(); a `chunked` response gets Transfer-Encoding instead.
+    static void serialize(const Response& res, const Template& static_headers, std::string& out, bool chunked = false);
+
+    // True if `res` sets any field of `static_headers`. One pass over the few fields of `res`;
+    // when it is false, the template is sent as it is.
+    static bool overlaps(const Response& res, const Template& static_headers);
+
+    // "Date: ...\r\n" for the current second, cached per thread.
+    static std::string_view date();
+};
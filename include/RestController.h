@@ -1,21 +1,102 @@
 #pragma once
 
+#include "Config.h"
+#include "EmbeddedAssets.h"
+#include "ResponseHeaders.h"
+#include "Server.h"
+#include "WebSocketSession.h"
+#include <atomic>
+#include <boost/asio/awaitable.hpp>
 #include <boost/beast/http.hpp>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 using BoostRequest = boost::beast::http::request<boost::beast::http::string_body>;
 using BoostResponse = boost::beast::http::response<boost::beast::http::string_body>;
-using HttpHandler = std::function<void(const BoostRequest&, BoostResponse&)>;
 using Method = boost::beast::http::verb;
 
+// Lets a coroutine handler send the body in pieces as it is produced. The first write()
+// sends the status and header fields of the response as they are at that point; later
+// changes to them are ignored. What is left in res.body() when the handler returns goes
+// last. write() throws if the connection fails. HTTP/1.1 sends the pieces as chunks; over
+// HTTP/1.0 and HTTP/2, and for HEAD requests and 1xx, 204 and 304 responses, which have no
+// body, they are collected and sent (or dropped) with the rest of the response.
+class ResponseStream {
+public:
+    virtual ~ResponseStream() = default;
+    virtual boost::asio::awaitable<void> write(std::string_view data) = 0;
+};
+
+// A route's handler: the callable and a plain function pointer that calls it, in place of
+// std::function. A handler is either synchronous, void(const BoostRequest&, BoostResponse&),
+// or a coroutine, boost::asio::awaitable<void>(const BoostRequest&, BoostResponse&,
+// ResponseStream&), which the connection awaits on its strand without blocking the I/O
+// thread (see offload() in Offload.h for CPU-heavy work). A coroutine may resume on another
+// thread, so it must not hold RequestArena::local() across a co_await.
+class RouteHandler {
+public:
+    template <class Handler>
+    explicit RouteHandler(Handler handler) : callable(std::make_shared<const Handler>(std::move(handler))) {
+        if constexpr (std::is_invocable_r_v<boost::asio::awaitable<void>, const Handler&, const BoostRequest&, BoostResponse&, ResponseStream&>) {
+            async_call = [](const void* callable, const BoostRequest& req, BoostResponse& res, ResponseStream& stream) {
+                return (*static_cast<const Handler*>(callable))(req, res, stream);
+            };
+        } else {
+            sync_call = [](const void* callable, const BoostRequest& req, BoostResponse& res) { (*static_cast<const Handler*>(callable))(req, res); };
+        }
+    }
+
+    bool is_async() const { return async_call != nullptr; }
+    void operator()(const BoostRequest& req, BoostResponse& res) const { sync_call(callable.get(), req, res); }
+    boost::asio::awaitable<void> async(const BoostRequest& req, BoostResponse& res, ResponseStream& stream) const {
+        return async_call(callable.get(), req, res, stream);
+    }
+
+private:
+    std::shared_ptr<const void> callable;
+    void (*sync_call)(const void*, const BoostRequest&, BoostResponse&) = nullptr;
+    boost::asio::awaitable<void> (*async_call)(const void*, const BoostRequest&, BoostResponse&, ResponseStream&) = nullptr;
+};
+
 class RestController {
 private:
+    struct Route {
+        RouteHandler handler;
+        std::size_t body_limit;
+        ResponseHeaders::FieldList fields;
+        ResponseHeaders::Template headers; // Common headers plus `fields`, serialized.
+    };
+
     static std::string defaultTarget;
     static std::shared_ptr<RestController> instance;
     static std::mutex mtx;
-    std::unordered_map<Method, std::unordered_map<std::string, HttpHandler>> routes;
+    std::unordered_map<Method, std::unordered_map<std::string, Route>> routes;
+    std::unordered_map<std::string, WebSocketRoute> websocket_routes;
+    std::string ui_prefix_ = "./ui";
+    // Read by every Session, updated on reload.
+    std::atomic<std::size_t> header_limit_{8 * 1024};
+    std::atomic<std::size_t> default_body_limit_{16 * 1024};
+    ResponseHeaders::Template default_headers_;
+    ResponseHeaders::Template preflight_headers_;
+    std::vector<std::function<void(bool handing_over)>> restart_hooks;
+
+    void prepare_response(BoostResponse& res);
+    void build_header_templates();
+    void reload(Server& server);
+    // Stops accepting, lets open connections finish for up to drain_timeout, then stops ioc.
+    void stop_gracefully(boost::asio::io_context& ioc, const std::shared_ptr<Server>& server);
+
+    // Serves an embedded UI file, gzipped when the client accepts it, or 304 on a matching If-None-Match.
+    void serve_asset(const EmbeddedAsset& asset, const BoostRequest& req, BoostResponse& res);
+    static bool accepts_gzip(std::string_view accept_encoding);
+    static bool etag_matches(std::string_view if_none_match, std::string_view etag);
 
 public:
     static std::shared_ptr<RestController> getInstance(std::string target = "") {
@@ -27,13 +108,70 @@ public:
         return instance;
     }
 
-    void start_server(const int& port, const int& num_threads);
+    // Runs the server with `config` (also made Config::current()) until the io_context
+    // stops. SIGHUP reloads the configuration and applies what can change at runtime.
+    // SIGTERM and SIGINT drain and exit; SIGUSR2 hands the listener to a new process first.
+    void start_server(const Config& config);
+
+    // Runs `hook(true)` before SIGUSR2 starts a new process, which recovers its state on
+    // startup, and `hook(false)` if that process fails. Add hooks before the server starts.
+    void add_restart_hook(std::function<void(bool handing_over)> hook) { restart_hooks.push_back(std::move(hook)); }
+
+    // Static files are looked up under ui_prefix; "/" serves default_target.
+    void set_static_files(const std::string& default_target, const std::string& ui_prefix) {
+        defaultTarget = default_target;
+        ui_prefix_ = ui_prefix;
+    }
+
+    // body_limit of 0 means default_body_limit(). `headers` are sent with every response of
+    // the route, unless the handler sets the same field, whose value then replaces it.
+    // `handler` is anything RouteHandler takes. Add routes before the server starts.
+    template <class Handler>
+    void add_routes(const Method& method, const std::string& target, Handler handler, std::size_t body_limit = 0,
+                    const ResponseHeaders::FieldList& headers = {}) {
+        add_route(method, target, RouteHandler(std::move(handler)), body_limit, headers);
+    }
+    void add_route(const Method& method, const std::string& target, RouteHandler handler, std::size_t body_limit, const ResponseHeaders::FieldList& headers);
 
-    void add_routes(const Method& method, const std::string& target, const HttpHandler& handler);
+    // WebSocket upgrade requests for `target` get a handler from `factory` for the life of
+    // the connection. message_limit of 0 means default_body_limit(). Add routes before the
+    // server starts.
+    void add_websocket_route(const std::string& target, WebSocketHandlerFactory factory, std::size_t message_limit = 0);
+    // The route for an upgrade request to `target`, or nullptr.
+    const WebSocketRoute* websocket_route(std::string_view target) const;
 
-    void handle_request(const BoostRequest& req, BoostResponse& res);
+    // What handle_request() did: the serialized static headers to send with the response,
+    // and the route's coroutine handler if it still has to be awaited to fill the response.
+    struct Dispatch {
+        const ResponseHeaders::Template* headers;
+        const RouteHandler* pending = nullptr;
+    };
+
+    // Fills `res`, except that a coroutine handler is returned in Dispatch::pending instead
+    // of run, for the caller to await with co_await pending->async(req, res, stream). A
+    // synchronous handler that throws gets a 500 (see handler_error()).
+    Dispatch handle_request(const BoostRequest& req, BoostResponse& res);
+
+    // Replaces what a handler that threw `error` left in `res` with a 500, keeping the
+    // keep-alive flag and the body's capacity. Returns the static headers to send with it.
+    const ResponseHeaders::Template& handler_error(const std::exception& error, BoostResponse& res);
+
+    // Static headers for responses built outside handle_request, such as error_response().
+    const ResponseHeaders::Template& default_headers() const { return default_headers_; }
+
+    void error_response(boost::beast::http::status status, std::string_view message, BoostResponse& res);
+
+    // Request size limits, checked by Session while the request is being read.
+    void set_limits(std::size_t header_limit, std::size_t default_body_limit) {
+        header_limit_.store(header_limit, std::memory_order_relaxed);
+        default_body_limit_.store(default_body_limit, std::memory_order_relaxed);
+    }
+    std::size_t header_limit() const { return header_limit_.load(std::memory_order_relaxed); }
+    std::size_t default_body_limit() const { return default_body_limit_.load(std::memory_order_relaxed); }
+    std::size_t body_limit(Method method, std::string_view target) const;
 
     std::string read_file(const std::string& path);
 
-    std::string get_mime_type(const std::string& path);
+    // Mime type of a static file path, or application/octet-stream.
+    std::string_view get_mime_type(std::string_view path);
 };
@@ -1,13 +1,72 @@
 #pragma once
 
+#include "ConnectionLimiter.h"
+#include "Session.h"
+#include "SessionPool.h"
+#include "TimerWheel.h"
+#include <atomic>
 #include <boost/asio.hpp>
+#include <chrono>
+#include <memory>
+
+struct ServerOptions {
+    int backlog = boost::asio::socket_base::max_listen_connections;
+    std::size_t max_connections = 10000;
+    std::size_t max_connections_per_ip = 256;
+    bool tcp_nodelay = true;
+    int defer_accept_seconds = 0; // TCP_DEFER_ACCEPT; 0 disables
+    int fastopen_queue = 0;       // TCP_FASTOPEN queue length; 0 disables
+    int receive_buffer_size = 0;  // SO_RCVBUF; 0 keeps the OS default
+    int send_buffer_size = 0;     // SO_SNDBUF; 0 keeps the OS default
+    std::chrono::milliseconds accept_retry_delay{100};
+    // Accepts kept posted at once, at most as many as there are free connection slots, so a
+    // burst of connections does not wait for one accept per wakeup.
+    std::size_t accepts_in_flight = 1;
+    Session::Timeouts timeouts;
+    SessionPool::Limits session_pool;
+    int listen_fd = -1; // Adopt this already listening socket instead of binding one
+};
 
 class Server {
 public:
-    Server(boost::asio::io_context& ioc, boost::asio::ip::tcp::endpoint endpoint);
+    Server(boost::asio::io_context& ioc, boost::asio::ip::tcp::endpoint endpoint, const ServerOptions& options = ServerOptions());
+    ~Server();
+
+    SessionPool::Stats session_pool_stats() const { return session_pool->stats(); }
+    ConnectionLimiter::Stats connection_stats() const { return connection_limiter->stats(); }
+    std::uint64_t accept_pauses() const { return accept_pause_count.load(); }
+
+    // Applies the connection caps, timeouts and session pool limits of `options` without
+    // touching open connections; listener settings only take effect on restart.
+    void reload(const ServerOptions& options);
+
+    // Graceful shutdown: shutdown() closes the listener and asks every connection to finish
+    // its current request; close_connections() closes whatever is still open.
+    void shutdown();
+    void close_connections();
+    std::size_t active_connections() const { return connection_limiter->stats().active; }
+
+    int native_listener() { return acceptor.native_handle(); }
 
 private:
+    void configure_listener(const boost::asio::ip::tcp::endpoint& endpoint);
+    // Posts accepts until accepts_in_flight are pending or as many as there are free connection slots.
     void do_accept();
+    void on_accept(boost::beast::error_code ec, boost::asio::ip::tcp::socket socket);
+    void pause_accept();
+    void resume_accept();
 
+    ServerOptions options;
+    std::shared_ptr<const Session::Timeouts> timeouts; // Swapped atomically by reload()
+    boost::asio::io_context& ioc;
+    // The acceptor and its retry timer share a strand, so shutdown() can close it from any thread.
     boost::asio::ip::tcp::acceptor acceptor;
+    boost::asio::steady_timer accept_retry_timer;
+    std::size_t accepts_pending = 0; // On the acceptor's strand
+    TimerWheel& timer_wheel;
+    std::shared_ptr<SessionPool> session_pool;
+    std::shared_ptr<ConnectionLimiter> connection_limiter;
+    std::atomic<bool> accept_paused{false};
+    std::atomic<bool> stopped{false};
+    std::atomic<std::uint64_t> accept_pause_count{0};
 };
@@ -1,20 +1,92 @@
 #pragma once
 
+#include "ConnectionLimiter.h"
+#include "ResponseHeaders.h"
+#include "TimerWheel.h"
+#include <boost/asio/awaitable.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast.hpp>
+#include <chrono>
+#include <optional>
 
-class Session : public std::enable_shared_from_this<Session> {
+class WebSocketSession;
+#ifdef REST_API_HAS_HTTP2
+class Http2Session;
+#endif
+
+class Session : public std::enable_shared_from_this<Session>, private TimerWheel::Entry {
 public:
+    // Per-phase deadlines: waiting for the first byte of a keep-alive request, reading the
+    // header, reading the body and writing the response.
+    struct Timeouts {
+        std::chrono::milliseconds idle{15000};
+        std::chrono::milliseconds header{10000};
+        std::chrono::milliseconds body{30000};
+        std::chrono::milliseconds write{30000};
+    };
+
     Session(boost::asio::ip::tcp::socket socket) : socket_(std::move(socket)) {}
-    void run();
+    // The session holds one of `limiter`'s slots for `peer` and releases it when recycled.
+    void run(TimerWheel& wheel, const Timeouts& timeouts, std::shared_ptr<ConnectionLimiter> limiter, const boost::asio::ip::address& peer);
+
+    // Pooling support: recycle() drops per-connection state but keeps buffer capacity
+    // (trimmed to the given caps); reset() binds a recycled session to a new connection.
+    void recycle(std::size_t max_buffer_capacity, std::size_t max_body_capacity);
+    void reset(boost::asio::ip::tcp::socket socket);
+    std::size_t retained_bytes() const;
+
+    // Shutdown support, callable from any thread: drain() lets the request in progress
+    // finish and closes the connection instead of keeping it alive; close() closes it now.
+    void drain();
+    void close();
 
 private:
-    void read_request();
-    void process_request();
-    void write_response();
+    // The connection's request loop, run on the socket's strand. `self` keeps the session
+    // alive until the loop ends, when the connection is closed or handed over.
+    boost::asio::awaitable<void> serve(std::shared_ptr<Session> self);
+    // Reads the next request into req_; false if the connection is done with.
+    boost::asio::awaitable<bool> read_request();
+    boost::asio::awaitable<void> handle_read_error(boost::beast::error_code ec);
+    boost::asio::awaitable<void> reject(boost::beast::http::status status, std::string_view message);
+    // Fills res_ for req_, awaiting the route's handler if it is a coroutine. False if the
+    // connection is done with (a streamed response failed halfway).
+    boost::asio::awaitable<bool> process_request();
+    boost::asio::awaitable<bool> write_response();
+    // False for a HEAD request or a 1xx, 204 or 304 status: only the header block is sent.
+    bool has_body() const;
+    // The ResponseStream of coroutine handlers; finish_stream() sends the rest of
+    // res_.body() and the last chunk.
+    class Stream;
+    boost::asio::awaitable<bool> finish_stream();
+    // Hands the connection to a WebSocketSession if req_ is an upgrade to a WebSocket route.
+    bool start_websocket();
+#ifdef REST_API_HAS_HTTP2
+    // Hands the connection to an Http2Session; `upgrade` is the request that asked for h2c.
+    void start_http2(std::optional<boost::beast::http::request<boost::beast::http::string_body>> upgrade, std::string settings);
+    boost::asio::awaitable<void> upgrade_to_http2(std::string settings);
+#endif
+
+    void arm_timeout(std::chrono::milliseconds timeout);
+    void disarm_timeout();
+    std::shared_ptr<void> lock_owner() override;
+    void on_timeout() override;
 
     boost::asio::ip::tcp::socket socket_;
     boost::beast::flat_buffer buffer_;
+    std::optional<boost::beast::http::request_parser<boost::beast::http::string_body>> parser_;
     boost::beast::http::request<boost::beast::http::string_body> req_;
     boost::beast::http::response<boost::beast::http::string_body> res_;
+    const ResponseHeaders::Template* static_headers_ = nullptr; // Template from RestController for res_.
+    std::string header_;              // Serialized header block of res_.
+    bool streaming_ = false;          // res_'s header is sent and its body goes out in chunks
+    TimerWheel* wheel_ = nullptr;
+    Timeouts timeouts_;
+    std::shared_ptr<ConnectionLimiter> limiter_;
+    boost::asio::ip::address peer_;
+    bool idle_ = false;     // Waiting for the next keep-alive request
+    bool draining_ = false;
+    std::weak_ptr<WebSocketSession> websocket_; // Set once the connection has switched to WebSocket
+#ifdef REST_API_HAS_HTTP2
+    std::weak_ptr<Http2Session> http2_; // Set once the connection has switched to HTTP/2
+#endif
 };
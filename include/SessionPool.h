@@ -0,0 +1,58 @@
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+class Session;
+
+// Recycles Session objects (with their buffers) and the shared_ptr control blocks that
+// own them, so a connection on a warm server is accepted without allocating.
+class SessionPool : public std::enable_shared_from_this<SessionPool> {
+public:
+    struct Limits {
+        std::size_t max_idle = 1024;
+        std::size_t max_buffer_capacity = 64 * 1024;
+        std::size_t max_body_capacity = 64 * 1024;
+    };
+
+    struct Stats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::size_t idle = 0;
+        std::size_t retained_bytes = 0;
+    };
+
+    SessionPool() = default;
+    explicit SessionPool(const Limits& limits) : limits(limits) {}
+    ~SessionPool();
+
+    std::shared_ptr<Session> acquire(boost::asio::ip::tcp::socket socket);
+
+    Stats stats() const;
+    void set_limits(const Limits& limits);
+
+    // Calls `visitor` for every session currently serving a connection, outside the lock.
+    void for_each_active(const std::function<void(const std::shared_ptr<Session>&)>& visitor);
+
+private:
+    template <class T>
+    class ControlBlockAllocator;
+
+    void recycle(Session* session);
+    void* allocate_control_block(std::size_t bytes);
+    void deallocate_control_block(void* block, std::size_t bytes);
+
+    Limits limits;
+    mutable std::mutex mtx;
+    std::vector<Session*> idle;
+    std::unordered_set<Session*> active;
+    std::vector<void*> free_blocks;
+    std::size_t block_size = 0;
+    Stats counters;
+};
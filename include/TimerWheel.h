@@ -0,0 +1,71 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Hashed timer wheel shared by all connections of an io_context (one instance per context,
+// obtained with boost::asio::use_service). Scheduling and cancelling are O(1) list splices
+// under one mutex, and a single steady_timer drives the wheel regardless of connection count.
+class TimerWheel : public boost::asio::io_context::service {
+public:
+    static boost::asio::io_context::id id;
+
+    using Duration = std::chrono::steady_clock::duration;
+
+    // Intrusive node embedded in the object that owns the timeout.
+    class Entry {
+    public:
+        Entry() = default;
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+        virtual ~Entry() = default;
+
+    protected:
+        // Keeps the owner alive while on_timeout() runs; an empty pointer skips the callback.
+        virtual std::shared_ptr<void> lock_owner() = 0;
+        // Called from the wheel's tick handler, outside the wheel lock.
+        virtual void on_timeout() = 0;
+
+    private:
+        friend class TimerWheel;
+
+        Entry* prev = nullptr;
+        Entry* next = nullptr;
+        std::size_t slot = 0;
+        std::size_t rounds = 0;
+        bool scheduled = false;
+    };
+
+    explicit TimerWheel(boost::asio::io_context& ioc);
+
+    // (Re)arms `entry` to fire after `timeout`, rounded up to the wheel resolution.
+    void schedule(Entry& entry, Duration timeout);
+    void cancel(Entry& entry);
+
+    std::size_t size() const;
+
+    static constexpr std::chrono::milliseconds resolution{250};
+    static constexpr std::size_t slot_count = 1024;
+
+private:
+    void shutdown() override;
+
+    void start_ticking();
+    void tick();
+    void link(Entry& entry, std::size_t slot);
+    void unlink(Entry& entry);
+
+    mutable std::mutex mtx;
+    std::vector<Entry*> slots;
+    std::vector<std::pair<std::shared_ptr<void>, Entry*>> expired;
+    std::size_t cursor = 0;
+    std::size_t count = 0;
+    bool ticking = false;
+    bool stopped = false;
+    std::chrono::steady_clock::time_point next_tick;
+    boost::asio::steady_timer timer;
+};
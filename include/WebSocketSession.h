@@ -0,0 +1,58 @@
+#pragma once
+
+#include "HandlerMemory.h"
+#include "Session.h"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/websocket.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Per-connection state of a WebSocket route; one is created for every connection.
+class WebSocketHandler {
+public:
+    virtual ~WebSocketHandler() = default;
+    // Called for every text message; a non-empty `reply` is sent back before the next
+    // message is read.
+    virtual void on_message(std::string_view message, std::string& reply) = 0;
+};
+
+using WebSocketHandlerFactory = std::function<std::unique_ptr<WebSocketHandler>()>;
+
+struct WebSocketRoute {
+    WebSocketHandlerFactory factory;
+    std::size_t message_limit; // 0 means the default body limit
+};
+
+// A connection taken over from a Session after a WebSocket upgrade request. Messages are
+// read, handled and answered one at a time on the connection's strand.
+class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+public:
+    using Request = boost::beast::http::request<boost::beast::http::string_body>;
+
+    // `owner` (the Session the connection came from, which holds its connection slot) is
+    // kept alive until the connection closes.
+    WebSocketSession(boost::asio::ip::tcp::socket socket, std::shared_ptr<void> owner, std::unique_ptr<WebSocketHandler> handler);
+
+    void start(const Request& upgrade, const Session::Timeouts& timeouts, std::size_t message_limit);
+
+    // Callable from any thread: drain() sends a close frame (going away) after the message
+    // being handled is answered; close() closes the socket now.
+    void drain();
+    void close();
+
+private:
+    void read();
+    void write();
+
+    boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws_;
+    std::shared_ptr<void> owner_;
+    std::unique_ptr<WebSocketHandler> handler_;
+    boost::beast::flat_buffer buffer_;
+    std::string reply_;
+    HandlerMemory handler_memory_;
+    bool closing_ = false;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads for splitting one request's CPU work across cores. parallel_for() deals the
+// indices out evenly to the workers and the calling thread; whoever runs out steals half of
+// what is left of someone else's share, so uneven tasks still finish together. Several
+// parallel_for() calls can run at once and share the workers, and post() hands a single
+// task to them without waiting for it.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(std::size_t threads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Runs task(0) ... task(count - 1) and returns when all have finished. The calling thread
+    // takes part. The first exception a task throws is rethrown here.
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)>& task);
+
+    // Runs task() on a worker and returns at once; without workers it runs here. Exceptions
+    // are the task's to handle: one that escapes is dropped.
+    void post(std::function<void()> task);
+
+    std::size_t size() const { return workers.size(); }
+
+private:
+    struct Job;
+
+    void run(std::size_t slot);
+    // Runs indices of `job` from `slot`'s share, then stolen ones, until none are left.
+    static void work(Job& job, std::size_t slot);
+
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable wake;
+    std::list<std::shared_ptr<Job>> jobs;
+    bool stopping = false;
+};
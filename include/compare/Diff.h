@@ -1,22 +1,36 @@
 #pragma once
 
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class Operation {
     DELETE, INSERT, EQUAL
 };
 
+// "DELETE", "INSERT" or "EQUAL".
+std::string_view operation_name(Operation operation);
+
 class Diff {
     Operation operation;
-    std::string text;
+    std::pmr::string text;
 
 public:
-    Diff(Operation op, const std::string& t) : operation(op), text(t) {}
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    Diff(Operation op, std::string_view t, const allocator_type& alloc = {}) : operation(op), text(t, alloc) {}
+    Diff(const Diff& other, const allocator_type& alloc) : operation(other.operation), text(other.text, alloc) {}
+    Diff(Diff&& other, const allocator_type& alloc) : operation(other.operation), text(std::move(other.text), alloc) {}
+    Diff(const Diff&) = default;
+    Diff(Diff&&) = default;
+    Diff& operator=(const Diff&) = default;
+    Diff& operator=(Diff&&) = default;
 
-    std::string get_operation_string() const;
+    Operation get_operation() const { return operation; }
+    std::string_view get_operation_string() const;
 
-    std::string get_text() const;
+    std::string_view get_text() const;
 
     friend std::ostream& operator<<(std::ostream& os, const Diff& diff);
 };
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "compare/Diff.h"
+
+#include <boost/json.hpp>
+#include <string>
+
+// Appends {"result": [{"operation": ..., "str": ...}, ...]} to `out`. Intermediate JSON
+// values are allocated from `storage`.
+void serialize_diffs(const std::pmr::vector<Diff>& diffs, std::string& out, boost::json::storage_ptr storage = {});
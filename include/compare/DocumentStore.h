@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Documents uploaded for /compare, kept split into words with every distinct word interned
+// as a 32-bit id, so a diff against a stored document neither re-sends nor re-tokenizes it
+// and compares words as integers. A document's id is the SHA-256 of its text in hex, so the
+// same text is stored once however often it is uploaded. The store holds about max_bytes
+// of documents and evicts the least recently used first; documents handed out stay valid
+// after eviction.
+class DocumentStore {
+public:
+    struct Document {
+        std::string id;
+        std::string text;
+        std::pmr::vector<std::string_view> words; // Views into text
+        std::pmr::vector<std::uint32_t> tokens;   // Interned id of each word
+    };
+
+    // The id of words that are in no stored document; never equal to an interned id.
+    static constexpr std::uint32_t unknown_token = std::numeric_limits<std::uint32_t>::max();
+
+    explicit DocumentStore(std::size_t max_bytes);
+    ~DocumentStore();
+
+    // Stores `text` unless it already is; `created` tells which. Returns null if the text
+    // has more than max_words words or is larger than the whole store.
+    std::shared_ptr<const Document> put(std::string_view text, std::size_t max_words, bool& created);
+    // Null if the id is unknown or was evicted.
+    std::shared_ptr<const Document> get(std::string_view id);
+
+    // Interned ids of words that are not stored (unknown_token for new words), to diff them
+    // against stored documents.
+    void lookup(const std::pmr::vector<std::string_view>& words, std::pmr::vector<std::uint32_t>& tokens) const;
+
+    std::size_t size() const;
+    std::size_t bytes() const;
+
+    static std::string content_id(std::string_view text);
+
+private:
+    class Dictionary;
+    using Entries = std::list<std::shared_ptr<const Document>>;
+
+    static std::size_t cost(const Document& document);
+
+    std::size_t max_bytes;
+    std::shared_ptr<Dictionary> dictionary;
+
+    mutable std::mutex mtx;
+    Entries entries; // Most recently used first
+    std::unordered_map<std::string_view, Entries::iterator> index;
+    std::size_t used_bytes = 0;
+};
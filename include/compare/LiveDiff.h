@@ -0,0 +1,71 @@
+#pragma once
+
+#include "compare/Diff.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Word diff of two documents (1 and 2, as str1 and str2 of /compare) that are edited in
+// place. An edit re-tokenizes only the words it touches and re-diffs only the stretch
+// between the nearest EQUAL entries around it; the rest of the previous diff is kept, so
+// the cost follows the size of the edit rather than of the documents. The kept entries can
+// stop being the best alignment once repeated words are edited, so the diff may then be
+// longer than one computed from scratch (set() does that); it always spells out both
+// documents. Positions are byte offsets into the UTF-8 text.
+class LiveDiff {
+public:
+    struct Limits {
+        std::size_t max_tokens;
+        std::size_t max_cells;
+    };
+
+    // One token of the diff. index1 and index2 are the tokens of document 1 and 2 before it,
+    // so an EQUAL or DELETE entry is token index1 of document 1 and an INSERT entry is token
+    // index2 of document 2.
+    struct Entry {
+        Operation operation;
+        std::uint32_t index1;
+        std::uint32_t index2;
+    };
+
+    // Entries [from, from + removed) of the previous diff were replaced by entries
+    // [from, from + inserted) of the current one.
+    struct Change {
+        std::size_t from;
+        std::size_t removed;
+        std::size_t inserted;
+    };
+
+    explicit LiveDiff(Limits limits) : limits(limits) {}
+
+    // Both throw std::runtime_error, leaving the documents unchanged, when the arguments are
+    // out of range or the document would exceed max_tokens.
+    Change set(int document, std::string_view text);
+    Change edit(int document, std::size_t start, std::size_t end, std::string_view text);
+
+    const std::vector<Entry>& entries() const { return diff; }
+    std::string_view text(const Entry& entry) const;
+
+private:
+    struct Token {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    struct Document {
+        std::string text;
+        std::vector<Token> tokens;
+    };
+
+    Document& get(int document);
+    std::string_view token(int document, std::uint32_t index) const;
+    // Re-diffs the entries [from, to) after the tokens of `document` changed by `token_delta`.
+    Change rediff(int document, std::size_t from, std::size_t to, std::ptrdiff_t token_delta);
+
+    Limits limits;
+    Document documents[2];
+    std::vector<Entry> diff;
+};
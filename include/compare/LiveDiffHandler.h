@@ -0,0 +1,22 @@
+#pragma once
+
+#include "WebSocketSession.h"
+#include "compare/LiveDiff.h"
+
+// The /compare/live protocol. The client sends JSON messages
+//   {"type": "set", "doc": 1, "text": "..."}
+//   {"type": "edit", "doc": 2, "start": 10, "end": 14, "text": "..."}
+// (start and end are UTF-8 byte offsets of the replaced range) and gets back the changed
+// run of the word diff,
+//   {"type": "patch", "from": 3, "remove": 2, "insert": [{"operation": ..., "str": ...}, ...]}
+// meaning entries [from, from + remove) of its copy of the diff are replaced by `insert`,
+// or {"type": "error", "message": "..."}, in which case the documents are unchanged.
+class LiveDiffHandler : public WebSocketHandler {
+public:
+    explicit LiveDiffHandler(LiveDiff::Limits limits) : diff(limits) {}
+
+    void on_message(std::string_view message, std::string& reply) override;
+
+private:
+    LiveDiff diff;
+};
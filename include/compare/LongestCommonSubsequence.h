@@ -2,9 +2,30 @@
 
 #include "compare/Diff.h"
 
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+
 class LongestCommonSubsequence {
-    std::vector<std::string> splitWords(const std::string& str);
-    std::vector<Diff> stringDiffutil(const std::vector<std::string>& words1, const std::vector<std::string>& words2);
+    std::pmr::memory_resource* resource;
+
 public:
-    std::vector<Diff> stringDiff(const std::string& str1, const std::string& str2);
+    explicit LongestCommonSubsequence(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) : resource(resource) {}
+
+    // Tokens and the returned diffs are allocated from `resource`; tokens are views into the inputs.
+    std::pmr::vector<Diff> stringDiff(std::string_view str1, std::string_view str2);
+
+    // Words are separated by Unicode whitespace.
+    std::pmr::vector<std::string_view> splitWords(std::string_view str);
+    // Every grapheme cluster of `str` in order, whitespace included.
+    std::pmr::vector<std::string_view> splitGraphemes(std::string_view str);
+    // Every line of `str` with its '\n'; the last has none if `str` does not end in one.
+    std::pmr::vector<std::string_view> splitLines(std::string_view str);
+    std::pmr::vector<Diff> stringDiffutil(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2);
+    // The same diff with words compared by interned id: tokens1[i] stands for words1[i].
+    std::pmr::vector<Diff> stringDiffutil(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2,
+                                          const std::pmr::vector<std::uint32_t>& tokens1, const std::pmr::vector<std::uint32_t>& tokens2);
+    // Only the operations of the diff of two symbol sequences, in order, written to `out`
+    // (room for m + n); returns how many.
+    std::size_t diffSymbols(const std::uint32_t* symbols1, std::size_t m, const std::uint32_t* symbols2, std::size_t n, Operation* out);
 };
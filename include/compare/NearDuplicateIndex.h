@@ -0,0 +1,64 @@
+#pragma once
+
+#include "compare/DocumentStore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Finds the indexed documents most like a text without comparing it against all of them.
+// Each document gets a MinHash signature over its word shingles, cut into bands; documents
+// that share a band with the query are the candidates (LSH), so a query touches a few
+// buckets rather than the whole corpus. With 32 bands of 4 hashes, documents of shingle
+// Jaccard 0.5 share a band with probability 0.87, and of 0.2 with 0.05.
+// The index does not keep documents alive: once the DocumentStore evicts one (and nobody
+// else holds it) it drops out of the results, and its entry is reclaimed when the index
+// is full.
+class NearDuplicateIndex {
+public:
+    static constexpr std::size_t shingle_size = 3;
+    static constexpr std::size_t signature_size = 128;
+    static constexpr std::size_t bands = 32;
+
+    struct Candidate {
+        std::shared_ptr<const DocumentStore::Document> document;
+        double estimate; // MinHash estimate of the shingle Jaccard similarity
+    };
+
+    explicit NearDuplicateIndex(std::size_t max_documents);
+
+    // False if the index is full. `added` is false if the document was already indexed.
+    bool add(const std::shared_ptr<const DocumentStore::Document>& document, bool& added);
+
+    // Up to `limit` documents that share a band with `words`, highest estimate first.
+    std::vector<Candidate> candidates(const std::pmr::vector<std::string_view>& words, std::size_t limit, std::pmr::memory_resource* resource) const;
+
+    // The signature of the indexed document `id`, or an empty vector if it isn't indexed.
+    std::pmr::vector<std::uint64_t> signature(std::string_view id, std::pmr::memory_resource* resource) const;
+
+    // Entries, including those of evicted documents not yet reclaimed.
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        std::string id;
+        std::weak_ptr<const DocumentStore::Document> document;
+        std::pmr::vector<std::uint64_t> signature;
+    };
+
+    static std::uint64_t band_key(const std::uint64_t* rows, std::size_t band);
+    // Drops the entries of evicted documents and rebuilds the buckets; returns how many.
+    std::size_t reclaim();
+
+    std::size_t max_documents;
+    mutable std::shared_mutex mtx;
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, std::uint32_t> indexed; // Document id -> entry
+    std::vector<std::unordered_map<std::uint64_t, std::vector<std::uint32_t>>> buckets;
+};
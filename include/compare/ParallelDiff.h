@@ -0,0 +1,47 @@
+#pragma once
+
+#include "compare/Diff.h"
+#include "WorkStealingPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+
+// Word diff of large inputs on several cores. Words that occur exactly once in each input,
+// taken in an order both inputs agree on (patience diff's anchors), split the inputs into
+// segments that are diffed independently on a WorkStealingPool and joined in order. The
+// result is a correct diff but, as with patience diff, not always a minimal one. Words are
+// compared as symbols (interned ids, or see encode_words).
+class ParallelDiff {
+public:
+    ParallelDiff(WorkStealingPool& pool, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Finds the segments; afterwards cells() is the size of their DP tables together.
+    void plan(const std::pmr::vector<std::uint32_t>& symbols1, const std::pmr::vector<std::uint32_t>& symbols2);
+    std::size_t cells() const { return total_cells; }
+
+    // The planned diff, with words1 and words2 the words the symbols stand for.
+    std::pmr::vector<Diff> run(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2);
+
+private:
+    // [begin1, end1) x [begin2, end2), followed by the anchor (end1, end2) unless it is the
+    // last. `prefix` and `suffix` are the equal words at its ends, which need no table.
+    struct Segment {
+        std::size_t begin1;
+        std::size_t end1;
+        std::size_t begin2;
+        std::size_t end2;
+        std::size_t prefix;
+        std::size_t suffix;
+    };
+
+    void add_segment(std::size_t begin1, std::size_t end1, std::size_t begin2, std::size_t end2);
+
+    WorkStealingPool& pool;
+    std::pmr::memory_resource* resource;
+    const std::pmr::vector<std::uint32_t>* symbols1 = nullptr;
+    const std::pmr::vector<std::uint32_t>* symbols2 = nullptr;
+    std::pmr::vector<Segment> segments;
+    std::size_t total_cells = 0;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// How different two word sequences are, without building a diff. Words are compared as
+// 32-bit symbols (interned ids, or see encode_words) and scratch memory comes from
+// `resource`.
+
+// Maps the words of both sequences to symbols, equal words to equal symbols.
+void encode_words(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2,
+                  std::pmr::vector<std::uint32_t>& symbols1, std::pmr::vector<std::uint32_t>& symbols2, std::pmr::memory_resource* resource);
+
+// Length of the longest common subsequence, bit-parallel over 64-bit words (Allison-Dix,
+// Hyyrö): O(m n / 64) time and O(m) space.
+std::size_t lcs_length(const std::pmr::vector<std::uint32_t>& symbols1, const std::pmr::vector<std::uint32_t>& symbols2, std::pmr::memory_resource* resource);
+
+// Levenshtein distance in words (insert, delete and substitute cost 1), with Myers'
+// bit-vector algorithm in 64-row blocks: O(m n / 64) time and O(m) space.
+std::size_t edit_distance(const std::pmr::vector<std::uint32_t>& symbols1, const std::pmr::vector<std::uint32_t>& symbols2, std::pmr::memory_resource* resource);
+
+// Hashes of every run of `size` consecutive words (the whole text if it is shorter), sorted
+// and without duplicates. The hashes do not depend on the process, so they can be kept.
+std::pmr::vector<std::uint64_t> shingles(const std::pmr::vector<std::string_view>& words, std::size_t size, std::pmr::memory_resource* resource);
+
+// |A ∩ B| / |A ∪ B| of two shingle sets; 1 if both are empty.
+double jaccard(const std::pmr::vector<std::uint64_t>& shingles1, const std::pmr::vector<std::uint64_t>& shingles2);
+
+// The minimum of each of `hashes` independent hash functions over a shingle set. The share
+// of equal positions in two signatures estimates the Jaccard similarity of the sets.
+std::pmr::vector<std::uint64_t> minhash(const std::pmr::vector<std::uint64_t>& shingles, std::size_t hashes, std::pmr::memory_resource* resource);
+double minhash_similarity(const std::pmr::vector<std::uint64_t>& signature1, const std::pmr::vector<std::uint64_t>& signature2);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "WorkStealingPool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Word-level three-way merge (diff3). Base is diffed against ours and against theirs, the
+// two diffs in parallel on a WorkStealingPool; between the base words both sides kept, a
+// stretch changed on one side only takes that side's version, and a stretch changed
+// differently on both is a conflict. The merged text keeps the whitespace of the side each
+// word comes from.
+class ThreeWayMerge {
+public:
+    // A text and its words, which are views into it.
+    struct Version {
+        std::string_view text;
+        const std::pmr::vector<std::string_view>& words;
+    };
+
+    // A stretch both sides changed. The merged text has ours at [begin, end); base, ours
+    // and theirs are the three versions of it, as views into the inputs.
+    struct Conflict {
+        std::size_t begin;
+        std::size_t end;
+        std::string_view base;
+        std::string_view ours;
+        std::string_view theirs;
+    };
+
+    struct Result {
+        std::pmr::string text;
+        std::pmr::vector<Conflict> conflicts;
+    };
+
+    ThreeWayMerge(WorkStealingPool& pool, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    Result merge(const Version& base, const Version& ours, const Version& theirs);
+
+private:
+    // matches[i] is the word of the other version that base word i is kept as, or `none`.
+    static void align(const std::pmr::vector<std::uint32_t>& base, const std::pmr::vector<std::uint32_t>& other, std::pmr::vector<std::size_t>& matches);
+
+    WorkStealingPool& pool;
+    std::pmr::memory_resource* resource;
+};
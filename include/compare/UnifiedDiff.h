@@ -0,0 +1,22 @@
+#pragma once
+
+#include "compare/Diff.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+
+// Line diffs in the unified format of `diff -u`, which `patch` and `git apply` accept.
+
+// Appends the hunks of the diff of lines1 and lines2 (see splitLines) to `out`, with
+// `context` unchanged lines around each change. `operations` are the diff's operations in
+// order (see diffSymbols), so no Diff objects are built. Appends nothing if the texts are
+// equal.
+void write_unified_diff(const std::pmr::vector<std::string_view>& lines1, const std::pmr::vector<std::string_view>& lines2, const Operation* operations,
+                        std::size_t count, std::size_t context, std::string& out);
+
+// `base` with the hunks of `patch` applied, in one pass over both. Lines before the first
+// hunk ("---", "+++" and the like) are ignored. Throws std::runtime_error if the patch is
+// malformed or its context and removed lines do not match `base`.
+std::pmr::string apply_unified_diff(std::string_view base, std::string_view patch, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// UTF-8 helpers for the tokenizers. Validation and word splitting (via ascii_word_run) skip
+// ASCII eight bytes at a time; grapheme_length has a one-byte ASCII fast path, since ASCII
+// is a cluster per byte and there is nothing to skip. Mostly-ASCII text pays little for the
+// multibyte handling.
+
+// True if `text` is well-formed UTF-8 (no overlong forms, surrogates or code points past
+// U+10FFFF).
+bool utf8_valid(std::string_view text);
+
+// The code point at byte `i` and its length in bytes. A malformed sequence is read as one
+// byte, U+FFFD.
+std::size_t utf8_decode(std::string_view text, std::size_t i, char32_t& code_point);
+
+// Number of bytes from `i`, in whole steps of eight, that are ASCII above the space and so
+// cannot end a word.
+std::size_t ascii_word_run(std::string_view text, std::size_t i);
+
+// Length in bytes of the whitespace character (Unicode White_Space) at byte `i`, 0 if it is
+// not one.
+std::size_t utf8_space_length(std::string_view text, std::size_t i);
+
+// Length in bytes of the extended grapheme cluster starting at byte `i`: a user-perceived
+// character such as "e" with combining accents, a Hangul syllable, a flag or an emoji ZWJ
+// sequence. Follows the UAX #29 rules with compact property tables that cover the common
+// scripts rather than the full Unicode database.
+std::size_t grapheme_length(std::string_view text, std::size_t i);
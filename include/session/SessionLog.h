@@ -0,0 +1,95 @@
+#pragma once
+
+#include "session/SessionStore.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Append-only write-ahead log that makes a SessionStore survive restarts.
+//
+// Mutations are encoded into an in-memory batch (no I/O on the caller's thread). A single
+// writer thread appends each batch to `sessions.log` and makes it durable with one
+// fdatasync, so concurrent logins share a commit. Once the log grows past
+// compact_threshold it is rotated to `sessions.log.old`, the store's live sessions are
+// written to `sessions.snapshot` (via a temporary file and rename) and the old log is
+// removed. Recovery maps the snapshot and both logs and replays them in that order;
+// records are idempotent, so a crash at any point of a compaction loses nothing. A batch
+// that fails to write is cut off the log and retried; it is not reported durable until
+// it succeeds.
+class SessionLog {
+public:
+    struct Options {
+        std::string directory = ".";
+        std::chrono::milliseconds commit_interval{5};
+        std::size_t compact_threshold = 16 * 1024 * 1024;
+    };
+
+    using Visitor = SessionStore::Visitor;
+    // Visits every live session, or returns false if the store is no longer available.
+    using SnapshotSource = std::function<bool(const Visitor& visitor)>;
+
+    explicit SessionLog(const Options& options);
+    ~SessionLog();
+
+    SessionLog(const SessionLog&) = delete;
+    SessionLog& operator=(const SessionLog&) = delete;
+
+    // Replays the snapshot and logs into `visitor`; an erase is replayed with an expiry in
+    // the past. A torn record at the end of a log is cut off. Call before start().
+    void recover(const Visitor& visitor);
+
+    // Starts the writer thread, which writes snapshots from `source`. With `compact`, what
+    // was recovered is first folded into a fresh snapshot.
+    void start(SnapshotSource source, bool compact = true);
+
+    // Writes out what was appended so far, stops the writer and closes the log, so that a
+    // new process can recover and take it over. Later appends are kept in memory until
+    // resume() reopens the log and writes them.
+    void suspend();
+    void resume();
+
+    void append_put(const SessionStore::SessionId& id, std::string_view data, SessionStore::Clock::time_point expires);
+    void append_erase(const SessionStore::SessionId& id);
+
+    // Blocks until every record appended so far is on disk. Returns false if the log
+    // stopped before they could be written.
+    bool flush();
+
+private:
+    enum class RecordType : std::uint8_t { put = 1, erase = 2 };
+
+    static void encode(std::string& out, RecordType type, const SessionStore::SessionId& id, std::int64_t expires_ms, std::string_view data);
+    static std::size_t replay(const std::string& path, const Visitor& visitor);
+
+    void run();
+    void write_batch(const std::string& batch);
+    void compact();
+    void open_log();
+
+    Options options;
+    std::string log_path;
+    std::string old_log_path;
+    std::string snapshot_path;
+    SnapshotSource snapshot_source;
+
+    std::mutex mtx;
+    std::condition_variable work_available;
+    std::condition_variable durable;
+    std::string pending;
+    std::uint64_t appended = 0;
+    std::uint64_t committed = 0;
+    bool stopping = false;
+    bool running = false;
+    bool failed = false;
+    bool compact_requested = false;
+
+    int log_fd = -1;
+    std::size_t log_bytes = 0; // End of the last record written in full
+    std::thread writer;
+};
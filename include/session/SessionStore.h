@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class SessionLog;
+
+// In-memory store for cookie sessions, split into independently locked shards so lookups
+// from different I/O threads rarely contend. Session ids are 128-bit random values written
+// as 32 hex digits; they are parsed back into integers for lookup, so no key is allocated.
+// Every session lives for a fixed TTL. Each shard queues its ids in creation order, which
+// is also expiry order, and expired entries are dropped lazily on access and on insert.
+// With a SessionLog attached, every mutation is also recorded for recovery after a restart.
+class SessionStore {
+public:
+    using Clock = std::chrono::system_clock;
+    using SessionId = std::array<std::uint64_t, 2>;
+    using Visitor = std::function<void(const SessionId& id, std::string_view data, Clock::time_point expires)>;
+
+    SessionStore(std::size_t shard_count, std::chrono::seconds ttl);
+
+    // Returns the new session's id.
+    std::string create(std::string data);
+    std::optional<std::string> get(std::string_view id);
+    bool update(std::string_view id, std::string data);
+    bool erase(std::string_view id);
+
+    // Inserts a recovered session, or removes it if `expires` has passed. Not logged.
+    void restore(const SessionId& id, std::string_view data, Clock::time_point expires);
+    // Visits every session, locking one shard at a time.
+    void for_each(const Visitor& visitor) const;
+    void set_log(std::shared_ptr<SessionLog> log) { this->log = std::move(log); }
+
+    std::size_t size() const;
+    std::chrono::seconds ttl() const { return time_to_live; }
+
+    static std::optional<SessionId> parse_id(std::string_view id);
+    static std::string format_id(const SessionId& id);
+
+    // Value of cookie `name` in a Cookie header, or empty if absent.
+    static std::string_view find_cookie(std::string_view header, std::string_view name);
+
+private:
+    struct Entry {
+        std::string data;
+        Clock::time_point expires;
+    };
+
+    struct SessionIdHash {
+        std::size_t operator()(const SessionId& id) const { return static_cast<std::size_t>(id[0] ^ (id[1] * 0x9e3779b97f4a7c15ull)); }
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mtx;
+        std::unordered_map<SessionId, Entry, SessionIdHash> entries;
+        std::deque<std::pair<Clock::time_point, SessionId>> expiry;
+    };
+
+    Shard& shard_for(const SessionId& id) const { return shards[id[1] % shard_count]; }
+    static void expire(Shard& shard, Clock::time_point now);
+
+    std::size_t shard_count;
+    std::chrono::seconds time_to_live;
+    std::unique_ptr<Shard[]> shards;
+    std::shared_ptr<SessionLog> log;
+};
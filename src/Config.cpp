@@ -0,0 +1,224 @@
+#include "Config.h"
+
+#include <atomic>
+#include <boost/json.hpp>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+void assign(std::string& target, std::string_view value) {
+    target = value;
+}
+
+template <class T>
+void assign(T& target, std::string_view value) {
+    auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), target);
+    if (ec != std::errc() || end != value.data() + value.size()) {
+        throw std::runtime_error("expected a number, got '" + std::string(value) + "'");
+    }
+}
+
+template <class Rep, class Period>
+void assign(std::chrono::duration<Rep, Period>& target, std::string_view value) {
+    Rep count;
+    assign(count, value);
+    target = std::chrono::duration<Rep, Period>(count);
+}
+
+void assign(bool& target, std::string_view value) {
+    if (value == "true" || value == "1" || value == "on" || value == "yes") {
+        target = true;
+    } else if (value == "false" || value == "0" || value == "off" || value == "no") {
+        target = false;
+    } else {
+        throw std::runtime_error("expected true or false, got '" + std::string(value) + "'");
+    }
+}
+
+void assign(LogLevel& target, std::string_view value) {
+    if (value == "error") {
+        target = LogLevel::error;
+    } else if (value == "warn") {
+        target = LogLevel::warn;
+    } else if (value == "info") {
+        target = LogLevel::info;
+    } else if (value == "debug") {
+        target = LogLevel::debug;
+    } else {
+        throw std::runtime_error("expected error, warn, info or debug, got '" + std::string(value) + "'");
+    }
+}
+
+struct Setting {
+    const char* key;
+    std::function<void(Config&, std::string_view)> apply;
+};
+
+const std::vector<Setting>& settings() {
+    static const std::vector<Setting> table = {
+        {"port", [](Config& c, std::string_view v) { assign(c.port, v); }},
+        {"threads", [](Config& c, std::string_view v) { assign(c.threads, v); }},
+        {"default_target", [](Config& c, std::string_view v) { assign(c.default_target, v); }},
+        {"ui_prefix", [](Config& c, std::string_view v) { assign(c.ui_prefix, v); }},
+        {"mime_types_file", [](Config& c, std::string_view v) { assign(c.mime_types_file, v); }},
+        {"log_level", [](Config& c, std::string_view v) { assign(c.log_level, v); }},
+        {"limits.header", [](Config& c, std::string_view v) { assign(c.header_limit, v); }},
+        {"limits.body", [](Config& c, std::string_view v) { assign(c.body_limit, v); }},
+        {"shutdown.drain_timeout_ms", [](Config& c, std::string_view v) { assign(c.drain_timeout, v); }},
+        {"server.backlog", [](Config& c, std::string_view v) { assign(c.server.backlog, v); }},
+        {"server.max_connections", [](Config& c, std::string_view v) { assign(c.server.max_connections, v); }},
+        {"server.max_connections_per_ip", [](Config& c, std::string_view v) { assign(c.server.max_connections_per_ip, v); }},
+        {"server.tcp_nodelay", [](Config& c, std::string_view v) { assign(c.server.tcp_nodelay, v); }},
+        {"server.defer_accept_seconds", [](Config& c, std::string_view v) { assign(c.server.defer_accept_seconds, v); }},
+        {"server.fastopen_queue", [](Config& c, std::string_view v) { assign(c.server.fastopen_queue, v); }},
+        {"server.receive_buffer_size", [](Config& c, std::string_view v) { assign(c.server.receive_buffer_size, v); }},
+        {"server.send_buffer_size", [](Config& c, std::string_view v) { assign(c.server.send_buffer_size, v); }},
+        {"server.accept_retry_ms", [](Config& c, std::string_view v) { assign(c.server.accept_retry_delay, v); }},
+        {"server.accepts_in_flight", [](Config& c, std::string_view v) { assign(c.server.accepts_in_flight, v); }},
+        {"timeouts.idle_ms", [](Config& c, std::string_view v) { assign(c.server.timeouts.idle, v); }},
+        {"timeouts.header_ms", [](Config& c, std::string_view v) { assign(c.server.timeouts.header, v); }},
+        {"timeouts.body_ms", [](Config& c, std::string_view v) { assign(c.server.timeouts.body, v); }},
+        {"timeouts.write_ms", [](Config& c, std::string_view v) { assign(c.server.timeouts.write, v); }},
+        {"cache.session_pool_idle", [](Config& c, std::string_view v) { assign(c.server.session_pool.max_idle, v); }},
+        {"cache.session_buffer_bytes", [](Config& c, std::string_view v) { assign(c.server.session_pool.max_buffer_capacity, v); }},
+        {"cache.session_body_bytes", [](Config& c, std::string_view v) { assign(c.server.session_pool.max_body_capacity, v); }},
+        {"cache.arena_retained_bytes", [](Config& c, std::string_view v) { assign(c.arena_max_retained, v); }},
+        {"compare.body_limit", [](Config& c, std::string_view v) { assign(c.compare.body_limit, v); }},
+        {"compare.max_tokens", [](Config& c, std::string_view v) { assign(c.compare.max_tokens, v); }},
+        {"compare.max_cells", [](Config& c, std::string_view v) { assign(c.compare.max_cells, v); }},
+        {"compare.parallel_cells", [](Config& c, std::string_view v) { assign(c.compare.parallel_cells, v); }},
+        {"compare.threads", [](Config& c, std::string_view v) { assign(c.compare.threads, v); }},
+        {"documents.max_bytes", [](Config& c, std::string_view v) { assign(c.documents.max_bytes, v); }},
+        {"index.max_documents", [](Config& c, std::string_view v) { assign(c.index.max_documents, v); }},
+        {"sessions.shards", [](Config& c, std::string_view v) { assign(c.sessions.shards, v); }},
+        {"sessions.ttl_seconds", [](Config& c, std::string_view v) { assign(c.sessions.ttl, v); }},
+        {"sessions.data_dir", [](Config& c, std::string_view v) { assign(c.sessions.data_dir, v); }}
+    };
+    return table;
+}
+
+// `source` names where the value came from, for error messages.
+void apply(Config& config, std::string_view key, std::string_view value, const std::string& source) {
+    for (const Setting& setting : settings()) {
+        if (key == setting.key) {
+            try {
+                setting.apply(config, value);
+            } catch (const std::runtime_error& e) {
+                throw std::runtime_error(source + ": " + e.what());
+            }
+            return;
+        }
+    }
+    throw std::runtime_error(source + ": unknown setting");
+}
+
+void apply_json(Config& config, const boost::json::object& object, const std::string& prefix, const std::string& source) {
+    for (const auto& element : object) {
+        std::string key = prefix + std::string(element.key());
+        const boost::json::value& value = element.value();
+        if (value.is_object()) {
+            apply_json(config, value.as_object(), key + ".", source);
+        } else if (value.is_string()) {
+            const boost::json::string& text = value.as_string();
+            apply(config, key, std::string_view(text.data(), text.size()), source + ": " + key);
+        } else {
+            apply(config, key, boost::json::serialize(value), source + ": " + key);
+        }
+    }
+}
+
+std::string environment_name(std::string_view key) {
+    std::string name = "REST_API_";
+    for (char c : key) {
+        name += c == '.' ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    return name;
+}
+
+std::shared_ptr<const Config> current_config = std::make_shared<const Config>();
+std::atomic<LogLevel> current_log_level{LogLevel::info};
+
+} // namespace
+
+Config Config::load(int argc, char* argv[]) {
+    return load(std::vector<std::string>(argv + 1, argv + argc));
+}
+
+Config Config::load(const std::vector<std::string>& arguments) {
+    // Flags are collected first: --config picks the file, and they must win over it.
+    std::vector<std::pair<std::string, std::string>> flags;
+    std::string config_file;
+    if (const char* path = std::getenv("REST_API_CONFIG")) {
+        config_file = path;
+    }
+    for (std::size_t i = 0; i < arguments.size(); ++i) {
+        std::string_view argument = arguments[i];
+        if (argument.substr(0, 2) != "--") {
+            throw std::runtime_error("command line: unexpected argument '" + arguments[i] + "'");
+        }
+        argument.remove_prefix(2);
+        std::size_t eq = argument.find('=');
+        std::string key(argument.substr(0, eq));
+        std::string value;
+        if (eq != std::string_view::npos) {
+            value = argument.substr(eq + 1);
+        } else if (i + 1 < arguments.size()) {
+            value = arguments[++i];
+        } else {
+            throw std::runtime_error("command line: missing value for --" + key);
+        }
+        if (key == "config") {
+            config_file = value;
+        } else {
+            flags.emplace_back(std::move(key), std::move(value));
+        }
+    }
+
+    Config config;
+    config.arguments = arguments;
+    if (!config_file.empty()) {
+        std::ifstream file(config_file);
+        if (!file) {
+            throw std::runtime_error("Cannot open config file: " + config_file);
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        boost::system::error_code ec;
+        boost::json::value json = boost::json::parse(buffer.str(), ec);
+        if (ec || !json.is_object()) {
+            throw std::runtime_error(config_file + ": not a JSON object" + (ec ? ": " + ec.message() : std::string()));
+        }
+        apply_json(config, json.as_object(), "", config_file);
+    }
+    for (const Setting& setting : settings()) {
+        std::string name = environment_name(setting.key);
+        if (const char* value = std::getenv(name.c_str())) {
+            apply(config, setting.key, value, name);
+        }
+    }
+    for (const auto& [key, value] : flags) {
+        apply(config, key, value, "--" + key);
+    }
+    return config;
+}
+
+std::shared_ptr<const Config> Config::current() {
+    return std::atomic_load(&current_config);
+}
+
+void Config::set_current(std::shared_ptr<const Config> config) {
+    current_log_level.store(config->log_level, std::memory_order_relaxed);
+    std::atomic_store(&current_config, std::move(config));
+}
+
+bool Config::log_enabled(LogLevel level) {
+    return level <= current_log_level.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,83 @@
+#include "ConnectionLimiter.h"
+
+#include <string_view>
+
+std::size_t ConnectionLimiter::AddressHash::operator()(const boost::asio::ip::address& address) const {
+    if (address.is_v4()) {
+        return std::hash<std::uint32_t>()(address.to_v4().to_uint());
+    }
+    auto bytes = address.to_v6().to_bytes();
+    return std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+}
+
+bool ConnectionLimiter::has_capacity() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters.active < max_connections;
+}
+
+std::size_t ConnectionLimiter::available() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters.active < max_connections ? max_connections - counters.active : 0;
+}
+
+bool ConnectionLimiter::try_acquire(const boost::asio::ip::address& address) {
+    std::lock_guard<std::mutex> lock(mtx);
+    // The server posts no more accepts than there are free slots, but a reload can lower the cap
+    // under accepts already posted.
+    if (counters.active >= max_connections) {
+        ++counters.rejected_full;
+        return false;
+    }
+    std::size_t& count = per_ip[address];
+    if (count >= max_connections_per_ip) {
+        ++counters.rejected_per_ip;
+        return false;
+    }
+    ++count;
+    ++counters.active;
+    ++counters.accepted;
+    return true;
+}
+
+void ConnectionLimiter::release(const boost::asio::ip::address& address) {
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto iter = per_ip.find(address);
+        if (iter != per_ip.end() && --iter->second == 0) {
+            per_ip.erase(iter);
+        }
+        if (counters.active-- >= max_connections && counters.active < max_connections) {
+            callback = resume;
+        }
+    }
+    if (callback) {
+        callback();
+    }
+}
+
+void ConnectionLimiter::on_capacity_available(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(mtx);
+    resume = std::move(callback);
+}
+
+void ConnectionLimiter::set_limits(std::size_t max_connections, std::size_t max_connections_per_ip) {
+    std::function<void()> callback;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        bool was_full = counters.active >= this->max_connections;
+        this->max_connections = max_connections;
+        this->max_connections_per_ip = max_connections_per_ip;
+        if (was_full && counters.active < max_connections) {
+            callback = resume;
+        }
+    }
+    if (callback) {
+        callback();
+    }
+}
+
+ConnectionLimiter::Stats ConnectionLimiter::stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters;
+}
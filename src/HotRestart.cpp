@@ -0,0 +1,162 @@
+#include "HotRestart.h"
+
+#include <array>
+#include <boost/asio/post.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/read.hpp>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+constexpr int listen_fds_start = 3; // SD_LISTEN_FDS_START
+constexpr int ready_fd = 4;
+
+bool starts_with(const char* text, const char* prefix) {
+    return std::strncmp(text, prefix, std::strlen(prefix)) == 0;
+}
+
+} // namespace
+
+std::optional<int> HotRestart::inherited_listener() {
+    // The variables are removed so they do not leak into child processes, so the answer is
+    // worked out once.
+    static const std::optional<int> listener = []() -> std::optional<int> {
+        const char* fds = std::getenv("LISTEN_FDS");
+        const char* pid = std::getenv("LISTEN_PID");
+        if (!fds || !pid || std::atoi(fds) < 1 || std::atoi(pid) != ::getpid()) {
+            return std::nullopt;
+        }
+        ::unsetenv("LISTEN_FDS");
+        ::unsetenv("LISTEN_PID");
+        ::unsetenv("LISTEN_FDNAMES");
+        ::fcntl(listen_fds_start, F_SETFD, FD_CLOEXEC);
+        return listen_fds_start;
+    }();
+    return listener;
+}
+
+void HotRestart::notify_ready() {
+    const char* fd_text = std::getenv("REST_API_READY_FD");
+    if (!fd_text) {
+        return;
+    }
+    int fd = std::atoi(fd_text);
+    ::unsetenv("REST_API_READY_FD");
+    char ready = 1;
+    if (::write(fd, &ready, 1) != 1) {
+        std::cerr << "Ready notification failed: " << std::strerror(errno) << std::endl;
+    }
+    ::close(fd);
+}
+
+void HotRestart::spawn(boost::asio::io_context& ioc, int listen_fd, const std::vector<std::string>& arguments,
+                       std::function<void(bool ready)> on_done) {
+    char executable[PATH_MAX];
+    ssize_t length = ::readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+    int pipe_fds[2];
+    if (length < 0 || ::pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        std::cerr << "Restart failed: " << std::strerror(errno) << std::endl;
+        boost::asio::post(ioc, [on_done]() { on_done(false); });
+        return;
+    }
+    executable[length] = '\0';
+
+    // Everything the child needs is prepared before fork(): between fork() and exec() only
+    // async-signal-safe calls are allowed. LISTEN_PID gets the child's pid written in place.
+    std::vector<std::string> environment_strings;
+    for (char** entry = environ; *entry; ++entry) {
+        if (!starts_with(*entry, "LISTEN_") && !starts_with(*entry, "REST_API_READY_FD=")) {
+            environment_strings.emplace_back(*entry);
+        }
+    }
+    environment_strings.push_back("LISTEN_FDS=1");
+    environment_strings.push_back("REST_API_READY_FD=" + std::to_string(ready_fd));
+    environment_strings.push_back("LISTEN_PID=" + std::string(20, '\0'));
+    char* pid_digits = environment_strings.back().data() + std::strlen("LISTEN_PID=");
+
+    std::vector<char*> environment;
+    for (auto& entry : environment_strings) {
+        environment.push_back(entry.data());
+    }
+    environment.push_back(nullptr);
+
+    std::vector<std::string> argument_strings = arguments;
+    std::vector<char*> argv{executable};
+    for (auto& argument : argument_strings) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+
+    rlimit limit{};
+    int max_fd = ::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY ? static_cast<int>(limit.rlim_cur) : 65536;
+
+    pid_t child = ::fork();
+    if (child == 0) {
+        // fcntl(F_DUPFD) copies are not close-on-exec. Move both descriptors out of the way
+        // first, since the pipe may have been given fd 3 or 4.
+        int listen_copy = ::fcntl(listen_fd, F_DUPFD, 10);
+        int ready_copy = ::fcntl(pipe_fds[1], F_DUPFD, 10);
+        if (listen_copy < 0 || ready_copy < 0 || ::dup2(listen_copy, listen_fds_start) < 0 || ::dup2(ready_copy, ready_fd) < 0) {
+            ::_exit(127);
+        }
+        // Accepted connections must not leak into the new process. close_range needs Linux
+        // 5.9; older kernels get the loop.
+#ifdef SYS_close_range
+        bool closed = ::syscall(SYS_close_range, ready_fd + 1, ~0U, 0) == 0;
+#else
+        bool closed = false;
+#endif
+        if (!closed) {
+            for (int fd = ready_fd + 1; fd < max_fd; ++fd) {
+                ::close(fd);
+            }
+        }
+
+        char digits[20];
+        int count = 0;
+        for (pid_t pid = ::getpid(); pid > 0; pid /= 10) {
+            digits[count++] = static_cast<char>('0' + pid % 10);
+        }
+        for (int i = 0; i < count; ++i) {
+            pid_digits[i] = digits[count - 1 - i];
+        }
+        pid_digits[count] = '\0';
+
+        ::execve(executable, argv.data(), environment.data());
+        ::_exit(127);
+    }
+
+    ::close(pipe_fds[1]);
+    if (child < 0) {
+        std::cerr << "Restart failed: " << std::strerror(errno) << std::endl;
+        ::close(pipe_fds[0]);
+        boost::asio::post(ioc, [on_done]() { on_done(false); });
+        return;
+    }
+    std::cout << "Started process " << child << ", waiting for it to accept connections" << std::endl;
+
+    // The pipe reports readiness with one byte; EOF means the child exited (or exec'd
+    // something that never reported) first.
+    auto pipe = std::make_shared<boost::asio::posix::stream_descriptor>(ioc, pipe_fds[0]);
+    auto byte = std::make_shared<std::array<char, 1>>();
+    boost::asio::async_read(*pipe, boost::asio::buffer(*byte), [pipe, byte, child, on_done](boost::system::error_code ec, std::size_t) {
+        if (ec) {
+            int status = 0;
+            ::waitpid(child, &status, WNOHANG);
+            std::cerr << "Process " << child << " exited before it was ready; still serving" << std::endl;
+        }
+        on_done(!ec);
+    });
+}
@@ -0,0 +1,573 @@
+#include "Http2Session.h"
+#include "ResponseHeaders.h"
+#include "RestController.h"
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <nghttp2/nghttp2.h>
+#include <vector>
+
+namespace {
+
+constexpr std::uint32_t max_concurrent_streams = 100;
+constexpr std::uint32_t initial_window_size = 1024 * 1024;
+constexpr std::size_t max_write_size = 64 * 1024;
+
+// Connection-specific fields have no meaning in HTTP/2 and make clients reset the stream.
+bool is_connection_field(boost::beast::http::field name) {
+    using boost::beast::http::field;
+    return name == field::connection || name == field::keep_alive || name == field::proxy_connection ||
+           name == field::transfer_encoding || name == field::upgrade;
+}
+
+// Appends the "Name: value\r\n" lines of `headers` as name and value.
+void split_lines(std::string_view headers, std::vector<std::pair<std::string_view, std::string_view>>& out) {
+    while (!headers.empty()) {
+        std::size_t end = headers.find("\r\n");
+        std::string_view line = headers.substr(0, end);
+        headers.remove_prefix(end == std::string_view::npos ? headers.size() : end + 2);
+        std::size_t colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string_view value = line.substr(colon + 1);
+        value.remove_prefix(std::min(value.find_first_not_of(' '), value.size()));
+        out.emplace_back(line.substr(0, colon), value);
+    }
+}
+
+// Appends the lines of a header template, leaving out fields `res` sets itself.
+void split_template(const ResponseHeaders::Template& headers, std::vector<std::pair<std::string_view, std::string_view>>& out,
+                    const boost::beast::http::response<boost::beast::http::string_body>& res) {
+    if (!ResponseHeaders::overlaps(res, headers)) {
+        split_lines(headers.text, out);
+        return;
+    }
+    std::string_view text = headers.text;
+    for (auto name : headers.fields) {
+        std::size_t end = text.find("\r\n") + 2;
+        if (res.find(name) == res.end()) {
+            split_lines(text.substr(0, end), out);
+        }
+        text.remove_prefix(end);
+    }
+}
+
+// The ResponseStream of coroutine handlers. The pieces are collected and go out with the
+// rest of the response, as the stream's data provider reads a finished body.
+class BufferedStream : public ResponseStream {
+public:
+    boost::asio::awaitable<void> write(std::string_view data) override {
+        collected.append(data);
+        co_return;
+    }
+
+    // Puts what was collected before the body the handler left in `res`.
+    void finish(boost::beast::http::response<boost::beast::http::string_body>& res) {
+        if (!collected.empty()) {
+            res.body().insert(0, collected);
+        }
+    }
+
+private:
+    std::string collected;
+};
+
+} // namespace
+
+struct Http2Session::Stream {
+    Request req;
+    boost::beast::http::response<boost::beast::http::string_body> res;
+    const ResponseHeaders::Template* static_headers = nullptr;
+    std::size_t header_bytes = 0;
+    std::size_t body_limit = 0;
+    std::optional<boost::beast::http::status> error; // Answered without calling a handler
+    bool dispatched = false;
+    std::size_t sent = 0; // Body bytes handed to nghttp2
+};
+
+// nghttp2 callbacks; user_data is the Http2Session.
+struct Http2Session::Callbacks {
+    static Http2Session& self(void* user_data) {
+        return *static_cast<Http2Session*>(user_data);
+    }
+
+    static Stream* find(Http2Session& session, std::int32_t stream_id) {
+        auto it = session.streams_.find(stream_id);
+        return it == session.streams_.end() ? nullptr : it->second.get();
+    }
+
+    static int on_begin_headers(nghttp2_session*, const nghttp2_frame* frame, void* user_data) {
+        if (frame->hd.type == NGHTTP2_HEADERS && frame->headers.cat == NGHTTP2_HCAT_REQUEST) {
+            auto stream = std::make_shared<Stream>();
+            stream->req.version(20);
+            self(user_data).streams_.emplace(frame->hd.stream_id, std::move(stream));
+        }
+        return 0;
+    }
+
+    static int on_header(nghttp2_session*, const nghttp2_frame* frame, const std::uint8_t* name, std::size_t name_length,
+                         const std::uint8_t* value, std::size_t value_length, std::uint8_t, void* user_data) {
+        Stream* stream = find(self(user_data), frame->hd.stream_id);
+        if (!stream || stream->error) {
+            return 0;
+        }
+        // Counted the way SETTINGS_MAX_HEADER_LIST_SIZE counts.
+        stream->header_bytes += name_length + value_length + 32;
+        if (stream->header_bytes > RestController::getInstance()->header_limit()) {
+            stream->error = boost::beast::http::status::request_header_fields_too_large;
+            return 0;
+        }
+        std::string_view name_view(reinterpret_cast<const char*>(name), name_length);
+        std::string_view value_view(reinterpret_cast<const char*>(value), value_length);
+        if (name_view == ":method") {
+            stream->req.method_string(value_view);
+        } else if (name_view == ":path") {
+            stream->req.target(value_view);
+        } else if (name_view == ":authority") {
+            stream->req.set(boost::beast::http::field::host, value_view);
+        } else if (name_view.front() != ':') {
+            stream->req.insert(name_view, value_view);
+        }
+        return 0;
+    }
+
+    static int on_frame_recv(nghttp2_session*, const nghttp2_frame* frame, void* user_data) {
+        Http2Session& session = self(user_data);
+        if (frame->hd.type != NGHTTP2_HEADERS && frame->hd.type != NGHTTP2_DATA) {
+            return 0;
+        }
+        Stream* stream = find(session, frame->hd.stream_id);
+        if (!stream) {
+            return 0;
+        }
+        if (frame->hd.type == NGHTTP2_HEADERS && frame->headers.cat == NGHTTP2_HCAT_REQUEST) {
+            stream->body_limit = RestController::getInstance()->body_limit(stream->req.method(), stream->req.target());
+            auto content_length = stream->req[boost::beast::http::field::content_length];
+            std::size_t length = 0;
+            auto [end, ec] = std::from_chars(content_length.data(), content_length.data() + content_length.size(), length);
+            if (!stream->error && ec == std::errc() && length > stream->body_limit) {
+                stream->error = boost::beast::http::status::payload_too_large;
+            }
+            if (stream->error) {
+                // Answer before the body arrives; what follows is discarded.
+                session.dispatch(frame->hd.stream_id);
+                return 0;
+            }
+        }
+        if (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) {
+            session.dispatch(frame->hd.stream_id);
+        }
+        return 0;
+    }
+
+    static int on_data_chunk_recv(nghttp2_session*, std::uint8_t, std::int32_t stream_id, const std::uint8_t* data, std::size_t length,
+                                  void* user_data) {
+        Http2Session& session = self(user_data);
+        Stream* stream = find(session, stream_id);
+        if (!stream || stream->error) {
+            return 0;
+        }
+        std::string& body = stream->req.body();
+        if (body.size() + length > stream->body_limit) {
+            stream->error = boost::beast::http::status::payload_too_large;
+            session.dispatch(stream_id);
+            return 0;
+        }
+        body.append(reinterpret_cast<const char*>(data), length);
+        return 0;
+    }
+
+    static int on_frame_send(nghttp2_session* session, const nghttp2_frame* frame, void* user_data) {
+        // A request answered early (413, 431) may still be sending its body. Once the
+        // response is complete, ask the client to stop (RFC 7540 section 8.1).
+        if ((frame->hd.type != NGHTTP2_HEADERS && frame->hd.type != NGHTTP2_DATA) || !(frame->hd.flags & NGHTTP2_FLAG_END_STREAM)) {
+            return 0;
+        }
+        Stream* stream = find(self(user_data), frame->hd.stream_id);
+        if (stream && stream->error && nghttp2_session_get_stream_remote_close(session, frame->hd.stream_id) == 0) {
+            nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, frame->hd.stream_id, NGHTTP2_NO_ERROR);
+        }
+        return 0;
+    }
+
+    static int on_stream_close(nghttp2_session*, std::int32_t stream_id, std::uint32_t, void* user_data) {
+        // A handler still running keeps its own reference; its response is dropped.
+        self(user_data).streams_.erase(stream_id);
+        return 0;
+    }
+
+    static ssize_t read_body(nghttp2_session*, std::int32_t, std::uint8_t* buffer, std::size_t length, std::uint32_t* data_flags,
+                             nghttp2_data_source* source, void*) {
+        Stream& stream = *static_cast<Stream*>(source->ptr);
+        const std::string& body = stream.res.body();
+        std::size_t size = std::min(length, body.size() - stream.sent);
+        std::memcpy(buffer, body.data() + stream.sent, size);
+        stream.sent += size;
+        if (stream.sent == body.size()) {
+            *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+        }
+        return static_cast<ssize_t>(size);
+    }
+
+    static nghttp2_session_callbacks* get() {
+        static nghttp2_session_callbacks* callbacks = []() {
+            nghttp2_session_callbacks* created = nullptr;
+            if (nghttp2_session_callbacks_new(&created) != 0) {
+                throw std::runtime_error("nghttp2_session_callbacks_new failed");
+            }
+            nghttp2_session_callbacks_set_on_begin_headers_callback(created, on_begin_headers);
+            nghttp2_session_callbacks_set_on_header_callback(created, on_header);
+            nghttp2_session_callbacks_set_on_frame_recv_callback(created, on_frame_recv);
+            nghttp2_session_callbacks_set_on_data_chunk_recv_callback(created, on_data_chunk_recv);
+            nghttp2_session_callbacks_set_on_frame_send_callback(created, on_frame_send);
+            nghttp2_session_callbacks_set_on_stream_close_callback(created, on_stream_close);
+            return created;
+        }();
+        return callbacks;
+    }
+};
+
+Http2Session::Http2Session(boost::asio::ip::tcp::socket socket, std::shared_ptr<void> owner, TimerWheel& wheel, const Session::Timeouts& timeouts)
+    : socket_(std::move(socket)), owner_(std::move(owner)), wheel_(wheel), timeouts_(timeouts) {}
+
+Http2Session::~Http2Session() {
+    wheel_.cancel(*this);
+    nghttp2_session_del(session_);
+}
+
+std::optional<std::string> Http2Session::upgrade_settings(const Request& req) {
+    using boost::beast::http::field;
+    using boost::beast::http::token_list;
+    if (req.version() != 11 || !token_list{req[field::upgrade]}.exists("h2c")) {
+        return std::nullopt;
+    }
+    // RFC 7540 section 3.2.1: exactly one HTTP2-Settings field, also named in Connection
+    // next to Upgrade. Anything else is served as HTTP/1.1.
+    token_list connection{req[field::connection]};
+    if (req.count("HTTP2-Settings") != 1 || !connection.exists("Upgrade") || !connection.exists("HTTP2-Settings")) {
+        return std::nullopt;
+    }
+    auto encoded = req["HTTP2-Settings"];
+    if (encoded.empty()) {
+        return std::nullopt;
+    }
+    // base64url without padding; every SETTINGS entry is 6 bytes.
+    std::string settings;
+    unsigned bits = 0;
+    int bit_count = 0;
+    for (char c : encoded) {
+        unsigned value;
+        if (c >= 'A' && c <= 'Z') {
+            value = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            value = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            value = c - '0' + 52;
+        } else if (c == '-' || c == '+') {
+            value = 62;
+        } else if (c == '_' || c == '/') {
+            value = 63;
+        } else if (c == '=') {
+            break;
+        } else {
+            return std::nullopt;
+        }
+        bits = (bits << 6) | value;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            settings.push_back(static_cast<char>((bits >> bit_count) & 0xff));
+        }
+    }
+    if (settings.size() % 6 != 0) {
+        return std::nullopt;
+    }
+    return settings;
+}
+
+void Http2Session::start(std::string_view received) {
+    if (init(nullptr) && receive(received.data(), received.size())) {
+        write();
+        read();
+    }
+}
+
+void Http2Session::start_upgraded(Request req, std::string_view settings, std::string_view received) {
+    std::string settings_payload(settings);
+    if (!init(&settings_payload)) {
+        return;
+    }
+    // nghttp2 has opened stream 1 half-closed for the upgrade request.
+    auto stream = std::make_shared<Stream>();
+    stream->req = std::move(req);
+    streams_.emplace(1, std::move(stream));
+    dispatch(1);
+    if (receive(received.data(), received.size())) {
+        write();
+        read();
+    }
+}
+
+bool Http2Session::init(const std::string* upgrade_settings) {
+    if (nghttp2_session_server_new(&session_, Callbacks::get(), this) != 0) {
+        std::cerr << "HTTP/2 error: cannot create session" << std::endl;
+        return false;
+    }
+    if (upgrade_settings) {
+        const auto* payload = reinterpret_cast<const std::uint8_t*>(upgrade_settings->data());
+        if (int rv = nghttp2_session_upgrade2(session_, payload, upgrade_settings->size(), 0, nullptr); rv != 0) {
+            std::cerr << "HTTP/2 upgrade error: " << nghttp2_strerror(rv) << std::endl;
+            return false;
+        }
+    }
+    nghttp2_settings_entry settings[] = {
+        {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, max_concurrent_streams},
+        {NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, initial_window_size},
+        {NGHTTP2_SETTINGS_MAX_HEADER_LIST_SIZE, static_cast<std::uint32_t>(RestController::getInstance()->header_limit())}};
+    if (int rv = nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, settings, std::size(settings)); rv != 0) {
+        std::cerr << "HTTP/2 error: " << nghttp2_strerror(rv) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Http2Session::receive(const char* data, std::size_t size) {
+    auto consumed = nghttp2_session_mem_recv(session_, reinterpret_cast<const std::uint8_t*>(data), size);
+    if (consumed < 0) {
+        if (consumed != NGHTTP2_ERR_BAD_CLIENT_MAGIC) {
+            std::cerr << "HTTP/2 error: " << nghttp2_strerror(static_cast<int>(consumed)) << std::endl;
+        }
+        closed_ = true;
+        boost::beast::error_code ec;
+        socket_.close(ec);
+        return false;
+    }
+    return true;
+}
+
+void Http2Session::read() {
+    auto self = shared_from_this();
+    update_timeout();
+    socket_.async_read_some(boost::asio::buffer(read_buffer_), make_custom_alloc_handler(handler_memory_, [self](boost::beast::error_code ec, std::size_t size) {
+        if (ec) {
+            if (ec != boost::asio::error::eof && ec != boost::asio::error::operation_aborted && ec != boost::asio::error::bad_descriptor &&
+                ec != boost::asio::error::connection_reset) {
+                std::cerr << "Read error: " << ec.message() << std::endl;
+            }
+            self->closed_ = true;
+            self->update_timeout();
+            return;
+        }
+        if (self->receive(self->read_buffer_.data(), size)) {
+            self->write();
+            if (!self->closed_) {
+                self->read();
+            }
+        }
+    }));
+}
+
+void Http2Session::write() {
+    if (writing_ || closed_) {
+        return;
+    }
+    write_buffer_.clear();
+    while (write_buffer_.size() < max_write_size) {
+        const std::uint8_t* data = nullptr;
+        auto size = nghttp2_session_mem_send(session_, &data);
+        if (size < 0) {
+            std::cerr << "HTTP/2 error: " << nghttp2_strerror(static_cast<int>(size)) << std::endl;
+            close();
+            return;
+        }
+        if (size == 0) {
+            break;
+        }
+        write_buffer_.append(reinterpret_cast<const char*>(data), size);
+    }
+
+    if (write_buffer_.empty()) {
+        if (!nghttp2_session_want_read(session_) && !nghttp2_session_want_write(session_)) {
+            // GOAWAY exchanged and every stream answered.
+            closed_ = true;
+            boost::beast::error_code ec;
+            socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+            socket_.close(ec);
+        }
+        update_timeout();
+        return;
+    }
+
+    writing_ = true;
+    update_timeout();
+    auto self = shared_from_this();
+    boost::asio::async_write(socket_, boost::asio::buffer(write_buffer_), make_custom_alloc_handler(handler_memory_, [self](boost::beast::error_code ec, std::size_t) {
+        self->writing_ = false;
+        if (ec) {
+            if (!self->closed_) {
+                std::cerr << "Write error: " << ec.message() << std::endl;
+            }
+            self->close();
+            return;
+        }
+        self->write();
+    }));
+}
+
+void Http2Session::dispatch(std::int32_t stream_id) {
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end() || it->second->dispatched) {
+        return;
+    }
+    auto stream = it->second;
+    stream->dispatched = true;
+    auto controller = RestController::getInstance();
+    if (stream->error) {
+        controller->error_response(*stream->error, stream->error == boost::beast::http::status::payload_too_large ? "Request body too large" : "Request header too large",
+                                   stream->res);
+        stream->static_headers = &controller->default_headers();
+        submit_response(stream_id, *stream);
+        return;
+    }
+
+    // Run the handler off the strand so slow routes don't hold up the other streams, then
+    // come back to the strand to submit the response.
+    auto self = shared_from_this();
+    auto& ioc = static_cast<boost::asio::io_context&>(boost::asio::query(socket_.get_executor(), boost::asio::execution::context));
+    boost::asio::co_spawn(ioc, [](std::shared_ptr<Http2Session> self, std::shared_ptr<Stream> stream, std::int32_t stream_id) -> boost::asio::awaitable<void> {
+        auto controller = RestController::getInstance();
+        RestController::Dispatch dispatch = controller->handle_request(stream->req, stream->res);
+        stream->static_headers = dispatch.headers;
+        if (dispatch.pending) {
+            try {
+                BufferedStream body;
+                co_await dispatch.pending->async(stream->req, stream->res, body);
+                body.finish(stream->res);
+            } catch (const std::exception& e) {
+                stream->static_headers = &controller->handler_error(e, stream->res);
+            }
+        }
+        co_await boost::asio::post(self->socket_.get_executor(), boost::asio::use_awaitable);
+        auto it = self->streams_.find(stream_id);
+        if (self->closed_ || it == self->streams_.end() || it->second != stream) {
+            co_return; // Reset by the client meanwhile
+        }
+        self->submit_response(stream_id, *stream);
+        self->write();
+    }(self, stream, stream_id), [self](std::exception_ptr error) {
+        // Handlers' exceptions are answered above; anything else ends the connection, never
+        // io_context::run().
+        if (!error) {
+            return;
+        }
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::exception& e) {
+            std::cerr << "HTTP/2 error: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "HTTP/2 error: unknown exception" << std::endl;
+        }
+        self->close();
+    });
+}
+
+void Http2Session::submit_response(std::int32_t stream_id, Stream& stream) {
+    auto& res = stream.res;
+    std::vector<std::pair<std::string_view, std::string_view>> fields;
+    split_template(*stream.static_headers, fields, res);
+    for (const auto& field : res) {
+        if (field.name() != boost::beast::http::field::content_length && field.name() != boost::beast::http::field::date &&
+            !is_connection_field(field.name())) {
+            fields.emplace_back(field.name_string(), field.value());
+        }
+    }
+    split_lines(ResponseHeaders::date(), fields);
+
+    char status[8];
+    std::string_view status_view(status, std::to_chars(status, status + sizeof(status), res.result_int()).ptr - status);
+    char length[24];
+    unsigned status_code = res.result_int();
+    bool has_body = status_code >= 200 && status_code != 204 && status_code != 304;
+    if (has_body) {
+        fields.emplace_back("content-length", std::string_view(length, std::to_chars(length, length + sizeof(length), res.body().size()).ptr - length));
+    }
+
+    // HTTP/2 field names are lower case; the templates use the HTTP/1.1 spelling.
+    std::size_t names_size = 0;
+    for (const auto& field : fields) {
+        names_size += field.first.size();
+    }
+    std::string names;
+    names.reserve(names_size);
+    std::vector<nghttp2_nv> headers;
+    headers.reserve(fields.size() + 1);
+    auto add = [&headers](std::string_view name, std::string_view value) {
+        headers.push_back({reinterpret_cast<std::uint8_t*>(const_cast<char*>(name.data())), reinterpret_cast<std::uint8_t*>(const_cast<char*>(value.data())),
+                           name.size(), value.size(), NGHTTP2_NV_FLAG_NONE});
+    };
+    add(":status", status_view);
+    for (const auto& [name, value] : fields) {
+        std::size_t offset = names.size();
+        for (char c : name) {
+            names.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+        }
+        add(std::string_view(names).substr(offset), value);
+    }
+
+    nghttp2_data_provider provider{};
+    provider.source.ptr = &stream;
+    provider.read_callback = Callbacks::read_body;
+    bool send_body = has_body && !res.body().empty() && stream.req.method() != boost::beast::http::verb::head;
+    if (int rv = nghttp2_submit_response(session_, stream_id, headers.data(), headers.size(), send_body ? &provider : nullptr); rv != 0) {
+        std::cerr << "HTTP/2 error: " << nghttp2_strerror(rv) << std::endl;
+    }
+}
+
+void Http2Session::update_timeout() {
+    if (closed_) {
+        wheel_.cancel(*this);
+    } else if (writing_) {
+        wheel_.schedule(*this, timeouts_.write);
+    } else if (streams_.empty()) {
+        wheel_.schedule(*this, timeouts_.idle);
+    } else {
+        wheel_.schedule(*this, timeouts_.body);
+    }
+}
+
+std::shared_ptr<void> Http2Session::lock_owner() {
+    return weak_from_this().lock();
+}
+
+void Http2Session::on_timeout() {
+    close();
+}
+
+void Http2Session::drain() {
+    auto self = shared_from_this();
+    boost::asio::post(socket_.get_executor(), [self]() {
+        if (self->closed_ || !self->session_) {
+            return;
+        }
+        nghttp2_submit_goaway(self->session_, NGHTTP2_FLAG_NONE, nghttp2_session_get_last_proc_stream_id(self->session_), NGHTTP2_NO_ERROR, nullptr, 0);
+        self->write();
+    });
+}
+
+void Http2Session::close() {
+    auto self = shared_from_this();
+    boost::asio::post(socket_.get_executor(), [self]() {
+        self->closed_ = true;
+        self->update_timeout();
+        boost::beast::error_code ec;
+        self->socket_.close(ec);
+    });
+}
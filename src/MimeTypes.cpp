@@ -0,0 +1,185 @@
+#include "MimeTypes.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct MimeEntry {
+    std::string_view extension;
+    std::string_view mime_type;
+};
+
+constexpr MimeEntry builtin_types[] = {
+    {"htm", "text/html"},
+    {"html", "text/html"},
+    {"php", "text/html"},
+    {"css", "text/css"},
+    {"txt", "text/plain"},
+    {"js", "application/javascript"},
+    {"json", "application/json"},
+    {"xml", "application/xml"},
+    {"swf", "application/x-shockwave-flash"},
+    {"flv", "video/x-flv"},
+    {"png", "image/png"},
+    {"jpe", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"jpg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"bmp", "image/bmp"},
+    {"ico", "image/vnd.microsoft.icon"},
+    {"tiff", "image/tiff"},
+    {"tif", "image/tiff"},
+    {"svg", "image/svg+xml"},
+    {"svgz", "image/svg+xml"}
+};
+
+constexpr std::size_t table_size = 64;
+constexpr std::size_t max_extension = 8;
+
+constexpr char to_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+constexpr std::uint32_t hash(std::string_view extension, std::uint32_t seed) {
+    std::uint32_t h = seed;
+    for (char c : extension) {
+        h = (h ^ static_cast<unsigned char>(to_lower(c))) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+// The first seed for which every built-in extension lands in its own slot.
+constexpr std::uint32_t find_seed() {
+    for (std::uint32_t seed = 2166136261u;; ++seed) {
+        bool used[table_size] = {};
+        bool collision = false;
+        for (const MimeEntry& entry : builtin_types) {
+            std::size_t slot = hash(entry.extension, seed) % table_size;
+            collision = collision || used[slot];
+            used[slot] = true;
+        }
+        if (!collision) {
+            return seed;
+        }
+    }
+}
+
+constexpr std::uint32_t seed = find_seed();
+
+struct Table {
+    MimeEntry slots[table_size];
+};
+
+constexpr Table make_table() {
+    Table table{};
+    for (const MimeEntry& entry : builtin_types) {
+        table.slots[hash(entry.extension, seed) % table_size] = entry;
+    }
+    return table;
+}
+
+constexpr Table table = make_table();
+
+constexpr bool iequals(std::string_view text, std::string_view lower) {
+    if (text.size() != lower.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (to_lower(text[i]) != lower[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr std::string_view find_builtin(std::string_view extension) {
+    if (extension.empty() || extension.size() > max_extension) {
+        return {};
+    }
+    const MimeEntry& entry = table.slots[hash(extension, seed) % table_size];
+    return iequals(extension, entry.extension) ? entry.mime_type : std::string_view();
+}
+
+static_assert(find_builtin("html") == "text/html");
+static_assert(find_builtin("JPG") == "image/jpeg");
+static_assert(find_builtin("svgz") == "image/svg+xml");
+static_assert(find_builtin("exe").empty());
+
+// Loaded types, sorted by lower-case extension.
+std::vector<std::pair<std::string, std::string>> overrides;
+
+bool less_ignore_case(std::string_view lhs, std::string_view rhs) {
+    std::size_t size = std::min(lhs.size(), rhs.size());
+    for (std::size_t i = 0; i < size; ++i) {
+        char l = to_lower(lhs[i]);
+        char r = to_lower(rhs[i]);
+        if (l != r) {
+            return l < r;
+        }
+    }
+    return lhs.size() < rhs.size();
+}
+
+} // namespace
+
+std::string_view MimeTypes::find(std::string_view path) {
+    std::size_t dot = path.rfind('.');
+    if (dot == std::string_view::npos) {
+        return {};
+    }
+    std::string_view extension = path.substr(dot + 1);
+    if (extension.find('/') != std::string_view::npos) {
+        return {};
+    }
+
+    if (!overrides.empty()) {
+        auto iter = std::lower_bound(overrides.begin(), overrides.end(), extension,
+                                     [](const auto& entry, std::string_view key) { return less_ignore_case(entry.first, key); });
+        if (iter != overrides.end() && iequals(extension, iter->first)) {
+            return iter->second;
+        }
+    }
+    return find_builtin(extension);
+}
+
+std::size_t MimeTypes::load(const std::string& file_path) {
+    std::ifstream file(file_path);
+    if (!file) {
+        throw std::runtime_error("Cannot open mime types file: " + file_path);
+    }
+
+    std::size_t count = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string mime_type;
+        std::string extension;
+        if (!(words >> mime_type)) {
+            continue;
+        }
+        while (words >> extension) {
+            if (extension.front() == '.') {
+                extension.erase(0, 1);
+            }
+            std::transform(extension.begin(), extension.end(), extension.begin(), to_lower);
+            auto iter = std::lower_bound(overrides.begin(), overrides.end(), extension,
+                                         [](const auto& entry, const std::string& key) { return entry.first < key; });
+            if (iter != overrides.end() && iter->first == extension) {
+                iter->second = mime_type;
+            } else {
+                overrides.emplace(iter, extension, mime_type);
+            }
+            ++count;
+        }
+    }
+    std::cout << "Loaded " << count << " mime types from " << file_path << std::endl;
+    return count;
+}
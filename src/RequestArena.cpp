@@ -0,0 +1,53 @@
+#include "RequestArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace {
+std::atomic<std::size_t> local_max_retained{8 * 1024 * 1024};
+}
+
+RequestArena::RequestArena(std::size_t block_size, std::size_t max_retained)
+    : block_size(block_size), max_retained(max_retained) {
+    blocks.reserve(32);
+}
+
+RequestArena& RequestArena::local() {
+    thread_local RequestArena arena;
+    arena.max_retained = local_max_retained.load(std::memory_order_relaxed);
+    return arena;
+}
+
+void RequestArena::set_local_max_retained(std::size_t bytes) {
+    local_max_retained.store(bytes, std::memory_order_relaxed);
+}
+
+void RequestArena::reset() {
+    current = 0;
+    offset = 0;
+    while (reserved > max_retained && !blocks.empty()) {
+        reserved -= blocks.back().size;
+        blocks.pop_back();
+    }
+}
+
+void* RequestArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    for (; current < blocks.size(); ++current, offset = 0) {
+        Block& block = blocks[current];
+        std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.data.get());
+        std::size_t aligned = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+        if (aligned + bytes <= block.size) {
+            offset = aligned + bytes;
+            return block.data.get() + aligned;
+        }
+    }
+
+    // Grow geometrically so a large request settles on a handful of blocks.
+    std::size_t size = std::max({block_size, bytes + alignment, reserved});
+    blocks.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+    reserved += size;
+    current = blocks.size() - 1;
+    offset = 0;
+    return do_allocate(bytes, alignment);
+}
@@ -0,0 +1,95 @@
+#include "ResponseHeaders.h"
+
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+
+ResponseHeaders::Template ResponseHeaders::make_template(const FieldList& fields) {
+    Template result;
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+        const auto& [name, value] = fields[i];
+        auto later = std::find_if(fields.begin() + i + 1, fields.end(), [&](const auto& field) { return field.first == name; });
+        if (later != fields.end()) {
+            continue;
+        }
+        auto name_string = boost::beast::http::to_string(name);
+        result.text.append(name_string.data(), name_string.size());
+        result.text += ": ";
+        result.text += value;
+        result.text += "\r\n";
+        result.fields.push_back(name);
+    }
+    return result;
+}
+
+void ResponseHeaders::serialize(const Response& res, const Template& static_headers, std::string& out, bool chunked) {
+    char digits[24];
+    auto status = res.result_int();
+    auto reason = res.reason();
+    out += "HTTP/1.1 ";
+    out.append(digits, std::to_chars(digits, digits + sizeof(digits), status).ptr);
+    out += ' ';
+    out.append(reason.data(), reason.size());
+    out += "\r\n";
+    if (!overlaps(res, static_headers)) {
+        out += static_headers.text;
+    } else {
+        std::string_view text = static_headers.text;
+        for (auto name : static_headers.fields) {
+            std::size_t end = text.find("\r\n") + 2;
+            if (res.find(name) == res.end()) {
+                out.append(text.data(), end);
+            }
+            text.remove_prefix(end);
+        }
+    }
+
+    for (const auto& field : res) {
+        if (field.name() == boost::beast::http::field::content_length || field.name() == boost::beast::http::field::date ||
+            field.name() == boost::beast::http::field::transfer_encoding) {
+            continue;
+        }
+        auto name = field.name_string();
+        auto value = field.value();
+        out.append(name.data(), name.size());
+        out += ": ";
+        out.append(value.data(), value.size());
+        out += "\r\n";
+    }
+
+    std::string_view date_line = date();
+    out.append(date_line.data(), date_line.size());
+    // 1xx, 204 and 304 responses carry no body and no Content-Length.
+    if (chunked) {
+        out += "Transfer-Encoding: chunked\r\n";
+    } else if (status >= 200 && status != 204 && status != 304) {
+        out += "Content-Length: ";
+        out.append(digits, std::to_chars(digits, digits + sizeof(digits), res.body().size()).ptr);
+        out += "\r\n";
+    }
+    out += "\r\n";
+}
+
+bool ResponseHeaders::overlaps(const Response& res, const Template& static_headers) {
+    for (const auto& field : res) {
+        if (std::find(static_headers.fields.begin(), static_headers.fields.end(), field.name()) != static_headers.fields.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string_view ResponseHeaders::date() {
+    thread_local std::time_t cached_second = -1;
+    thread_local char line[64];
+    thread_local std::size_t size = 0;
+
+    std::time_t now = std::time(nullptr);
+    if (now != cached_second) {
+        std::tm utc;
+        gmtime_r(&now, &utc);
+        size = std::strftime(line, sizeof(line), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &utc);
+        cached_second = now;
+    }
+    return std::string_view(line, size);
+}
@@ -1,23 +1,161 @@
 #include "RestController.h"
+#include "HotRestart.h"
+#include "MimeTypes.h"
+#include "RequestArena.h"
 #include "Server.h"
 #include <boost/asio.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/json.hpp>
 #include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// The reactor Asio was built with (see REST_API_IO_URING), reported by /stats so load test
+// results can be told apart.
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+constexpr const char* io_backend = "io_uring";
+#else
+constexpr const char* io_backend = "epoll";
+#endif
+
+// Polls until the server has no connections left or the deadline passes, then stops ioc.
+void stop_when_drained(boost::asio::io_context& ioc, std::shared_ptr<Server> server, std::chrono::steady_clock::time_point deadline,
+                       std::shared_ptr<boost::asio::steady_timer> timer) {
+    std::size_t active = server->active_connections();
+    if (active > 0 && std::chrono::steady_clock::now() < deadline) {
+        timer->expires_after(std::chrono::milliseconds(50));
+        timer->async_wait([&ioc, server, deadline, timer](boost::system::error_code) {
+            stop_when_drained(ioc, server, deadline, timer);
+        });
+        return;
+    }
+    if (active > 0) {
+        std::cerr << "Drain timeout, closing " << active << " connections" << std::endl;
+        server->close_connections();
+    }
+    ioc.stop();
+}
+
+} // namespace
 
 std::shared_ptr<RestController> RestController::instance = nullptr;
 std::mutex RestController::mtx;
 std::string RestController::defaultTarget = "/index.html";
 
-void RestController::start_server(const int& port, const int& num_threads) {
+void RestController::start_server(const Config& config) {
     try {
+        Config::set_current(std::make_shared<const Config>(config));
+        set_limits(config.header_limit, config.body_limit);
+        RequestArena::set_local_max_retained(config.arena_max_retained);
+
+        const int num_threads = config.threads;
         boost::asio::io_context ioc{num_threads};
-        boost::asio::ip::tcp::endpoint endpoint{boost::asio::ip::tcp::v4(), static_cast<unsigned short>(port)};
+        boost::asio::ip::tcp::endpoint endpoint{boost::asio::ip::tcp::v4(), static_cast<unsigned short>(config.port)};
 
-        auto srv = std::make_shared<Server>(ioc, endpoint);
+        // Started by a hot restart or by systemd socket activation: serve the socket we were given.
+        ServerOptions server_options = config.server;
+        if (auto inherited = HotRestart::inherited_listener()) {
+            server_options.listen_fd = *inherited;
+        }
+        auto srv = std::make_shared<Server>(ioc, endpoint, server_options);
+        std::weak_ptr<Server> weak_srv = srv;
+        add_routes(Method::get, "/stats", [weak_srv](const BoostRequest& req, BoostResponse& res) {
+            auto server = weak_srv.lock();
+            if (!server) {
+                res.result(boost::beast::http::status::service_unavailable);
+                return;
+            }
+            SessionPool::Stats pool = server->session_pool_stats();
+            std::uint64_t acquired = pool.hits + pool.misses;
+            boost::json::object session_pool;
+            session_pool["hits"] = pool.hits;
+            session_pool["misses"] = pool.misses;
+            session_pool["hit_rate"] = acquired ? static_cast<double>(pool.hits) / acquired : 0.0;
+            session_pool["idle"] = pool.idle;
+            session_pool["retained_bytes"] = pool.retained_bytes;
 
+            ConnectionLimiter::Stats connections = server->connection_stats();
+            boost::json::object connection_obj;
+            connection_obj["active"] = connections.active;
+            connection_obj["accepted"] = connections.accepted;
+            connection_obj["rejected_per_ip"] = connections.rejected_per_ip;
+            connection_obj["rejected_full"] = connections.rejected_full;
+            connection_obj["accept_pauses"] = server->accept_pauses();
+
+            boost::json::object body_obj;
+            body_obj["io_backend"] = io_backend;
+            body_obj["session_pool"] = session_pool;
+            body_obj["connections"] = connection_obj;
+            res.result(boost::beast::http::status::ok);
+            res.body() = boost::json::serialize(body_obj);
+        }, 0, {{boost::beast::http::field::content_type, "application/json"}});
+        build_header_templates();
+
+        boost::asio::signal_set reload_signals(ioc, SIGHUP);
+        std::function<void()> wait_for_reload = [&]() {
+            reload_signals.async_wait([&](boost::system::error_code ec, int) {
+                if (!ec) {
+                    reload(*srv);
+                    wait_for_reload();
+                }
+            });
+        };
+        wait_for_reload();
+
+        // The first SIGTERM or SIGINT drains; a second one stops without waiting.
+        boost::asio::signal_set stop_signals(ioc, SIGTERM, SIGINT);
+        stop_signals.async_wait([&](boost::system::error_code ec, int signal) {
+            if (ec) {
+                return;
+            }
+            std::cout << "Received signal " << signal << ", shutting down" << std::endl;
+            stop_gracefully(ioc, srv);
+            stop_signals.async_wait([&](boost::system::error_code ec, int) {
+                if (!ec) {
+                    srv->close_connections();
+                    ioc.stop();
+                }
+            });
+        });
+
+        // Only one restart at a time; a failed one leaves this process serving.
+        boost::asio::signal_set restart_signals(ioc, SIGUSR2);
+        std::function<void()> wait_for_restart = [&]() {
+            restart_signals.async_wait([&](boost::system::error_code ec, int) {
+                if (ec) {
+                    return;
+                }
+                for (auto& hook : restart_hooks) {
+                    hook(true);
+                }
+                HotRestart::spawn(ioc, srv->native_listener(), Config::current()->arguments, [&](bool ready) {
+                    if (ready) {
+                        stop_gracefully(ioc, srv);
+                    } else {
+                        for (auto& hook : restart_hooks) {
+                            hook(false);
+                        }
+                        wait_for_restart();
+                    }
+                });
+            });
+        };
+        wait_for_restart();
+        HotRestart::notify_ready();
+
+        // The io_context is shared by num_threads I/O threads; this thread is one of them.
+        std::vector<std::thread> threads;
+        threads.reserve(num_threads > 1 ? num_threads - 1 : 0);
+        for (int i = 1; i < num_threads; ++i) {
+            threads.emplace_back([&ioc]() { ioc.run(); });
+        }
         ioc.run();
+        for (auto& thread : threads) {
+            thread.join();
+        }
     } catch (const std::runtime_error& e) {
         std::cerr << "Runtime Exception: " << e.what() << std::endl;
         throw;
@@ -27,62 +165,264 @@ void RestController::start_server(const int& port, const int& num_threads) {
     }
 }
 
-void RestController::add_routes(const Method& method, const std::string& target, const HttpHandler& handler) {
+void RestController::stop_gracefully(boost::asio::io_context& ioc, const std::shared_ptr<Server>& server) {
+    server->shutdown();
+    auto deadline = std::chrono::steady_clock::now() + Config::current()->drain_timeout;
+    stop_when_drained(ioc, server, deadline, std::make_shared<boost::asio::steady_timer>(ioc));
+}
+
+void RestController::reload(Server& server) {
+    auto previous = Config::current();
+    std::shared_ptr<const Config> config;
+    try {
+        config = std::make_shared<const Config>(Config::load(previous->arguments));
+    } catch (const std::exception& e) {
+        std::cerr << "Reload failed, keeping the current configuration: " << e.what() << std::endl;
+        return;
+    }
+
+    set_limits(config->header_limit, config->body_limit);
+    RequestArena::set_local_max_retained(config->arena_max_retained);
+    server.reload(config->server);
+    Config::set_current(config);
+    if (config->port != previous->port || config->threads != previous->threads) {
+        std::cerr << "Port and thread count changes take effect on restart" << std::endl;
+    }
+    if (Config::log_enabled(LogLevel::info)) {
+        std::cout << "Configuration reloaded" << std::endl;
+    }
+}
+
+void RestController::add_route(const Method& method, const std::string& target, RouteHandler handler, std::size_t body_limit,
+                               const ResponseHeaders::FieldList& headers) {
+    Route route{std::move(handler), body_limit, headers, std::string()};
     auto iter = routes.find(method);
     if (iter != routes.end()) {
-        iter->second.emplace(target, handler);
+        iter->second.emplace(target, route);
     } else {
-        std::unordered_map<std::string, HttpHandler> new_map;
-        new_map.emplace(target, handler);
+        std::unordered_map<std::string, Route> new_map;
+        new_map.emplace(target, route);
         routes.emplace(method, new_map);
     }
+    build_header_templates();
+}
+
+void RestController::add_websocket_route(const std::string& target, WebSocketHandlerFactory factory, std::size_t message_limit) {
+    websocket_routes.emplace(target, WebSocketRoute{std::move(factory), message_limit});
+}
+
+const WebSocketRoute* RestController::websocket_route(std::string_view target) const {
+    auto iter = websocket_routes.find(std::string(target));
+    return iter != websocket_routes.end() ? &iter->second : nullptr;
+}
+
+void RestController::build_header_templates() {
+    // The allowed methods are those of the registered routes, so every template is rebuilt
+    // when a route is added.
+    std::string methods;
+    for (const auto& [method, targets] : routes) {
+        auto name = boost::beast::http::to_string(method);
+        methods.append(name.data(), name.size());
+        methods += ", ";
+    }
+    methods += "OPTIONS";
+
+    ResponseHeaders::FieldList common = {
+        {boost::beast::http::field::server, "REST API"},
+        {boost::beast::http::field::access_control_allow_origin, "*"},
+        {boost::beast::http::field::access_control_allow_methods, methods},
+        {boost::beast::http::field::access_control_allow_headers, "Content-Type"}
+    };
+    default_headers_ = ResponseHeaders::make_template(common);
+    ResponseHeaders::FieldList preflight = common;
+    preflight.emplace_back(boost::beast::http::field::access_control_max_age, "86400");
+    preflight_headers_ = ResponseHeaders::make_template(preflight);
+    // A route's own fields come last, so they replace common ones with the same name.
+    for (auto& [method, targets] : routes) {
+        for (auto& [target, route] : targets) {
+            ResponseHeaders::FieldList fields = common;
+            fields.insert(fields.end(), route.fields.begin(), route.fields.end());
+            route.headers = ResponseHeaders::make_template(fields);
+        }
+    }
 }
 
-void RestController::handle_request(const BoostRequest& req, BoostResponse& res) {
-    // response with CORS headers
+std::size_t RestController::body_limit(Method method, std::string_view target) const {
+    auto methodIter = routes.find(method);
+    if (methodIter != routes.end()) {
+        auto targetIter = methodIter->second.find(std::string(target));
+        if (targetIter != methodIter->second.end() && targetIter->second.body_limit != 0) {
+            return targetIter->second.body_limit;
+        }
+    }
+    return default_body_limit_;
+}
+
+void RestController::prepare_response(BoostResponse& res) {
+    // The Server and CORS headers come from the header templates.
     res.version(11); // HTTP/1.1
-    res.set(boost::beast::http::field::server, "REST API");
-    res.set(boost::beast::http::field::access_control_allow_origin, "*");
-    res.set(boost::beast::http::field::access_control_allow_methods, "GET, POST");
-    res.set(boost::beast::http::field::access_control_allow_headers, "Content-Type");
-    
+}
+
+void RestController::error_response(boost::beast::http::status status, std::string_view message, BoostResponse& res) {
+    prepare_response(res);
+    res.result(status);
+    res.set(boost::beast::http::field::content_type, "application/json");
+    boost::json::object body_obj;
+    body_obj["message"] = message;
+    body_obj["status"] = "error";
+    res.body() = boost::json::serialize(body_obj);
+}
+
+const ResponseHeaders::Template& RestController::handler_error(const std::exception& error, BoostResponse& res) {
+    std::cerr << "Handler error: " << error.what() << std::endl;
+    bool keep_alive = res.keep_alive();
+    std::string body = std::move(res.body());
+    body.clear();
+    res = {};
+    res.body() = std::move(body);
+    error_response(boost::beast::http::status::internal_server_error, "Internal server error", res);
+    res.keep_alive(keep_alive);
+    return default_headers_;
+}
+
+RestController::Dispatch RestController::handle_request(const BoostRequest& req, BoostResponse& res) {
+    prepare_response(res);
+
     const auto& methodIter = routes.find(req.method());
     Method req_method = methodIter != routes.end() ? methodIter->first : Method::unknown;
     std::string target = req.target();
-    std::cout << "Request: " << req.method() << " " << req.target() << std::endl;
+    bool debug = Config::log_enabled(LogLevel::debug);
+    if (debug) {
+        std::cout << "Request: " << req.method() << " " << req.target() << std::endl;
+    }
 
     if (req_method == Method::get && target.compare("/") == 0)
         target = defaultTarget;
-    const std::string mime_type = get_mime_type(target);
-    const static std::string ui_prefix = "./ui";
 
-    if (mime_type.compare("application/octet-stream") != 0) {
-        std::string content = read_file(ui_prefix + target);
-        if (content.empty()) {
-            res.result(boost::beast::http::status::not_found);
-        } else {
-            res.result(boost::beast::http::status::ok);
-            res.set(boost::beast::http::field::content_type, mime_type);
-            res.body() = content;
-        }
-    } else if (methodIter != routes.end()) {
+    // API routes are matched first, so they never pay for the static file lookup.
+    const Route* route = nullptr;
+    if (methodIter != routes.end()) {
         auto targetIter = methodIter->second.find(target);
         if (targetIter != methodIter->second.end()) {
-            targetIter->second(req, res);
+            route = &targetIter->second;
+        }
+    }
+
+    const ResponseHeaders::Template* headers = &default_headers_;
+    std::string_view mime_type = route ? std::string_view() : MimeTypes::find(target);
+    if (route && route->handler.is_async()) {
+        return {&route->headers, &route->handler};
+    } else if (route) {
+        try {
+            route->handler(req, res);
+            headers = &route->headers;
+        } catch (const std::exception& e) {
+            headers = &handler_error(e, res);
+        }
+    } else if (req.method() == Method::options) {
+        // CORS preflight: everything is in the cached template.
+        res.result(boost::beast::http::status::no_content);
+        headers = &preflight_headers_;
+    } else if (!mime_type.empty()) {
+        if (const EmbeddedAsset* asset = find_embedded_asset(target)) {
+            serve_asset(*asset, req, res);
         } else {
-            res.result(boost::beast::http::status::not_found);
+            std::string content = read_file(ui_prefix_ + target);
+            if (content.empty()) {
+                res.result(boost::beast::http::status::not_found);
+            } else {
+                res.result(boost::beast::http::status::ok);
+                res.set(boost::beast::http::field::content_type, mime_type);
+                res.body() = content;
+            }
         }
+    } else if (methodIter != routes.end()) {
+        res.result(boost::beast::http::status::not_found);
     } else {
         res.result(boost::beast::http::status::bad_request);
     }
-    std::cout << "  Request: " << req.method() << " " << req.target() << " -> Response: " << res.reason() << std::endl; // res[boost::beast::http::field::content_type]
+    if (debug) {
+        std::cout << "  Request: " << req.method() << " " << req.target() << " -> Response: " << res.reason() << std::endl; // res[boost::beast::http::field::content_type]
+    }
 
 //    if (res.has_content_length() > 0 && res.find(boost::beast::http::field::content_type) != res.end() &&
 //        res[boost::beast::http::field::content_type].compare("application/json") == 0) {
 //        boost::json::value json_body = boost::json::parse(res.body());
 //        res.body() = boost::json::serialize(json_body);
 //    }
-    res.prepare_payload();
+    return {headers};
+}
+
+void RestController::serve_asset(const EmbeddedAsset& asset, const BoostRequest& req, BoostResponse& res) {
+    auto accept_encoding = req[boost::beast::http::field::accept_encoding];
+    bool gzip = !asset.gzip.empty() && accepts_gzip(std::string_view(accept_encoding.data(), accept_encoding.size()));
+    std::string_view etag = gzip ? asset.gzip_etag : asset.etag;
+
+    res.set(boost::beast::http::field::etag, etag);
+    res.set(boost::beast::http::field::cache_control, "no-cache");
+    if (!asset.gzip.empty()) {
+        res.set(boost::beast::http::field::vary, "Accept-Encoding");
+    }
+    auto if_none_match = req[boost::beast::http::field::if_none_match];
+    if (etag_matches(std::string_view(if_none_match.data(), if_none_match.size()), etag)) {
+        res.result(boost::beast::http::status::not_modified);
+        return;
+    }
+
+    res.result(boost::beast::http::status::ok);
+    res.set(boost::beast::http::field::content_type, asset.mime_type);
+    if (gzip) {
+        res.set(boost::beast::http::field::content_encoding, "gzip");
+    }
+    std::string_view content = gzip ? asset.gzip : asset.data;
+    res.body().assign(content.data(), content.size());
+}
+
+bool RestController::accepts_gzip(std::string_view accept_encoding) {
+    while (!accept_encoding.empty()) {
+        std::size_t end = accept_encoding.find(',');
+        std::string_view coding = accept_encoding.substr(0, end);
+        accept_encoding = end == std::string_view::npos ? std::string_view() : accept_encoding.substr(end + 1);
+
+        std::size_t params = coding.find(';');
+        std::string_view name = coding.substr(0, params);
+        std::size_t first = name.find_first_not_of(' ');
+        std::size_t last = name.find_last_not_of(' ');
+        name = first == std::string_view::npos ? std::string_view() : name.substr(first, last - first + 1);
+        if (!boost::beast::iequals(name, "gzip") && name != "*") {
+            continue;
+        }
+        // "gzip;q=0" explicitly refuses it.
+        std::size_t q = params == std::string_view::npos ? std::string_view::npos : coding.find("q=", params);
+        if (q == std::string_view::npos) {
+            return true;
+        }
+        std::string_view weight = coding.substr(q + 2);
+        return weight.find_first_not_of("0. ") != std::string_view::npos;
+    }
+    return false;
+}
+
+bool RestController::etag_matches(std::string_view if_none_match, std::string_view etag) {
+    while (!if_none_match.empty()) {
+        std::size_t end = if_none_match.find(',');
+        std::string_view tag = if_none_match.substr(0, end);
+        if_none_match = end == std::string_view::npos ? std::string_view() : if_none_match.substr(end + 1);
+
+        std::size_t first = tag.find_first_not_of(' ');
+        if (first == std::string_view::npos) {
+            continue;
+        }
+        tag = tag.substr(first, tag.find_last_not_of(' ') - first + 1);
+        // If-None-Match uses weak comparison.
+        if (tag.substr(0, 2) == "W/") {
+            tag.remove_prefix(2);
+        }
+        if (tag == "*" || tag == etag) {
+            return true;
+        }
+    }
+    return false;
 }
 
 std::string RestController::read_file(const std::string& path) {
@@ -96,40 +436,7 @@ std::string RestController::read_file(const std::string& path) {
     return buffer.str();
 }
 
-std::string RestController::get_mime_type(const std::string& path) {
-    static const std::unordered_map<std::string, std::string> mime_types = {
-        {".htm", "text/html"},
-        {".html", "text/html"},
-        {".php", "text/html"},
-        {".css", "text/css"},
-        {".txt", "text/plain"},
-        {".js", "application/javascript"},
-        {".json", "application/json"},
-        {".xml", "application/xml"},
-        {".swf", "application/x-shockwave-flash"},
-        {".flv", "video/x-flv"},
-        {".png", "image/png"},
-        {".jpe", "image/jpeg"},
-        {".jpeg", "image/jpeg"},
-        {".jpg", "image/jpeg"},
-        {".gif", "image/gif"},
-        {".bmp", "image/bmp"},
-        {".ico", "image/vnd.microsoft.icon"},
-        {".tiff", "image/tiff"},
-        {".tif", "image/tiff"},
-        {".svg", "image/svg+xml"},
-        {".svgz", "image/svg+xml"}
-    };
-    
-    const auto extension_index = path.rfind('.');
-    if (extension_index == std::string::npos) {
-        return "application/octet-stream";
-    }
-    const auto& extension = path.substr(extension_index);
-    
-    auto it = mime_types.find(extension);
-    if (it != mime_types.end()) {
-        return it->second;
-    }
-    return "application/octet-stream";
+std::string_view RestController::get_mime_type(std::string_view path) {
+    std::string_view mime_type = MimeTypes::find(path);
+    return mime_type.empty() ? "application/octet-stream" : mime_type;
 }
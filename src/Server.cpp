@@ -1,32 +1,186 @@
 #include "Server.h"
 #include "Session.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
 
-Server::Server(boost::asio::io_context& ioc, boost::asio::ip::tcp::endpoint endpoint) : acceptor(ioc) {
+Server::Server(boost::asio::io_context& ioc, boost::asio::ip::tcp::endpoint endpoint, const ServerOptions& options)
+    : options(options),
+      timeouts(std::make_shared<const Session::Timeouts>(options.timeouts)),
+      ioc(ioc),
+      acceptor(boost::asio::make_strand(ioc)),
+      accept_retry_timer(acceptor.get_executor()),
+      timer_wheel(boost::asio::use_service<TimerWheel>(ioc)),
+      session_pool(std::make_shared<SessionPool>(options.session_pool)),
+      connection_limiter(std::make_shared<ConnectionLimiter>(options.max_connections, options.max_connections_per_ip)) {
+    configure_listener(endpoint);
+    connection_limiter->on_capacity_available([this]() { resume_accept(); });
+    do_accept();
+}
+
+Server::~Server() {
+    connection_limiter->on_capacity_available(nullptr);
+}
+
+void Server::configure_listener(const boost::asio::ip::tcp::endpoint& endpoint) {
     boost::system::error_code ec;
+    if (options.listen_fd >= 0) {
+        // Inherited from the previous process (or systemd), already bound and listening.
+        if (acceptor.assign(endpoint.protocol(), options.listen_fd, ec); ec) {
+            throw std::runtime_error("Assign error: " + ec.message());
+        }
+        return;
+    }
     if (acceptor.open(endpoint.protocol(), ec); ec) {
         throw std::runtime_error("Open error: " + ec.message());
     }
     if (acceptor.set_option(boost::asio::socket_base::reuse_address(true), ec); ec) {
         throw std::runtime_error("Set option error: " + ec.message());
     }
+    // Buffer sizes are inherited by accepted sockets and must be set before listen() to
+    // affect the advertised window scale.
+    if (options.receive_buffer_size > 0 &&
+        (acceptor.set_option(boost::asio::socket_base::receive_buffer_size(options.receive_buffer_size), ec), ec)) {
+        throw std::runtime_error("Set option error: " + ec.message());
+    }
+    if (options.send_buffer_size > 0 &&
+        (acceptor.set_option(boost::asio::socket_base::send_buffer_size(options.send_buffer_size), ec), ec)) {
+        throw std::runtime_error("Set option error: " + ec.message());
+    }
     if (acceptor.bind(endpoint, ec); ec) {
         throw std::runtime_error("Bind error: " + ec.message());
     }
-    if (acceptor.listen(boost::asio::socket_base::max_listen_connections, ec); ec) {
+#ifdef TCP_DEFER_ACCEPT
+    if (options.defer_accept_seconds > 0 &&
+        ::setsockopt(acceptor.native_handle(), IPPROTO_TCP, TCP_DEFER_ACCEPT, &options.defer_accept_seconds, sizeof(int)) != 0) {
+        std::cerr << "TCP_DEFER_ACCEPT not applied: " << std::strerror(errno) << std::endl;
+    }
+#endif
+#ifdef TCP_FASTOPEN
+    if (options.fastopen_queue > 0 &&
+        ::setsockopt(acceptor.native_handle(), IPPROTO_TCP, TCP_FASTOPEN, &options.fastopen_queue, sizeof(int)) != 0) {
+        std::cerr << "TCP_FASTOPEN not applied: " << std::strerror(errno) << std::endl;
+    }
+#endif
+    if (acceptor.listen(options.backlog, ec); ec) {
         throw std::runtime_error("Listen error: " + ec.message());
     }
-    do_accept();
 }
 
 void Server::do_accept() {
-    acceptor.async_accept(
-        [this](boost::beast::error_code ec, boost::asio::ip::tcp::socket socket) {
-            if (ec) {
-                do_accept(); // Retry accepting
-                throw std::runtime_error("Accept error: " + ec.message());
-            } else {
-                std::make_shared<Session>(std::move(socket))->run();
-                do_accept(); // Continue accepting new connections
+    while (!stopped && accepts_pending < std::max<std::size_t>(options.accepts_in_flight, 1)) {
+        // Each pending accept may take a slot, so never post more than there are free; the
+        // rest of the clients wait in the listen backlog instead of being accepted and closed.
+        if (accepts_pending >= connection_limiter->available()) {
+            if (accepts_pending == 0) {
+                pause_accept();
+            }
+            return;
+        }
+        ++accepts_pending;
+        // Each connection gets its own strand so the timer wheel can close it from any thread.
+        acceptor.async_accept(boost::asio::make_strand(ioc),
+            [this](boost::beast::error_code ec, boost::asio::ip::tcp::socket socket) {
+                --accepts_pending;
+                on_accept(ec, std::move(socket));
+            });
+    }
+}
+
+void Server::on_accept(boost::beast::error_code ec, boost::asio::ip::tcp::socket socket) {
+    if (ec == boost::asio::error::operation_aborted) {
+        return; // Acceptor closed
+    }
+    if (ec == boost::asio::error::no_descriptors || ec == boost::asio::error::no_buffer_space ||
+        ec == boost::asio::error::no_memory || ec.value() == ENFILE) {
+        // Out of descriptors or memory: back off and let the backlog queue up instead of spinning.
+        std::cerr << "Accept error: " << ec.message() << ", retrying in " << options.accept_retry_delay.count() << "ms" << std::endl;
+        ++accept_pause_count;
+        accept_retry_timer.expires_after(options.accept_retry_delay);
+        accept_retry_timer.async_wait([this](boost::beast::error_code timer_ec) {
+            if (!timer_ec) {
+                do_accept();
             }
         });
+        return;
+    }
+    if (ec) {
+        std::cerr << "Accept error: " << ec.message() << std::endl;
+        do_accept();
+        return;
+    }
+
+    boost::beast::error_code endpoint_ec;
+    boost::asio::ip::address address = socket.remote_endpoint(endpoint_ec).address();
+    if (endpoint_ec) {
+        do_accept(); // Peer already gone
+        return;
+    }
+    if (!connection_limiter->try_acquire(address)) {
+        // Over the per-address cap, or over a global cap a reload lowered.
+        boost::beast::error_code close_ec;
+        socket.close(close_ec);
+        do_accept();
+        return;
+    }
+    if (options.tcp_nodelay) {
+        socket.set_option(boost::asio::ip::tcp::no_delay(true), endpoint_ec);
+    }
+
+    // Failures here must not escape into io_context::run(); the connection is dropped instead.
+    std::shared_ptr<Session> session;
+    try {
+        session = session_pool->acquire(std::move(socket));
+    } catch (const std::exception& e) {
+        std::cerr << "Session error: " << e.what() << std::endl;
+        connection_limiter->release(address);
+    }
+    if (session) {
+        try {
+            session->run(timer_wheel, *std::atomic_load(&timeouts), connection_limiter, address); // The session releases its slot
+        } catch (const std::exception& e) {
+            std::cerr << "Session error: " << e.what() << std::endl;
+        }
+    }
+    do_accept(); // Continue accepting new connections
+}
+
+void Server::reload(const ServerOptions& updated) {
+    std::atomic_store(&timeouts, std::make_shared<const Session::Timeouts>(updated.timeouts));
+    session_pool->set_limits(updated.session_pool);
+    connection_limiter->set_limits(updated.max_connections, updated.max_connections_per_ip);
+}
+
+void Server::shutdown() {
+    stopped = true;
+    boost::asio::post(acceptor.get_executor(), [this]() {
+        boost::system::error_code ec;
+        acceptor.close(ec);
+        accept_retry_timer.cancel();
+        // On the acceptor's strand, so no connection accepted before the close is missed.
+        session_pool->for_each_active([](const std::shared_ptr<Session>& session) { session->drain(); });
+    });
+}
+
+void Server::close_connections() {
+    session_pool->for_each_active([](const std::shared_ptr<Session>& session) { session->close(); });
+}
+
+void Server::pause_accept() {
+    ++accept_pause_count;
+    accept_paused = true;
+    // A slot may have been released between the capacity check and setting the flag.
+    if (connection_limiter->has_capacity()) {
+        resume_accept();
+    }
+}
+
+void Server::resume_accept() {
+    if (accept_paused.exchange(false)) {
+        boost::asio::post(acceptor.get_executor(), [this]() { do_accept(); });
+    }
 }
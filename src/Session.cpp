@@ -1,40 +1,448 @@
 #include "Session.h"
+#include "ResponseHeaders.h"
+#ifdef REST_API_HAS_HTTP2
+#include "Http2Session.h"
+#endif
 #include "RestController.h"
+#include "WebSocketSession.h"
+#include <array>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
 #include <boost/json.hpp>
+#include <charconv>
 #include <iostream>
+#include <limits>
 
-void Session::run() {
-    read_request();
+void Session::run(TimerWheel& wheel, const Timeouts& timeouts, std::shared_ptr<ConnectionLimiter> limiter, const boost::asio::ip::address& peer) {
+    limiter_ = std::move(limiter);
+    peer_ = peer;
+    wheel_ = &wheel;
+    timeouts_ = timeouts;
+    // Handlers' exceptions are answered with a 500 in process_request(); anything else that
+    // escapes serve() ends this connection, never io_context::run().
+    boost::asio::co_spawn(socket_.get_executor(), serve(shared_from_this()), [self = shared_from_this()](std::exception_ptr error) {
+        if (!error) {
+            return;
+        }
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::exception& e) {
+            std::cerr << "Session error: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Session error: unknown exception" << std::endl;
+        }
+        boost::beast::error_code ec;
+        self->socket_.close(ec);
+    });
 }
 
-void Session::read_request() {
+void Session::recycle(std::size_t max_buffer_capacity, std::size_t max_body_capacity) {
+    disarm_timeout();
+    boost::beast::error_code ec;
+    socket_.close(ec);
+    if (limiter_) {
+        limiter_->release(peer_);
+        limiter_.reset();
+    }
+    websocket_.reset();
+#ifdef REST_API_HAS_HTTP2
+    http2_.reset();
+#endif
+
+    buffer_.clear();
+    if (buffer_.capacity() > max_buffer_capacity) {
+        buffer_.shrink_to_fit();
+    }
+    header_.clear();
+    if (header_.capacity() > max_buffer_capacity) {
+        header_.shrink_to_fit();
+    }
+
+    // Reassigning the messages frees the header fields; the bodies keep their capacity.
+    std::string req_body = std::move(req_.body());
+    std::string res_body = std::move(res_.body());
+    req_ = {};
+    res_ = {};
+    req_body.clear();
+    res_body.clear();
+    if (req_body.capacity() <= max_body_capacity) {
+        req_.body() = std::move(req_body);
+    }
+    if (res_body.capacity() <= max_body_capacity) {
+        res_.body() = std::move(res_body);
+    }
+}
+
+void Session::reset(boost::asio::ip::tcp::socket socket) {
+    socket_ = std::move(socket);
+    idle_ = false;
+    draining_ = false;
+}
+
+void Session::drain() {
     auto self = shared_from_this();
-    boost::beast::http::async_read(socket_, buffer_, req_,
-        [self](boost::beast::error_code ec, std::size_t bytes_transferred) {
-            if (!ec) {
-                self->process_request();
-            } else {
-                std::cerr << "Read error: " << ec.message() << std::endl;
-            }
-        });
+    boost::asio::post(socket_.get_executor(), [self]() {
+        self->draining_ = true;
+        if (auto websocket = self->websocket_.lock()) {
+            websocket->drain();
+            return;
+        }
+#ifdef REST_API_HAS_HTTP2
+        if (auto http2 = self->http2_.lock()) {
+            http2->drain();
+            return;
+        }
+#endif
+        if (self->idle_) {
+            boost::beast::error_code ec;
+            self->socket_.close(ec);
+        }
+    });
+}
+
+void Session::close() {
+    auto self = shared_from_this();
+    boost::asio::post(socket_.get_executor(), [self]() {
+        if (auto websocket = self->websocket_.lock()) {
+            websocket->close();
+            return;
+        }
+#ifdef REST_API_HAS_HTTP2
+        if (auto http2 = self->http2_.lock()) {
+            http2->close();
+            return;
+        }
+#endif
+        boost::beast::error_code ec;
+        self->socket_.close(ec);
+    });
+}
+
+std::size_t Session::retained_bytes() const {
+    return sizeof(Session) + buffer_.capacity() + header_.capacity() + req_.body().capacity() + res_.body().capacity();
+}
+
+void Session::arm_timeout(std::chrono::milliseconds timeout) {
+    wheel_->schedule(*this, timeout);
 }
 
-void Session::process_request() {
-    RestController::getInstance()->handle_request(req_, res_);
-    write_response();
+void Session::disarm_timeout() {
+    if (wheel_) {
+        wheel_->cancel(*this);
+    }
 }
 
-void Session::write_response() {
+std::shared_ptr<void> Session::lock_owner() {
+    return weak_from_this().lock();
+}
+
+void Session::on_timeout() {
+    // Runs on the wheel's thread; closing the socket on the session's strand aborts the
+    // pending operation and lets serve() wind down.
     auto self = shared_from_this();
-    boost::beast::http::async_write(socket_, res_,
-        [self](boost::beast::error_code ec, std::size_t bytes_transferred) {
+    boost::asio::post(socket_.get_executor(), [self]() {
+        boost::beast::error_code ec;
+        self->socket_.close(ec);
+    });
+}
+
+boost::asio::awaitable<void> Session::serve(std::shared_ptr<Session> self) {
+    while (co_await read_request()) {
+        disarm_timeout();
+        if (!draining_ && boost::beast::websocket::is_upgrade(req_) && start_websocket()) {
+            co_return;
+        }
+#ifdef REST_API_HAS_HTTP2
+        if (!draining_) {
+            if (auto settings = Http2Session::upgrade_settings(req_)) {
+                co_await upgrade_to_http2(std::move(*settings));
+                co_return;
+            }
+        }
+#endif
+        if (!co_await process_request()) {
+            co_return;
+        }
+        if (!(streaming_ ? co_await finish_stream() : co_await write_response())) {
+            co_return;
+        }
+        if (!res_.keep_alive()) {
+            boost::beast::error_code ec;
+            socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
             if (ec) {
-                std::cerr << "Write error: " << ec.message() << std::endl;
+                std::cerr << "Shutdown error: " << ec.message() << std::endl;
             }
-            boost::beast::error_code shutdown_ec;
-            self->socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, shutdown_ec);
-            if (shutdown_ec) {
-                std::cerr << "Shutdown error: " << shutdown_ec.message() << std::endl;
+            co_return;
+        }
+        std::string body = std::move(res_.body());
+        body.clear();
+        res_ = {};
+        res_.body() = std::move(body);
+
+        if (draining_) {
+            // The server is shutting down; the response just written was the last one.
+            boost::beast::error_code ec;
+            socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+            co_return;
+        }
+        if (buffer_.size() == 0) {
+            // Nothing pipelined; wait for the next keep-alive request.
+            boost::beast::error_code ec;
+            arm_timeout(timeouts_.idle);
+            idle_ = true;
+            co_await socket_.async_wait(boost::asio::ip::tcp::socket::wait_read, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            idle_ = false;
+            if (ec) {
+                co_return;
+            }
+        }
+    }
+}
+
+boost::asio::awaitable<bool> Session::read_request() {
+    auto controller = RestController::getInstance();
+
+    // Parse straight into the recycled body string so its capacity carries over.
+    std::string body = std::move(req_.body());
+    body.clear();
+    req_ = {};
+    parser_.emplace(std::piecewise_construct, std::make_tuple(std::move(body)));
+    parser_->header_limit(controller->header_limit());
+    // The route's body limit is only known once the header is in.
+    parser_->body_limit(std::numeric_limits<std::uint64_t>::max());
+
+    boost::beast::error_code ec;
+    arm_timeout(timeouts_.header);
+    co_await boost::beast::http::async_read_header(socket_, buffer_, *parser_, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    if (ec) {
+        co_await handle_read_error(ec);
+        co_return false;
+    }
+
+    const auto& header = parser_->get();
+    std::size_t limit = controller->body_limit(header.method(), header.target());
+    auto content_length = parser_->content_length();
+    if (content_length && *content_length > limit) {
+        // Reject before the body is read; the connection is closed afterwards.
+        co_await reject(boost::beast::http::status::payload_too_large, "Request body too large");
+        co_return false;
+    }
+    parser_->body_limit(limit);
+    arm_timeout(timeouts_.body);
+
+    if (!parser_->is_done()) {
+        if (boost::beast::iequals(header[boost::beast::http::field::expect], "100-continue")) {
+            static const std::string_view continue_response = "HTTP/1.1 100 Continue\r\n\r\n";
+            co_await boost::asio::async_write(socket_, boost::asio::buffer(continue_response.data(), continue_response.size()),
+                                              boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (ec) {
+                std::cerr << "Write error: " << ec.message() << std::endl;
+                co_return false;
             }
-        });
+        }
+        co_await boost::beast::http::async_read(socket_, buffer_, *parser_, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        if (ec) {
+            co_await handle_read_error(ec);
+            co_return false;
+        }
+    }
+    req_ = parser_->release();
+    co_return true;
+}
+
+boost::asio::awaitable<void> Session::handle_read_error(boost::beast::error_code ec) {
+#ifdef REST_API_HAS_HTTP2
+    if (ec == boost::beast::http::error::bad_version) {
+        std::string_view received(static_cast<const char*>(buffer_.data().data()), buffer_.size());
+        if (received.substr(0, Http2Session::preface_head.size()) == Http2Session::preface_head) {
+            start_http2(std::nullopt, {});
+            co_return;
+        }
+    }
+#endif
+    if (ec == boost::beast::http::error::body_limit) {
+        co_await reject(boost::beast::http::status::payload_too_large, "Request body too large");
+    } else if (ec == boost::beast::http::error::header_limit) {
+        co_await reject(boost::beast::http::status::request_header_fields_too_large, "Request header too large");
+    } else if (ec != boost::beast::http::error::end_of_stream && ec != boost::asio::error::operation_aborted &&
+               ec != boost::asio::error::bad_descriptor) {
+        std::cerr << "Read error: " << ec.message() << std::endl;
+    }
+}
+
+boost::asio::awaitable<void> Session::reject(boost::beast::http::status status, std::string_view message) {
+    auto controller = RestController::getInstance();
+    controller->error_response(status, message, res_);
+    static_headers_ = &controller->default_headers();
+    res_.keep_alive(false);
+    if (co_await write_response()) {
+        boost::beast::error_code ec;
+        socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+    }
+}
+
+// Sends each piece as a chunk, the first one after the header. HTTP/1.0 has no chunked
+// encoding, and a response without a body must not be chunked, so there the pieces are
+// collected and put before res_.body() at the end (a HEAD response then gets the
+// Content-Length a GET would).
+class Session::Stream : public ResponseStream {
+public:
+    explicit Stream(Session& session) : session(session) {}
+
+    boost::asio::awaitable<void> write(std::string_view data) override {
+        if (session.req_.version() < 11 || !session.has_body()) {
+            collected.append(data);
+            co_return;
+        }
+        if (data.empty()) {
+            co_return; // An empty chunk would end the body
+        }
+        bool first = !session.streaming_;
+        if (first) {
+            session.header_.clear();
+            ResponseHeaders::serialize(session.res_, *session.static_headers_, session.header_, true);
+            session.streaming_ = true;
+        }
+        char size[24];
+        std::size_t size_length = std::to_chars(size, size + sizeof(size) - 2, data.size(), 16).ptr - size;
+        size[size_length++] = '\r';
+        size[size_length++] = '\n';
+        std::array<boost::asio::const_buffer, 4> buffers = {boost::asio::buffer(session.header_.data(), first ? session.header_.size() : 0),
+                                                            boost::asio::buffer(size, size_length), boost::asio::buffer(data.data(), data.size()),
+                                                            boost::asio::buffer("\r\n", 2)};
+        boost::beast::error_code ec;
+        session.arm_timeout(session.timeouts_.write);
+        co_await boost::asio::async_write(session.socket_, buffers, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+        session.disarm_timeout();
+        if (ec) {
+            throw boost::system::system_error(ec);
+        }
+    }
+
+    // Puts what was collected before the body the handler left.
+    void finish() {
+        if (!collected.empty()) {
+            session.res_.body().insert(0, collected);
+        }
+    }
+
+private:
+    Session& session;
+    std::string collected;
+};
+
+boost::asio::awaitable<bool> Session::process_request() {
+    auto controller = RestController::getInstance();
+    streaming_ = false;
+    res_.keep_alive(req_.keep_alive() && !draining_);
+    RestController::Dispatch dispatch = controller->handle_request(req_, res_);
+    static_headers_ = dispatch.headers;
+    if (!dispatch.pending) {
+        co_return true;
+    }
+    try {
+        Stream stream(*this);
+        co_await dispatch.pending->async(req_, res_, stream);
+        stream.finish();
+    } catch (const std::exception& e) {
+        if (!streaming_) {
+            static_headers_ = &controller->handler_error(e, res_);
+            co_return true;
+        }
+        // The status went out with the first chunk; leave the body unterminated so the
+        // client sees the response is cut short.
+        std::cerr << "Handler error: " << e.what() << std::endl;
+        boost::beast::error_code ec;
+        socket_.close(ec);
+        co_return false;
+    }
+    co_return true;
+}
+
+boost::asio::awaitable<bool> Session::finish_stream() {
+    // The rest of the body, if any, as a last data chunk, then the zero-length chunk.
+    std::string_view body = res_.body();
+    char size[24];
+    std::size_t size_length = std::to_chars(size, size + sizeof(size) - 2, body.size(), 16).ptr - size;
+    size[size_length++] = '\r';
+    size[size_length++] = '\n';
+    static const std::string_view last_chunk = "0\r\n\r\n";
+    std::array<boost::asio::const_buffer, 4> buffers = {boost::asio::buffer(size, body.empty() ? 0 : size_length), boost::asio::buffer(body.data(), body.size()),
+                                                        boost::asio::buffer("\r\n", body.empty() ? 0 : 2),
+                                                        boost::asio::buffer(last_chunk.data(), last_chunk.size())};
+    boost::beast::error_code ec;
+    arm_timeout(timeouts_.write);
+    co_await boost::asio::async_write(socket_, buffers, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    disarm_timeout();
+    if (ec) {
+        std::cerr << "Write error: " << ec.message() << std::endl;
+        co_return false;
+    }
+    co_return true;
+}
+
+bool Session::has_body() const {
+    unsigned status = res_.result_int();
+    return req_.method() != boost::beast::http::verb::head && status >= 200 && status != 204 && status != 304;
+}
+
+boost::asio::awaitable<bool> Session::write_response() {
+    arm_timeout(timeouts_.write);
+    // The header block is written by hand from the route's template; header and body go
+    // out in one gathered write.
+    header_.clear();
+    ResponseHeaders::serialize(res_, *static_headers_, header_);
+    std::array<boost::asio::const_buffer, 2> buffers = {boost::asio::buffer(header_), boost::asio::buffer(res_.body().data(), has_body() ? res_.body().size() : 0)};
+    boost::beast::error_code ec;
+    co_await boost::asio::async_write(socket_, buffers, boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    disarm_timeout();
+    if (ec) {
+        std::cerr << "Write error: " << ec.message() << std::endl;
+        co_return false;
+    }
+    co_return true;
+}
+
+bool Session::start_websocket() {
+    auto controller = RestController::getInstance();
+    const WebSocketRoute* route = controller->websocket_route(req_.target());
+    if (!route) {
+        return false;
+    }
+    auto websocket = std::make_shared<WebSocketSession>(std::move(socket_), shared_from_this(), route->factory());
+    websocket_ = websocket;
+    websocket->start(req_, timeouts_, route->message_limit ? route->message_limit : controller->default_body_limit());
+    return true;
+}
+
+#ifdef REST_API_HAS_HTTP2
+boost::asio::awaitable<void> Session::upgrade_to_http2(std::string settings) {
+    arm_timeout(timeouts_.write);
+    static const std::string_view switching_protocols = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    boost::beast::error_code ec;
+    co_await boost::asio::async_write(socket_, boost::asio::buffer(switching_protocols.data(), switching_protocols.size()),
+                                      boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    disarm_timeout();
+    if (ec) {
+        std::cerr << "Write error: " << ec.message() << std::endl;
+        co_return;
+    }
+    start_http2(std::move(req_), std::move(settings));
+}
+
+void Session::start_http2(std::optional<boost::beast::http::request<boost::beast::http::string_body>> upgrade, std::string settings) {
+    disarm_timeout();
+    // Everything read past the upgrade request (or the whole preface) belongs to the HTTP/2 connection.
+    std::string received = boost::beast::buffers_to_string(buffer_.data());
+    buffer_.consume(buffer_.size());
+
+    auto http2 = std::make_shared<Http2Session>(std::move(socket_), shared_from_this(), *wheel_, timeouts_);
+    http2_ = http2;
+    if (upgrade) {
+        http2->start_upgraded(std::move(*upgrade), settings, received);
+    } else {
+        http2->start(received);
+    }
 }
+#endif
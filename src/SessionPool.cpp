@@ -0,0 +1,136 @@
+#include "SessionPool.h"
+#include "Session.h"
+
+template <class T>
+class SessionPool::ControlBlockAllocator {
+public:
+    using value_type = T;
+
+    // Holds a strong reference: the control block is released after the deleter has run.
+    explicit ControlBlockAllocator(std::shared_ptr<SessionPool> pool) : pool(std::move(pool)) {}
+
+    template <class U>
+    ControlBlockAllocator(const ControlBlockAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(pool->allocate_control_block(n * sizeof(T))); }
+    void deallocate(T* p, std::size_t n) { pool->deallocate_control_block(p, n * sizeof(T)); }
+
+    template <class U>
+    bool operator==(const ControlBlockAllocator<U>& other) const { return pool == other.pool; }
+    template <class U>
+    bool operator!=(const ControlBlockAllocator<U>& other) const { return pool != other.pool; }
+
+private:
+    template <class U>
+    friend class ControlBlockAllocator;
+
+    std::shared_ptr<SessionPool> pool;
+};
+
+SessionPool::~SessionPool() {
+    for (Session* session : idle) {
+        delete session;
+    }
+    for (void* block : free_blocks) {
+        ::operator delete(block);
+    }
+}
+
+std::shared_ptr<Session> SessionPool::acquire(boost::asio::ip::tcp::socket socket) {
+    Session* session = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!idle.empty()) {
+            session = idle.back();
+            idle.pop_back();
+            counters.retained_bytes -= session->retained_bytes();
+            ++counters.hits;
+        } else {
+            ++counters.misses;
+        }
+    }
+
+    if (session) {
+        session->reset(std::move(socket));
+    } else {
+        session = new Session(std::move(socket));
+    }
+
+    auto self = shared_from_this();
+    std::shared_ptr<Session> shared(session, [self](Session* s) { self->recycle(s); }, ControlBlockAllocator<Session>(self));
+    std::lock_guard<std::mutex> lock(mtx);
+    active.insert(session);
+    return shared;
+}
+
+SessionPool::Stats SessionPool::stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    Stats result = counters;
+    result.idle = idle.size();
+    return result;
+}
+
+void SessionPool::set_limits(const Limits& limits) {
+    std::lock_guard<std::mutex> lock(mtx);
+    this->limits = limits;
+}
+
+void SessionPool::for_each_active(const std::function<void(const std::shared_ptr<Session>&)>& visitor) {
+    std::vector<std::shared_ptr<Session>> sessions;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        sessions.reserve(active.size());
+        for (Session* session : active) {
+            // A session whose last reference is gone is about to be recycled.
+            if (auto shared = session->weak_from_this().lock()) {
+                sessions.push_back(std::move(shared));
+            }
+        }
+    }
+    for (const auto& session : sessions) {
+        visitor(session);
+    }
+}
+
+void SessionPool::recycle(Session* session) {
+    std::unique_lock<std::mutex> lock(mtx);
+    active.erase(session);
+    Limits current = limits;
+    lock.unlock();
+    session->recycle(current.max_buffer_capacity, current.max_body_capacity);
+
+    lock.lock();
+    if (idle.size() >= limits.max_idle) {
+        lock.unlock();
+        delete session;
+        return;
+    }
+    counters.retained_bytes += session->retained_bytes();
+    idle.push_back(session);
+}
+
+void* SessionPool::allocate_control_block(std::size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (block_size == 0) {
+            block_size = bytes;
+        }
+        if (bytes == block_size && !free_blocks.empty()) {
+            void* block = free_blocks.back();
+            free_blocks.pop_back();
+            return block;
+        }
+    }
+    return ::operator new(bytes);
+}
+
+void SessionPool::deallocate_control_block(void* block, std::size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (bytes == block_size && free_blocks.size() < limits.max_idle) {
+            free_blocks.push_back(block);
+            return;
+        }
+    }
+    ::operator delete(block);
+}
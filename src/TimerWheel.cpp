@@ -0,0 +1,122 @@
+#include "TimerWheel.h"
+
+boost::asio::io_context::id TimerWheel::id;
+
+TimerWheel::TimerWheel(boost::asio::io_context& ioc)
+    : boost::asio::io_context::service(ioc), slots(slot_count, nullptr), timer(ioc) {
+}
+
+void TimerWheel::schedule(Entry& entry, Duration timeout) {
+    std::size_t ticks = std::max<std::size_t>(1, (timeout + resolution - Duration(1)) / resolution);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (stopped) {
+        return;
+    }
+    if (entry.scheduled) {
+        unlink(entry);
+    }
+    entry.rounds = (ticks - 1) / slot_count;
+    link(entry, (cursor + ticks) % slot_count);
+    start_ticking();
+}
+
+void TimerWheel::cancel(Entry& entry) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (entry.scheduled) {
+        unlink(entry);
+    }
+}
+
+std::size_t TimerWheel::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return count;
+}
+
+void TimerWheel::shutdown() {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopped = true;
+    timer.cancel();
+}
+
+void TimerWheel::start_ticking() {
+    // Called with the lock held. The timer only runs while entries are scheduled, so an
+    // idle wheel does not keep io_context::run() from returning.
+    if (ticking) {
+        return;
+    }
+    ticking = true;
+    next_tick = std::chrono::steady_clock::now() + resolution;
+    timer.expires_at(next_tick);
+    timer.async_wait([this](boost::system::error_code ec) {
+        if (!ec) {
+            tick();
+        }
+    });
+}
+
+void TimerWheel::tick() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        cursor = (cursor + 1) % slot_count;
+        Entry* entry = slots[cursor];
+        while (entry) {
+            Entry* next = entry->next;
+            if (entry->rounds > 0) {
+                --entry->rounds;
+            } else {
+                unlink(*entry);
+                if (auto owner = entry->lock_owner()) {
+                    expired.emplace_back(std::move(owner), entry);
+                }
+            }
+            entry = next;
+        }
+    }
+
+    for (auto& [owner, entry] : expired) {
+        entry->on_timeout();
+    }
+    expired.clear();
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (stopped || count == 0) {
+        ticking = false;
+        return;
+    }
+    // Fixed cadence: a late tick does not push the following ones back.
+    next_tick += resolution;
+    timer.expires_at(next_tick);
+    timer.async_wait([this](boost::system::error_code ec) {
+        if (!ec) {
+            tick();
+        }
+    });
+}
+
+void TimerWheel::link(Entry& entry, std::size_t slot) {
+    entry.slot = slot;
+    entry.prev = nullptr;
+    entry.next = slots[slot];
+    if (entry.next) {
+        entry.next->prev = &entry;
+    }
+    slots[slot] = &entry;
+    entry.scheduled = true;
+    ++count;
+}
+
+void TimerWheel::unlink(Entry& entry) {
+    if (entry.prev) {
+        entry.prev->next = entry.next;
+    } else {
+        slots[entry.slot] = entry.next;
+    }
+    if (entry.next) {
+        entry.next->prev = entry.prev;
+    }
+    entry.prev = nullptr;
+    entry.next = nullptr;
+    entry.scheduled = false;
+    --count;
+}
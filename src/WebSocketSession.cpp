@@ -0,0 +1,94 @@
+#include "WebSocketSession.h"
+#include <boost/asio/post.hpp>
+#include <iostream>
+
+WebSocketSession::WebSocketSession(boost::asio::ip::tcp::socket socket, std::shared_ptr<void> owner, std::unique_ptr<WebSocketHandler> handler)
+    : ws_(std::move(socket)), owner_(std::move(owner)), handler_(std::move(handler)) {}
+
+void WebSocketSession::start(const Request& upgrade, const Session::Timeouts& timeouts, std::size_t message_limit) {
+    // Beast's own timers: the handshake gets the write timeout, and an idle connection is
+    // pinged once before it is dropped.
+    boost::beast::websocket::stream_base::timeout timeout{};
+    timeout.handshake_timeout = timeouts.write;
+    timeout.idle_timeout = timeouts.idle;
+    timeout.keep_alive_pings = true;
+    ws_.set_option(timeout);
+    ws_.set_option(boost::beast::websocket::stream_base::decorator([](boost::beast::websocket::response_type& res) {
+        res.set(boost::beast::http::field::server, "REST API");
+    }));
+    ws_.read_message_max(message_limit);
+
+    auto self = shared_from_this();
+    ws_.async_accept(upgrade, [self](boost::beast::error_code ec) {
+        if (ec) {
+            std::cerr << "WebSocket handshake error: " << ec.message() << std::endl;
+            return;
+        }
+        self->read();
+    });
+}
+
+void WebSocketSession::read() {
+    if (closing_) {
+        return;
+    }
+    auto self = shared_from_this();
+    ws_.async_read(buffer_, make_custom_alloc_handler(handler_memory_, [self](boost::beast::error_code ec, std::size_t) {
+        if (ec) {
+            if (ec != boost::beast::websocket::error::closed && ec != boost::asio::error::eof && ec != boost::asio::error::operation_aborted &&
+                ec != boost::asio::error::connection_reset && ec != boost::beast::error::timeout && ec != boost::beast::websocket::error::message_too_big) {
+                std::cerr << "WebSocket read error: " << ec.message() << std::endl;
+            }
+            return;
+        }
+        if (!self->ws_.got_text()) {
+            self->buffer_.consume(self->buffer_.size());
+            self->read();
+            return;
+        }
+        auto data = self->buffer_.data();
+        std::string_view message(static_cast<const char*>(data.data()), data.size());
+        self->reply_.clear();
+        self->handler_->on_message(message, self->reply_);
+        self->buffer_.consume(self->buffer_.size());
+        if (self->reply_.empty()) {
+            self->read();
+        } else {
+            self->write();
+        }
+    }));
+}
+
+void WebSocketSession::write() {
+    auto self = shared_from_this();
+    ws_.text(true);
+    ws_.async_write(boost::asio::buffer(reply_), make_custom_alloc_handler(handler_memory_, [self](boost::beast::error_code ec, std::size_t) {
+        if (ec) {
+            if (ec != boost::asio::error::operation_aborted) {
+                std::cerr << "WebSocket write error: " << ec.message() << std::endl;
+            }
+            return;
+        }
+        self->read();
+    }));
+}
+
+void WebSocketSession::drain() {
+    auto self = shared_from_this();
+    boost::asio::post(ws_.get_executor(), [self]() {
+        if (self->closing_ || !self->ws_.is_open()) {
+            return;
+        }
+        self->closing_ = true;
+        self->ws_.async_close(boost::beast::websocket::close_code::going_away, [self](boost::beast::error_code) {});
+    });
+}
+
+void WebSocketSession::close() {
+    auto self = shared_from_this();
+    boost::asio::post(ws_.get_executor(), [self]() {
+        self->closing_ = true;
+        boost::beast::error_code ec;
+        self->ws_.next_layer().close(ec);
+    });
+}
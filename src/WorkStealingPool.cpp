@@ -0,0 +1,165 @@
+#include "WorkStealingPool.h"
+
+#include <atomic>
+#include <exception>
+
+// One parallel_for() call. Slot 0 is the calling thread's share, slot k + 1 worker k's.
+struct WorkStealingPool::Job {
+    struct Share {
+        std::mutex mtx;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    Job(std::size_t count, std::size_t slots, const std::function<void(std::size_t)>& task)
+        : task(task), slots(slots), shares(new Share[slots]), remaining(count) {
+        for (std::size_t s = 0; s < slots; ++s) {
+            shares[s].begin = count * s / slots;
+            shares[s].end = count * (s + 1) / slots;
+        }
+    }
+
+    // A posted task: the job owns it, and its one index is in the last worker's share.
+    Job(std::size_t slots, std::function<void()> single)
+        : owned([single = std::move(single)](std::size_t) { single(); }), task(owned), slots(slots), shares(new Share[slots]), remaining(1) {
+        shares[slots - 1].end = 1;
+    }
+
+    std::function<void(std::size_t)> owned; // Only set for posted tasks
+    const std::function<void(std::size_t)>& task;
+    std::size_t slots;
+    std::unique_ptr<Share[]> shares;
+    std::atomic<std::size_t> remaining;
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    std::mutex done_mtx;
+    std::condition_variable done;
+};
+
+WorkStealingPool::WorkStealingPool(std::size_t threads) {
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this, i]() { run(i + 1); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::parallel_for(std::size_t count, const std::function<void(std::size_t)>& task) {
+    if (count == 0) {
+        return;
+    }
+    auto job = std::make_shared<Job>(count, workers.size() + 1, task);
+    if (count > 1 && !workers.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            jobs.push_back(job);
+        }
+        wake.notify_all();
+    }
+    work(*job, 0);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        jobs.remove(job);
+    }
+    std::unique_lock<std::mutex> lock(job->done_mtx);
+    job->done.wait(lock, [&job]() { return job->remaining.load() == 0; });
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+void WorkStealingPool::post(std::function<void()> task) {
+    if (workers.empty()) {
+        try {
+            task();
+        } catch (...) {
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        jobs.push_back(std::make_shared<Job>(workers.size() + 1, std::move(task)));
+    }
+    wake.notify_one();
+}
+
+void WorkStealingPool::run(std::size_t slot) {
+    std::unique_lock<std::mutex> lock(mtx);
+    for (;;) {
+        wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping) {
+            return;
+        }
+        std::shared_ptr<Job> job = jobs.front();
+        lock.unlock();
+        work(*job, slot);
+        lock.lock();
+        // Nothing is left to take; the threads still running its tasks finish them.
+        jobs.remove(job);
+    }
+}
+
+void WorkStealingPool::work(Job& job, std::size_t slot) {
+    Job::Share& own = job.shares[slot];
+    for (;;) {
+        std::size_t index = 0;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if (own.begin < own.end) {
+                index = own.begin++;
+                found = true;
+            }
+        }
+        // Steal the back half of the first share that has anything left.
+        for (std::size_t k = 1; !found && k < job.slots; ++k) {
+            Job::Share& victim = job.shares[(slot + k) % job.slots];
+            std::size_t begin = 0;
+            std::size_t end = 0;
+            {
+                std::lock_guard<std::mutex> lock(victim.mtx);
+                if (victim.begin < victim.end) {
+                    begin = victim.begin + (victim.end - victim.begin) / 2;
+                    end = victim.end;
+                    victim.end = begin;
+                    found = true;
+                }
+            }
+            if (found) {
+                index = begin;
+                std::lock_guard<std::mutex> lock(own.mtx);
+                own.begin = begin + 1;
+                own.end = end;
+            }
+        }
+        if (!found) {
+            return;
+        }
+
+        if (!job.failed.load()) {
+            try {
+                job.task(index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(job.done_mtx);
+                if (!job.error) {
+                    job.error = std::current_exception();
+                }
+                job.failed = true;
+            }
+        }
+        if (job.remaining.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(job.done_mtx);
+            job.done.notify_all();
+        }
+    }
+}
@@ -2,7 +2,7 @@
 
 #include <iostream>
 
-std::string Diff::get_operation_string() const {
+std::string_view operation_name(Operation operation) {
     switch (operation) {
         case Operation::DELETE: return "DELETE";
         case Operation::INSERT: return "INSERT";
@@ -11,7 +11,11 @@ std::string Diff::get_operation_string() const {
     return "";
 }
 
-std::string Diff::get_text() const {
+std::string_view Diff::get_operation_string() const {
+    return operation_name(operation);
+}
+
+std::string_view Diff::get_text() const {
     return text;
 }
 
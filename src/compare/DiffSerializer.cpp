@@ -0,0 +1,20 @@
+#include "compare/DiffSerializer.h"
+
+void serialize_diffs(const std::pmr::vector<Diff>& diffs, std::string& out, boost::json::storage_ptr storage) {
+    boost::json::value body_value(boost::json::object_kind, storage);
+    boost::json::array& responseArray = body_value.get_object().emplace("result", boost::json::array_kind).first->value().get_array();
+    responseArray.reserve(diffs.size());
+    for (const auto& diff : diffs) {
+        boost::json::object& jsonDiffObj = responseArray.emplace_back(boost::json::object_kind).get_object();
+        jsonDiffObj.emplace("operation", diff.get_operation_string());
+        jsonDiffObj.emplace("str", diff.get_text());
+    }
+
+    boost::json::serializer serializer(storage);
+    serializer.reset(&body_value);
+    char chunk[4096];
+    while (!serializer.done()) {
+        auto part = serializer.read(chunk, sizeof(chunk));
+        out.append(part.data(), part.size());
+    }
+}
@@ -0,0 +1,168 @@
+#include "compare/DocumentStore.h"
+#include "compare/LongestCommonSubsequence.h"
+
+#include <deque>
+#include <openssl/evp.h>
+#include <shared_mutex>
+#include <stdexcept>
+
+// Word <-> id table shared by the stored documents. Each word counts the documents'
+// occurrences of it and is dropped, freeing its id for reuse, when the last document
+// holding it is destroyed.
+class DocumentStore::Dictionary {
+public:
+    void intern(const std::pmr::vector<std::string_view>& words, std::pmr::vector<std::uint32_t>& tokens) {
+        std::unique_lock lock(mtx);
+        tokens.reserve(words.size());
+        for (std::string_view word : words) {
+            auto it = ids.find(word);
+            if (it != ids.end()) {
+                ++entries[it->second].references;
+                tokens.push_back(it->second);
+                continue;
+            }
+            std::uint32_t id;
+            if (!free_ids.empty()) {
+                id = free_ids.back();
+                free_ids.pop_back();
+            } else if (entries.size() < unknown_token) {
+                id = static_cast<std::uint32_t>(entries.size());
+                entries.emplace_back();
+            } else {
+                throw std::runtime_error("too many distinct words");
+            }
+            entries[id].word.assign(word);
+            entries[id].references = 1;
+            ids.emplace(entries[id].word, id);
+            tokens.push_back(id);
+        }
+    }
+
+    void release(const std::pmr::vector<std::uint32_t>& tokens) {
+        std::unique_lock lock(mtx);
+        for (std::uint32_t id : tokens) {
+            Entry& entry = entries[id];
+            if (--entry.references == 0) {
+                ids.erase(entry.word);
+                std::string().swap(entry.word);
+                free_ids.push_back(id);
+            }
+        }
+    }
+
+    void lookup(const std::pmr::vector<std::string_view>& words, std::pmr::vector<std::uint32_t>& tokens) const {
+        std::shared_lock lock(mtx);
+        tokens.reserve(words.size());
+        for (std::string_view word : words) {
+            auto it = ids.find(word);
+            tokens.push_back(it != ids.end() ? it->second : unknown_token);
+        }
+    }
+
+private:
+    struct Entry {
+        std::string word;
+        std::size_t references = 0;
+    };
+
+    mutable std::shared_mutex mtx;
+    // A deque never moves its elements, so the keys can view the words they map from.
+    std::deque<Entry> entries;
+    std::unordered_map<std::string_view, std::uint32_t> ids;
+    std::vector<std::uint32_t> free_ids;
+};
+
+DocumentStore::DocumentStore(std::size_t max_bytes) : max_bytes(max_bytes), dictionary(std::make_shared<Dictionary>()) {}
+
+DocumentStore::~DocumentStore() = default;
+
+std::size_t DocumentStore::cost(const Document& document) {
+    // The dictionary is not counted separately: its words are bounded by the texts.
+    return sizeof(Document) + document.text.size() +
+           document.words.size() * (sizeof(std::string_view) + sizeof(std::uint32_t));
+}
+
+std::shared_ptr<const DocumentStore::Document> DocumentStore::put(std::string_view text, std::size_t max_words, bool& created) {
+    std::string id = content_id(text);
+    created = false;
+    if (auto existing = get(id)) {
+        return existing;
+    }
+
+    // Tokenized and interned outside the store lock; the words are released when the last
+    // reference to the document goes, which may be after it is evicted.
+    std::shared_ptr<Document> document(new Document, [dictionary = dictionary](Document* stored) {
+        dictionary->release(stored->tokens);
+        delete stored;
+    });
+    document->id = std::move(id);
+    document->text.assign(text);
+    document->words = LongestCommonSubsequence().splitWords(document->text);
+    if (document->words.size() > max_words || cost(*document) > max_bytes) {
+        return nullptr;
+    }
+    dictionary->intern(document->words, document->tokens);
+    std::size_t document_bytes = cost(*document);
+
+    // Evicted documents release their words after the store is unlocked.
+    std::vector<std::shared_ptr<const Document>> evicted;
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = index.find(document->id);
+    if (it != index.end()) {
+        // Uploaded concurrently; keep the copy that is already stored.
+        entries.splice(entries.begin(), entries, it->second);
+        return *it->second;
+    }
+    entries.push_front(document);
+    index.emplace(document->id, entries.begin());
+    used_bytes += document_bytes;
+    while (used_bytes > max_bytes) {
+        const Document& oldest = *entries.back();
+        used_bytes -= cost(oldest);
+        index.erase(oldest.id);
+        evicted.push_back(std::move(entries.back()));
+        entries.pop_back();
+    }
+    created = true;
+    return document;
+}
+
+std::shared_ptr<const DocumentStore::Document> DocumentStore::get(std::string_view id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = index.find(id);
+    if (it == index.end()) {
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, it->second);
+    return *it->second;
+}
+
+void DocumentStore::lookup(const std::pmr::vector<std::string_view>& words, std::pmr::vector<std::uint32_t>& tokens) const {
+    dictionary->lookup(words, tokens);
+}
+
+std::size_t DocumentStore::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return entries.size();
+}
+
+std::size_t DocumentStore::bytes() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return used_bytes;
+}
+
+std::string DocumentStore::content_id(std::string_view text) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_size = 0;
+    if (EVP_Digest(text.data(), text.size(), digest, &digest_size, EVP_sha256(), nullptr) != 1) {
+        throw std::runtime_error("SHA-256 failed");
+    }
+
+    static const char digits[] = "0123456789abcdef";
+    std::string id(2 * digest_size, '0');
+    for (std::size_t i = 0; i < digest_size; ++i) {
+        id[2 * i] = digits[digest[i] >> 4];
+        id[2 * i + 1] = digits[digest[i] & 0xf];
+    }
+    return id;
+}
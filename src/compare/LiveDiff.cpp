@@ -0,0 +1,176 @@
+#include "compare/LiveDiff.h"
+#include "compare/LongestCommonSubsequence.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory_resource>
+#include <stdexcept>
+
+namespace {
+
+void check_size(std::size_t size) {
+    if (size > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::runtime_error("document too large");
+    }
+}
+
+} // namespace
+
+LiveDiff::Document& LiveDiff::get(int document) {
+    if (document != 1 && document != 2) {
+        throw std::runtime_error("doc must be 1 or 2");
+    }
+    return documents[document - 1];
+}
+
+std::string_view LiveDiff::token(int document, std::uint32_t index) const {
+    const Document& doc = documents[document - 1];
+    return std::string_view(doc.text).substr(doc.tokens[index].offset, doc.tokens[index].length);
+}
+
+std::string_view LiveDiff::text(const Entry& entry) const {
+    return entry.operation == Operation::INSERT ? token(2, entry.index2) : token(1, entry.index1);
+}
+
+LiveDiff::Change LiveDiff::set(int document, std::string_view text) {
+    Document& doc = get(document);
+    check_size(text.size());
+    LongestCommonSubsequence splitter;
+    auto words = splitter.splitWords(text);
+    if (words.size() > limits.max_tokens) {
+        throw std::runtime_error("too many words");
+    }
+
+    std::ptrdiff_t token_delta = static_cast<std::ptrdiff_t>(words.size()) - static_cast<std::ptrdiff_t>(doc.tokens.size());
+    doc.text.assign(text);
+    doc.tokens.clear();
+    for (std::string_view word : words) {
+        doc.tokens.push_back({static_cast<std::uint32_t>(word.data() - text.data()), static_cast<std::uint32_t>(word.size())});
+    }
+    return rediff(document, 0, diff.size(), token_delta);
+}
+
+LiveDiff::Change LiveDiff::edit(int document, std::size_t start, std::size_t end, std::string_view text) {
+    Document& doc = get(document);
+    // Both ends must fall between UTF-8 characters, not on a continuation byte.
+    auto inside_character = [&doc](std::size_t offset) { return offset < doc.text.size() && (doc.text[offset] & 0xC0) == 0x80; };
+    if (start > end || end > doc.text.size() || inside_character(start) || inside_character(end)) {
+        throw std::runtime_error("edit out of range");
+    }
+    check_size(doc.text.size() - (end - start) + text.size());
+
+    // The tokens that overlap or touch [start, end]: typing next to a word extends it, and
+    // deleting the space between two words joins them.
+    auto& tokens = doc.tokens;
+    auto first = std::partition_point(tokens.begin(), tokens.end(), [start](const Token& t) { return t.offset + t.length < start; });
+    auto last = std::partition_point(first, tokens.end(), [end](const Token& t) { return t.offset <= end; });
+    std::size_t token_begin = first - tokens.begin();
+    std::size_t token_end = last - tokens.begin();
+    std::size_t region_start = first != last ? std::min<std::size_t>(first->offset, start) : start;
+    std::size_t region_end = first != last ? std::max<std::size_t>((last - 1)->offset + (last - 1)->length, end) : end;
+
+    std::string region = doc.text.substr(region_start, start - region_start);
+    region += text;
+    region.append(doc.text, end, region_end - end);
+    LongestCommonSubsequence splitter;
+    auto words = splitter.splitWords(region);
+    if (tokens.size() - (token_end - token_begin) + words.size() > limits.max_tokens) {
+        throw std::runtime_error("too many words");
+    }
+
+    std::ptrdiff_t byte_delta = static_cast<std::ptrdiff_t>(text.size()) - static_cast<std::ptrdiff_t>(end - start);
+    std::ptrdiff_t token_delta = static_cast<std::ptrdiff_t>(words.size()) - static_cast<std::ptrdiff_t>(token_end - token_begin);
+    doc.text.replace(start, end - start, text);
+    for (std::size_t k = token_end; k < tokens.size(); ++k) {
+        tokens[k].offset += byte_delta;
+    }
+    std::vector<Token> replacement;
+    replacement.reserve(words.size());
+    for (std::string_view word : words) {
+        replacement.push_back({static_cast<std::uint32_t>(region_start + (word.data() - region.data())), static_cast<std::uint32_t>(word.size())});
+    }
+    tokens.erase(tokens.begin() + token_begin, tokens.begin() + token_end);
+    tokens.insert(tokens.begin() + token_begin, replacement.begin(), replacement.end());
+
+    // Widen the changed tokens to the diff entries around them, out to the nearest EQUAL
+    // entries so the re-diff starts and ends on aligned tokens.
+    auto cursor = [this, document](std::size_t k) { return document == 1 ? diff[k].index1 : diff[k].index2; };
+    Operation own = document == 1 ? Operation::DELETE : Operation::INSERT;
+    std::size_t from = std::partition_point(diff.begin(), diff.end(), [&](const Entry& e) {
+        return (document == 1 ? e.index1 : e.index2) < token_begin;
+    }) - diff.begin();
+    while (from > 0 && diff[from - 1].operation != Operation::EQUAL) {
+        --from;
+    }
+    std::size_t to = from;
+    while (to < diff.size() && !((diff[to].operation == Operation::EQUAL || diff[to].operation == own) && cursor(to) >= token_end)) {
+        ++to;
+    }
+    while (to < diff.size() && diff[to].operation != Operation::EQUAL) {
+        ++to;
+    }
+    return rediff(document, from, to, token_delta);
+}
+
+LiveDiff::Change LiveDiff::rediff(int document, std::size_t from, std::size_t to, std::ptrdiff_t token_delta) {
+    // Token positions in diff are from before the change; only `document` moved.
+    std::ptrdiff_t delta1 = document == 1 ? token_delta : 0;
+    std::ptrdiff_t delta2 = document == 2 ? token_delta : 0;
+    std::uint32_t count1 = documents[0].tokens.size() - delta1;
+    std::uint32_t count2 = documents[1].tokens.size() - delta2;
+    std::uint32_t i = from < diff.size() ? diff[from].index1 : count1;
+    std::uint32_t j = from < diff.size() ? diff[from].index2 : count2;
+    std::uint32_t end1 = (to < diff.size() ? diff[to].index1 : count1) + delta1;
+    std::uint32_t end2 = (to < diff.size() ? diff[to].index2 : count2) + delta2;
+
+    std::vector<Entry> window;
+    while (i < end1 && j < end2 && token(1, i) == token(2, j)) {
+        window.push_back({Operation::EQUAL, i++, j++});
+    }
+    std::vector<Entry> tail;
+    while (end1 > i && end2 > j && token(1, end1 - 1) == token(2, end2 - 1)) {
+        --end1;
+        --end2;
+        tail.push_back({Operation::EQUAL, end1, end2});
+    }
+
+    std::size_t m = end1 - i;
+    std::size_t n = end2 - j;
+    if (m > 0 && n > 0 && m * n <= limits.max_cells) {
+        std::pmr::monotonic_buffer_resource resource;
+        LongestCommonSubsequence lcs(&resource);
+        std::pmr::vector<std::string_view> words1(&resource);
+        std::pmr::vector<std::string_view> words2(&resource);
+        for (std::uint32_t k = i; k < end1; ++k) {
+            words1.push_back(token(1, k));
+        }
+        for (std::uint32_t k = j; k < end2; ++k) {
+            words2.push_back(token(2, k));
+        }
+        for (const Diff& d : lcs.stringDiffutil(words1, words2)) {
+            window.push_back({d.get_operation(), i, j});
+            if (d.get_operation() != Operation::INSERT) {
+                ++i;
+            }
+            if (d.get_operation() != Operation::DELETE) {
+                ++j;
+            }
+        }
+    }
+    // Too large to diff within max_cells: report the rest as replaced.
+    for (; i < end1; ++i) {
+        window.push_back({Operation::DELETE, i, j});
+    }
+    for (; j < end2; ++j) {
+        window.push_back({Operation::INSERT, i, j});
+    }
+    window.insert(window.end(), tail.rbegin(), tail.rend());
+
+    for (std::size_t k = to; k < diff.size(); ++k) {
+        diff[k].index1 += delta1;
+        diff[k].index2 += delta2;
+    }
+    diff.erase(diff.begin() + from, diff.begin() + to);
+    diff.insert(diff.begin() + from, window.begin(), window.end());
+    return {from, to - from, window.size()};
+}
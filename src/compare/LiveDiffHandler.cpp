@@ -0,0 +1,62 @@
+#include "compare/LiveDiffHandler.h"
+#include "RequestArena.h"
+
+#include <boost/json.hpp>
+
+namespace {
+
+void serialize(const boost::json::value& value, std::string& out) {
+    boost::json::serializer serializer(value.storage());
+    serializer.reset(&value);
+    char chunk[4096];
+    while (!serializer.done()) {
+        auto part = serializer.read(chunk, sizeof(chunk));
+        out.append(part.data(), part.size());
+    }
+}
+
+} // namespace
+
+void LiveDiffHandler::on_message(std::string_view message, std::string& reply) {
+    RequestArena& arena = RequestArena::local();
+    RequestArena::Scope arena_scope(arena);
+    boost::json::storage_ptr storage = arena.json_storage();
+    boost::json::value reply_value(boost::json::object_kind, storage);
+
+    try {
+        boost::json::value json_body = boost::json::parse(message, storage);
+        const boost::json::object& json_obj = json_body.as_object();
+        std::string_view type = json_obj.at("type").as_string();
+        int document = static_cast<int>(json_obj.at("doc").to_number<std::int64_t>());
+        const boost::json::string& text = json_obj.at("text").as_string();
+
+        LiveDiff::Change change;
+        if (type == "set") {
+            change = diff.set(document, text);
+        } else if (type == "edit") {
+            auto start = json_obj.at("start").to_number<std::size_t>();
+            auto end = json_obj.at("end").to_number<std::size_t>();
+            change = diff.edit(document, start, end, text);
+        } else {
+            throw std::runtime_error("unknown message type");
+        }
+
+        boost::json::object& reply_obj = reply_value.get_object();
+        reply_obj.emplace("type", "patch");
+        reply_obj.emplace("from", change.from);
+        reply_obj.emplace("remove", change.removed);
+        boost::json::array& insert = reply_obj.emplace("insert", boost::json::array_kind).first->value().get_array();
+        insert.reserve(change.inserted);
+        for (std::size_t k = change.from; k < change.from + change.inserted; ++k) {
+            const LiveDiff::Entry& entry = diff.entries()[k];
+            boost::json::object& entry_obj = insert.emplace_back(boost::json::object_kind).get_object();
+            entry_obj.emplace("operation", operation_name(entry.operation));
+            entry_obj.emplace("str", diff.text(entry));
+        }
+    } catch (const std::exception& e) {
+        reply_value = boost::json::object(storage);
+        reply_value.get_object().emplace("type", "error");
+        reply_value.get_object().emplace("message", e.what());
+    }
+    serialize(reply_value, reply);
+}
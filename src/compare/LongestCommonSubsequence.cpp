@@ -1,61 +1,140 @@
 #include "compare/LongestCommonSubsequence.h"
+#include "compare/Utf8.h"
 
 #include <algorithm>
 #include <iostream>
-#include <regex>
-
-std::vector<std::string> LongestCommonSubsequence::splitWords(const std::string& str) {
-    std::vector<std::string> result;
-    // Regular expression to match words or delimiters (spaces, tabs, newlines)
-    // std::regex wordDelimiterRegex(R"(( +|\t+|\S+))");
-    std::regex wordDelimiterRegex(R"((\S+))");
-    auto wordsBegin = std::sregex_iterator(str.begin(), str.end(), wordDelimiterRegex);
-    auto wordsEnd = std::sregex_iterator();
-    
-    for (auto it = wordsBegin; it != wordsEnd; ++it) {
-        result.push_back(it->str());
-    }
-    return result;
-}
 
+namespace {
 
-std::vector<Diff> LongestCommonSubsequence::stringDiff(const std::string& str1, const std::string& str2) {
-    std::vector<std::string> words1 = splitWords(str1);
-    std::vector<std::string> words2 = splitWords(str2);
-    return stringDiffutil(words1, words2);
+// Length of the whitespace character at `i`, 0 for a word byte. ASCII is decided inline;
+// only lead bytes of multibyte characters need the Unicode check.
+std::size_t delimiterLength(std::string_view str, std::size_t i) {
+    unsigned char c = static_cast<unsigned char>(str[i]);
+    if (c < 0x80) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v' ? 1 : 0;
+    }
+    return c >= 0xC2 ? utf8_space_length(str, i) : 0;
 }
 
-std::vector<Diff> LongestCommonSubsequence::stringDiffutil(const std::vector<std::string>& words1, const std::vector<std::string>& words2) {
-    int m = words1.size();
-    int n = words2.size();
-    std::vector<std::vector<int>> dp(m + 1, std::vector<int>(n + 1, 0));
+// Fills the (m + 1) x (n + 1) LCS table of two sequences, where equal(i, j) compares item i
+// of the first with item j of the second, and walks it back from the end, calling
+// emit(operation, i, j) with the item(s) of each operation, last operation first.
+template <class Equal, class Emit>
+void diffTable(int m, int n, Equal equal, Emit emit, std::pmr::memory_resource* resource) {
+    // Row-major (m + 1) x (n + 1) table in one allocation.
+    std::pmr::vector<int> dp(static_cast<std::size_t>(m + 1) * (n + 1), 0, resource);
+    auto at = [&dp, n](int i, int j) -> int& { return dp[static_cast<std::size_t>(i) * (n + 1) + j]; };
 
     for (int i = 1; i <= m; ++i) {
         for (int j = 1; j <= n; ++j) {
-            if (words1[i - 1] == words2[j - 1]) {
-                dp[i][j] = dp[i - 1][j - 1] + 1;
+            if (equal(i - 1, j - 1)) {
+                at(i, j) = at(i - 1, j - 1) + 1;
             } else {
-                dp[i][j] = std::max(dp[i - 1][j], dp[i][j - 1]);
+                at(i, j) = std::max(at(i - 1, j), at(i, j - 1));
             }
         }
     }
 
-    std::vector<Diff> diffs;
     int i = m, j = n;
     while (i > 0 && j > 0) {
-        if (words1[i - 1] == words2[j - 1]) {
-            diffs.emplace_back(Operation::EQUAL, words1[i - 1]);
+        if (equal(i - 1, j - 1)) {
+            emit(Operation::EQUAL, i - 1, j - 1);
             --i;
             --j;
-        } else if (dp[i - 1][j] > dp[i][j - 1]) {
-            diffs.emplace_back(Operation::DELETE, words1[i - 1]);
+        } else if (at(i - 1, j) > at(i, j - 1)) {
+            emit(Operation::DELETE, i - 1, j);
             --i;
         } else {
-            diffs.emplace_back(Operation::INSERT, words2[j - 1]);
+            emit(Operation::INSERT, i, j - 1);
             --j;
         }
     }
+    // Whatever is left of either side is unmatched.
+    for (; i > 0; --i) {
+        emit(Operation::DELETE, i - 1, j);
+    }
+    for (; j > 0; --j) {
+        emit(Operation::INSERT, i, j - 1);
+    }
+}
 
+template <class Equal>
+std::pmr::vector<Diff> diffWords(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2, Equal equal,
+                                 std::pmr::memory_resource* resource) {
+    std::pmr::vector<Diff> diffs(resource);
+    diffs.reserve(words1.size() + words2.size());
+    diffTable(static_cast<int>(words1.size()), static_cast<int>(words2.size()), equal, [&](Operation operation, int i, int j) {
+        diffs.emplace_back(operation, operation == Operation::INSERT ? words2[j] : words1[i]);
+    }, resource);
     reverse(diffs.begin(), diffs.end());
     return diffs;
 }
+
+} // namespace
+
+std::pmr::vector<std::string_view> LongestCommonSubsequence::splitWords(std::string_view str) {
+    std::pmr::vector<std::string_view> result(resource);
+    std::size_t i = 0;
+    std::size_t start = 0;
+    while (i < str.size()) {
+        std::size_t length = delimiterLength(str, i);
+        if (length == 0) {
+            std::size_t run = ascii_word_run(str, i);
+            i += run == 0 ? 1 : run;
+            continue;
+        }
+        if (i > start) {
+            result.push_back(str.substr(start, i - start));
+        }
+        i += length;
+        start = i;
+    }
+    if (i > start) {
+        result.push_back(str.substr(start, i - start));
+    }
+    return result;
+}
+
+std::pmr::vector<std::string_view> LongestCommonSubsequence::splitGraphemes(std::string_view str) {
+    std::pmr::vector<std::string_view> result(resource);
+    for (std::size_t i = 0; i < str.size();) {
+        std::size_t length = grapheme_length(str, i);
+        result.push_back(str.substr(i, length));
+        i += length;
+    }
+    return result;
+}
+
+std::pmr::vector<std::string_view> LongestCommonSubsequence::splitLines(std::string_view str) {
+    std::pmr::vector<std::string_view> result(resource);
+    for (std::size_t i = 0; i < str.size();) {
+        std::size_t end = str.find('\n', i);
+        end = end == std::string_view::npos ? str.size() : end + 1;
+        result.push_back(str.substr(i, end - i));
+        i = end;
+    }
+    return result;
+}
+
+std::pmr::vector<Diff> LongestCommonSubsequence::stringDiff(std::string_view str1, std::string_view str2) {
+    std::pmr::vector<std::string_view> words1 = splitWords(str1);
+    std::pmr::vector<std::string_view> words2 = splitWords(str2);
+    return stringDiffutil(words1, words2);
+}
+
+std::pmr::vector<Diff> LongestCommonSubsequence::stringDiffutil(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2) {
+    return diffWords(words1, words2, [&](int i, int j) { return words1[i] == words2[j]; }, resource);
+}
+
+std::pmr::vector<Diff> LongestCommonSubsequence::stringDiffutil(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2,
+                                                                const std::pmr::vector<std::uint32_t>& tokens1, const std::pmr::vector<std::uint32_t>& tokens2) {
+    return diffWords(words1, words2, [&](int i, int j) { return tokens1[i] == tokens2[j]; }, resource);
+}
+
+std::size_t LongestCommonSubsequence::diffSymbols(const std::uint32_t* symbols1, std::size_t m, const std::uint32_t* symbols2, std::size_t n, Operation* out) {
+    std::size_t count = 0;
+    diffTable(static_cast<int>(m), static_cast<int>(n), [=](int i, int j) { return symbols1[i] == symbols2[j]; },
+              [&](Operation operation, int, int) { out[count++] = operation; }, resource);
+    std::reverse(out, out + count);
+    return count;
+}
@@ -0,0 +1,136 @@
+#include "compare/NearDuplicateIndex.h"
+#include "compare/Similarity.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace {
+
+constexpr std::size_t rows_per_band = NearDuplicateIndex::signature_size / NearDuplicateIndex::bands;
+static_assert(rows_per_band * NearDuplicateIndex::bands == NearDuplicateIndex::signature_size);
+
+} // namespace
+
+NearDuplicateIndex::NearDuplicateIndex(std::size_t max_documents) : max_documents(max_documents), buckets(bands) {}
+
+std::uint64_t NearDuplicateIndex::band_key(const std::uint64_t* rows, std::size_t band) {
+    std::uint64_t key = band;
+    for (std::size_t i = 0; i < rows_per_band; ++i) {
+        key = (key ^ rows[i]) * 0x9e3779b97f4a7c15ull;
+        key ^= key >> 32;
+    }
+    return key;
+}
+
+bool NearDuplicateIndex::add(const std::shared_ptr<const DocumentStore::Document>& document, bool& added) {
+    added = false;
+    {
+        std::unique_lock lock(mtx);
+        auto it = indexed.find(document->id);
+        if (it != indexed.end()) {
+            // Same id, same text: an evicted document stored again only needs relinking.
+            Entry& entry = entries[it->second];
+            added = entry.document.expired();
+            entry.document = document;
+            return true;
+        }
+    }
+
+    // The signature is computed outside the lock.
+    std::pmr::vector<std::uint64_t> signature = minhash(shingles(document->words, shingle_size, std::pmr::get_default_resource()), signature_size,
+                                                        std::pmr::get_default_resource());
+
+    std::unique_lock lock(mtx);
+    if (indexed.count(document->id) != 0) {
+        return true; // Added concurrently
+    }
+    if (entries.size() >= max_documents && reclaim() == 0) {
+        return false;
+    }
+    auto entry = static_cast<std::uint32_t>(entries.size());
+    for (std::size_t band = 0; band < bands; ++band) {
+        buckets[band][band_key(signature.data() + band * rows_per_band, band)].push_back(entry);
+    }
+    entries.push_back({document->id, document, std::move(signature)});
+    indexed.emplace(entries.back().id, entry);
+    added = true;
+    return true;
+}
+
+std::size_t NearDuplicateIndex::reclaim() {
+    std::size_t live = 0;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        if (!entries[i].document.expired()) {
+            if (live != i) {
+                entries[live] = std::move(entries[i]);
+            }
+            ++live;
+        }
+    }
+    std::size_t reclaimed = entries.size() - live;
+    if (reclaimed == 0) {
+        return 0;
+    }
+    entries.resize(live);
+    indexed.clear();
+    for (auto& band : buckets) {
+        band.clear();
+    }
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        auto entry = static_cast<std::uint32_t>(i);
+        indexed.emplace(entries[i].id, entry);
+        for (std::size_t band = 0; band < bands; ++band) {
+            buckets[band][band_key(entries[i].signature.data() + band * rows_per_band, band)].push_back(entry);
+        }
+    }
+    return reclaimed;
+}
+
+std::vector<NearDuplicateIndex::Candidate> NearDuplicateIndex::candidates(const std::pmr::vector<std::string_view>& words, std::size_t limit,
+                                                                          std::pmr::memory_resource* resource) const {
+    std::pmr::vector<std::uint64_t> signature = minhash(shingles(words, shingle_size, resource), signature_size, resource);
+
+    std::shared_lock lock(mtx);
+    std::pmr::vector<std::uint32_t> found(resource);
+    for (std::size_t band = 0; band < bands; ++band) {
+        auto it = buckets[band].find(band_key(signature.data() + band * rows_per_band, band));
+        if (it != buckets[band].end()) {
+            found.insert(found.end(), it->second.begin(), it->second.end());
+        }
+    }
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+
+    std::vector<Candidate> result;
+    result.reserve(found.size());
+    for (std::uint32_t entry : found) {
+        if (auto document = entries[entry].document.lock()) {
+            result.push_back({std::move(document), minhash_similarity(signature, entries[entry].signature)});
+        }
+    }
+    lock.unlock();
+
+    auto by_estimate = [](const Candidate& a, const Candidate& b) { return a.estimate > b.estimate; };
+    if (result.size() > limit) {
+        std::partial_sort(result.begin(), result.begin() + limit, result.end(), by_estimate);
+        result.resize(limit);
+    } else {
+        std::sort(result.begin(), result.end(), by_estimate);
+    }
+    return result;
+}
+
+std::pmr::vector<std::uint64_t> NearDuplicateIndex::signature(std::string_view id, std::pmr::memory_resource* resource) const {
+    std::shared_lock lock(mtx);
+    auto it = indexed.find(std::string(id));
+    if (it == indexed.end() || entries[it->second].document.expired()) {
+        return std::pmr::vector<std::uint64_t>(resource);
+    }
+    const auto& signature = entries[it->second].signature;
+    return std::pmr::vector<std::uint64_t>(signature.begin(), signature.end(), resource);
+}
+
+std::size_t NearDuplicateIndex::size() const {
+    std::shared_lock lock(mtx);
+    return entries.size();
+}
@@ -0,0 +1,157 @@
+#include "compare/ParallelDiff.h"
+#include "compare/LongestCommonSubsequence.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+ParallelDiff::ParallelDiff(WorkStealingPool& pool, std::pmr::memory_resource* resource) : pool(pool), resource(resource), segments(resource) {}
+
+void ParallelDiff::plan(const std::pmr::vector<std::uint32_t>& symbols1, const std::pmr::vector<std::uint32_t>& symbols2) {
+    this->symbols1 = &symbols1;
+    this->symbols2 = &symbols2;
+    segments.clear();
+    total_cells = 0;
+
+    struct Occurrences {
+        std::size_t count1 = 0;
+        std::size_t count2 = 0;
+        std::size_t position2 = 0;
+    };
+    std::pmr::unordered_map<std::uint32_t, Occurrences> occurrences(resource);
+    occurrences.reserve(symbols1.size());
+    for (std::uint32_t symbol : symbols1) {
+        ++occurrences[symbol].count1;
+    }
+    for (std::size_t j = 0; j < symbols2.size(); ++j) {
+        auto it = occurrences.find(symbols2[j]);
+        if (it != occurrences.end()) {
+            ++it->second.count2;
+            it->second.position2 = j;
+        }
+    }
+
+    // Words unique on both sides, in input 1 order; the anchors are the longest run of them
+    // that is in order in input 2 too (patience sorting).
+    std::pmr::vector<std::pair<std::size_t, std::size_t>> unique(resource);
+    for (std::size_t i = 0; i < symbols1.size(); ++i) {
+        const Occurrences& o = occurrences.find(symbols1[i])->second;
+        if (o.count1 == 1 && o.count2 == 1) {
+            unique.emplace_back(i, o.position2);
+        }
+    }
+    constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+    std::pmr::vector<std::size_t> tails(resource);
+    std::pmr::vector<std::size_t> previous(unique.size(), none, resource);
+    for (std::size_t k = 0; k < unique.size(); ++k) {
+        auto pile = std::lower_bound(tails.begin(), tails.end(), unique[k].second,
+                                     [&unique](std::size_t tail, std::size_t position2) { return unique[tail].second < position2; });
+        if (pile != tails.begin()) {
+            previous[k] = *(pile - 1);
+        }
+        if (pile == tails.end()) {
+            tails.push_back(k);
+        } else {
+            *pile = k;
+        }
+    }
+    std::pmr::vector<std::size_t> anchors(resource);
+    for (std::size_t k = tails.empty() ? none : tails.back(); k != none; k = previous[k]) {
+        anchors.push_back(k);
+    }
+    std::reverse(anchors.begin(), anchors.end());
+
+    std::size_t begin1 = 0;
+    std::size_t begin2 = 0;
+    for (std::size_t k : anchors) {
+        add_segment(begin1, unique[k].first, begin2, unique[k].second);
+        begin1 = unique[k].first + 1;
+        begin2 = unique[k].second + 1;
+    }
+    add_segment(begin1, symbols1.size(), begin2, symbols2.size());
+}
+
+void ParallelDiff::add_segment(std::size_t begin1, std::size_t end1, std::size_t begin2, std::size_t end2) {
+    const std::uint32_t* a = symbols1->data();
+    const std::uint32_t* b = symbols2->data();
+    std::size_t prefix = 0;
+    while (begin1 + prefix < end1 && begin2 + prefix < end2 && a[begin1 + prefix] == b[begin2 + prefix]) {
+        ++prefix;
+    }
+    std::size_t suffix = 0;
+    while (begin1 + prefix + suffix < end1 && begin2 + prefix + suffix < end2 && a[end1 - suffix - 1] == b[end2 - suffix - 1]) {
+        ++suffix;
+    }
+    segments.push_back({begin1, end1, begin2, end2, prefix, suffix});
+    total_cells += (end1 - begin1 - prefix - suffix) * (end2 - begin2 - prefix - suffix);
+}
+
+std::pmr::vector<Diff> ParallelDiff::run(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2) {
+    // Segment s writes its operations at begin1 + begin2, which leaves room for all of them.
+    std::pmr::vector<Operation> operations(words1.size() + words2.size(), resource);
+    std::pmr::vector<std::size_t> counts(segments.size(), 0, resource);
+
+    // Consecutive segments are grouped into tasks of roughly equal work, a few per thread, so
+    // that there is something to steal but no task per tiny segment.
+    const std::size_t target = std::max<std::size_t>(total_cells / (4 * (pool.size() + 1)), 64 * 1024);
+    std::pmr::vector<std::size_t> tasks(resource);
+    std::size_t cells = target;
+    for (std::size_t s = 0; s < segments.size(); ++s) {
+        if (cells >= target) {
+            tasks.push_back(s);
+            cells = 0;
+        }
+        const Segment& segment = segments[s];
+        cells += (segment.end1 - segment.begin1) + (segment.end2 - segment.begin2) +
+                 (segment.end1 - segment.begin1 - segment.prefix - segment.suffix) * (segment.end2 - segment.begin2 - segment.prefix - segment.suffix);
+    }
+    tasks.push_back(segments.size());
+
+    pool.parallel_for(tasks.size() - 1, [&](std::size_t task) {
+        // Tables come from the heap: the request arena belongs to the calling thread.
+        LongestCommonSubsequence lcs(std::pmr::new_delete_resource());
+        for (std::size_t s = tasks[task]; s < tasks[task + 1]; ++s) {
+            const Segment& segment = segments[s];
+            Operation* out = operations.data() + segment.begin1 + segment.begin2;
+            std::size_t count = 0;
+            for (std::size_t k = 0; k < segment.prefix; ++k) {
+                out[count++] = Operation::EQUAL;
+            }
+            std::size_t middle1 = segment.begin1 + segment.prefix;
+            std::size_t middle2 = segment.begin2 + segment.prefix;
+            count += lcs.diffSymbols(symbols1->data() + middle1, segment.end1 - segment.suffix - middle1, symbols2->data() + middle2,
+                                     segment.end2 - segment.suffix - middle2, out + count);
+            for (std::size_t k = 0; k < segment.suffix; ++k) {
+                out[count++] = Operation::EQUAL;
+            }
+            counts[s] = count;
+        }
+    });
+
+    std::pmr::vector<Diff> diffs(resource);
+    diffs.reserve(words1.size() + words2.size());
+    for (std::size_t s = 0; s < segments.size(); ++s) {
+        const Segment& segment = segments[s];
+        const Operation* in = operations.data() + segment.begin1 + segment.begin2;
+        std::size_t i = segment.begin1;
+        std::size_t j = segment.begin2;
+        for (std::size_t k = 0; k < counts[s]; ++k) {
+            switch (in[k]) {
+            case Operation::EQUAL:
+                diffs.emplace_back(Operation::EQUAL, words1[i++]);
+                ++j;
+                break;
+            case Operation::DELETE:
+                diffs.emplace_back(Operation::DELETE, words1[i++]);
+                break;
+            case Operation::INSERT:
+                diffs.emplace_back(Operation::INSERT, words2[j++]);
+                break;
+            }
+        }
+        if (s + 1 < segments.size()) {
+            diffs.emplace_back(Operation::EQUAL, words1[segment.end1]);
+        }
+    }
+    return diffs;
+}
@@ -0,0 +1,298 @@
+#include "compare/Similarity.h"
+
+#include <algorithm>
+#include <bitset>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+constexpr std::size_t word_bits = 64;
+constexpr std::uint32_t no_slot = std::numeric_limits<std::uint32_t>::max();
+
+// splitmix64's finalizer.
+std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// FNV-1a, fixed so that shingle hashes are the same in every process.
+std::uint64_t hash_word(std::string_view word) {
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// The match masks of the pattern (one row per symbol, 64 rows per block), kept sparse: for
+// each distinct symbol only the blocks it occurs in. Text symbols are mapped to the
+// pattern's slots up front, so the kernels do no hashing.
+struct Pattern {
+    struct Mask {
+        std::size_t block;
+        std::uint64_t bits;
+    };
+
+    Pattern(const std::uint32_t* pattern, std::size_t m, const std::uint32_t* symbols, std::size_t n, std::pmr::memory_resource* resource)
+        : blocks((m + word_bits - 1) / word_bits), begin(resource), end(resource), masks(resource), text(resource), eq(blocks, 0, resource) {
+        std::pmr::unordered_map<std::uint32_t, std::uint32_t> slots(resource);
+        slots.reserve(m);
+        std::pmr::vector<std::uint32_t> row_slots(m, resource);
+        for (std::size_t i = 0; i < m; ++i) {
+            row_slots[i] = slots.try_emplace(pattern[i], static_cast<std::uint32_t>(slots.size())).first->second;
+        }
+
+        begin.assign(slots.size() + 1, 0);
+        for (std::uint32_t slot : row_slots) {
+            ++begin[slot + 1];
+        }
+        std::partial_sum(begin.begin(), begin.end(), begin.begin());
+        end.assign(begin.begin(), begin.end() - 1);
+        masks.resize(m);
+        for (std::size_t i = 0; i < m; ++i) {
+            std::uint32_t slot = row_slots[i];
+            std::size_t block = i / word_bits;
+            std::uint64_t bit = std::uint64_t{1} << (i % word_bits);
+            if (end[slot] > begin[slot] && masks[end[slot] - 1].block == block) {
+                masks[end[slot] - 1].bits |= bit;
+            } else {
+                masks[end[slot]++] = {block, bit};
+            }
+        }
+
+        text.reserve(n);
+        for (std::size_t j = 0; j < n; ++j) {
+            auto it = slots.find(symbols[j]);
+            text.push_back(it != slots.end() ? it->second : no_slot);
+        }
+    }
+
+    // Fills eq with the masks of `slot`; clear() undoes it.
+    void load(std::uint32_t slot) {
+        for (std::uint32_t k = begin[slot]; k < end[slot]; ++k) {
+            eq[masks[k].block] = masks[k].bits;
+        }
+    }
+    void clear(std::uint32_t slot) {
+        for (std::uint32_t k = begin[slot]; k < end[slot]; ++k) {
+            eq[masks[k].block] = 0;
+        }
+    }
+
+    std::size_t blocks;
+    std::pmr::vector<std::uint32_t> begin;
+    std::pmr::vector<std::uint32_t> end;
+    std::pmr::vector<Mask> masks;
+    std::pmr::vector<std::uint32_t> text;
+    std::pmr::vector<std::uint64_t> eq;
+};
+
+// Drops the common prefix and suffix, which neither kernel needs to see, and makes the
+// shorter sequence the pattern. Returns the length of the dropped prefix and suffix.
+std::size_t trim(const std::uint32_t*& a, std::size_t& m, const std::uint32_t*& b, std::size_t& n) {
+    std::size_t common = 0;
+    while (m > 0 && n > 0 && *a == *b) {
+        ++a;
+        ++b;
+        --m;
+        --n;
+        ++common;
+    }
+    while (m > 0 && n > 0 && a[m - 1] == b[n - 1]) {
+        --m;
+        --n;
+        ++common;
+    }
+    if (m > n) {
+        std::swap(a, b);
+        std::swap(m, n);
+    }
+    return common;
+}
+
+} // namespace
+
+void encode_words(const std::pmr::vector<std::string_view>& words1, const std::pmr::vector<std::string_view>& words2,
+                  std::pmr::vector<std::uint32_t>& symbols1, std::pmr::vector<std::uint32_t>& symbols2, std::pmr::memory_resource* resource) {
+    std::pmr::unordered_map<std::string_view, std::uint32_t> ids(resource);
+    ids.reserve(words1.size() + words2.size());
+    auto encode = [&ids](const std::pmr::vector<std::string_view>& words, std::pmr::vector<std::uint32_t>& symbols) {
+        symbols.reserve(words.size());
+        for (std::string_view word : words) {
+            symbols.push_back(ids.try_emplace(word, static_cast<std::uint32_t>(ids.size())).first->second);
+        }
+    };
+    encode(words1, symbols1);
+    encode(words2, symbols2);
+}
+
+std::size_t lcs_length(const std::pmr::vector<std::uint32_t>& symbols1, const std::pmr::vector<std::uint32_t>& symbols2, std::pmr::memory_resource* resource) {
+    const std::uint32_t* a = symbols1.data();
+    const std::uint32_t* b = symbols2.data();
+    std::size_t m = symbols1.size();
+    std::size_t n = symbols2.size();
+    std::size_t common = trim(a, m, b, n);
+    if (m == 0) {
+        return common;
+    }
+
+    // Bit i of v is 0 where row i ends a match; the zeros count the LCS.
+    Pattern pattern(a, m, b, n, resource);
+    std::pmr::vector<std::uint64_t> v(pattern.blocks, ~std::uint64_t{0}, resource);
+    for (std::uint32_t slot : pattern.text) {
+        if (slot == no_slot) {
+            continue; // No row matches, so v is unchanged
+        }
+        pattern.load(slot);
+        std::uint64_t carry = 0;
+        for (std::size_t k = 0; k < pattern.blocks; ++k) {
+            std::uint64_t u = v[k] & pattern.eq[k];
+            std::uint64_t sum = v[k] + u;
+            std::uint64_t next_carry = sum < u;
+            sum += carry;
+            next_carry |= sum < carry;
+            v[k] = sum | (v[k] - u);
+            carry = next_carry;
+        }
+        pattern.clear(slot);
+    }
+
+    std::size_t ones = 0;
+    for (std::size_t k = 0; k + 1 < pattern.blocks; ++k) {
+        ones += std::bitset<word_bits>(v[k]).count();
+    }
+    std::size_t tail = m - (pattern.blocks - 1) * word_bits;
+    std::uint64_t tail_mask = tail == word_bits ? ~std::uint64_t{0} : (std::uint64_t{1} << tail) - 1;
+    ones += std::bitset<word_bits>(v.back() & tail_mask).count();
+    return common + (m - ones);
+}
+
+std::size_t edit_distance(const std::pmr::vector<std::uint32_t>& symbols1, const std::pmr::vector<std::uint32_t>& symbols2, std::pmr::memory_resource* resource) {
+    const std::uint32_t* a = symbols1.data();
+    const std::uint32_t* b = symbols2.data();
+    std::size_t m = symbols1.size();
+    std::size_t n = symbols2.size();
+    trim(a, m, b, n);
+    if (m == 0) {
+        return n;
+    }
+
+    // pv and mv hold the +1 and -1 vertical deltas of the current column, block by block;
+    // each block passes the horizontal delta of its last row down to the next.
+    Pattern pattern(a, m, b, n, resource);
+    std::pmr::vector<std::uint64_t> pv(pattern.blocks, ~std::uint64_t{0}, resource);
+    std::pmr::vector<std::uint64_t> mv(pattern.blocks, 0, resource);
+    const std::uint64_t high_bit = std::uint64_t{1} << (word_bits - 1);
+    const std::uint64_t last_bit = std::uint64_t{1} << ((m - 1) % word_bits);
+    std::size_t score = m;
+    for (std::uint32_t slot : pattern.text) {
+        if (slot != no_slot) {
+            pattern.load(slot);
+        }
+        int hin = 1; // Row 0 grows by one per column
+        for (std::size_t k = 0; k < pattern.blocks; ++k) {
+            std::uint64_t p = pv[k];
+            std::uint64_t q = mv[k];
+            std::uint64_t eq = pattern.eq[k];
+            std::uint64_t hin_negative = hin < 0 ? 1 : 0;
+            std::uint64_t xv = eq | q;
+            eq |= hin_negative;
+            std::uint64_t xh = (((eq & p) + p) ^ p) | eq;
+            std::uint64_t ph = q | ~(xh | p);
+            std::uint64_t mh = p & xh;
+            std::uint64_t out_bit = k + 1 == pattern.blocks ? last_bit : high_bit;
+            int hout = (ph & out_bit) ? 1 : (mh & out_bit) ? -1 : 0;
+            ph <<= 1;
+            mh <<= 1;
+            if (hin < 0) {
+                mh |= 1;
+            } else if (hin > 0) {
+                ph |= 1;
+            }
+            pv[k] = mh | ~(xv | ph);
+            mv[k] = ph & xv;
+            hin = hout;
+        }
+        score += hin;
+        if (slot != no_slot) {
+            pattern.clear(slot);
+        }
+    }
+    return score;
+}
+
+std::pmr::vector<std::uint64_t> shingles(const std::pmr::vector<std::string_view>& words, std::size_t size, std::pmr::memory_resource* resource) {
+    std::pmr::vector<std::uint64_t> result(resource);
+    if (words.empty()) {
+        return result;
+    }
+    size = std::clamp<std::size_t>(size, 1, words.size());
+    std::pmr::vector<std::uint64_t> hashes(resource);
+    hashes.reserve(words.size());
+    for (std::string_view word : words) {
+        hashes.push_back(hash_word(word));
+    }
+    result.reserve(words.size() - size + 1);
+    for (std::size_t i = 0; i + size <= words.size(); ++i) {
+        std::uint64_t hash = size;
+        for (std::size_t k = i; k < i + size; ++k) {
+            hash = mix(hash ^ hashes[k]);
+        }
+        result.push_back(hash);
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+double jaccard(const std::pmr::vector<std::uint64_t>& shingles1, const std::pmr::vector<std::uint64_t>& shingles2) {
+    if (shingles1.empty() && shingles2.empty()) {
+        return 1.0;
+    }
+    std::size_t common = 0;
+    auto i = shingles1.begin();
+    auto j = shingles2.begin();
+    while (i != shingles1.end() && j != shingles2.end()) {
+        if (*i < *j) {
+            ++i;
+        } else if (*j < *i) {
+            ++j;
+        } else {
+            ++common;
+            ++i;
+            ++j;
+        }
+    }
+    return static_cast<double>(common) / static_cast<double>(shingles1.size() + shingles2.size() - common);
+}
+
+std::pmr::vector<std::uint64_t> minhash(const std::pmr::vector<std::uint64_t>& shingles, std::size_t hashes, std::pmr::memory_resource* resource) {
+    std::pmr::vector<std::uint64_t> signature(hashes, std::numeric_limits<std::uint64_t>::max(), resource);
+    for (std::size_t i = 0; i < hashes; ++i) {
+        const std::uint64_t seed = mix(i + 1);
+        std::uint64_t minimum = std::numeric_limits<std::uint64_t>::max();
+        for (std::uint64_t shingle : shingles) {
+            minimum = std::min(minimum, mix(shingle ^ seed));
+        }
+        signature[i] = minimum;
+    }
+    return signature;
+}
+
+double minhash_similarity(const std::pmr::vector<std::uint64_t>& signature1, const std::pmr::vector<std::uint64_t>& signature2) {
+    std::size_t size = std::min(signature1.size(), signature2.size());
+    if (size == 0) {
+        return 1.0;
+    }
+    std::size_t equal = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        equal += signature1[i] == signature2[i];
+    }
+    return static_cast<double>(equal) / static_cast<double>(size);
+}
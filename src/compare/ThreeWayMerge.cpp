@@ -0,0 +1,157 @@
+#include "compare/ThreeWayMerge.h"
+#include "compare/LongestCommonSubsequence.h"
+#include "compare/Similarity.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+using Version = ThreeWayMerge::Version;
+
+// Words [from, to) of `version` with the whitespace after each, up to the next word or the end.
+std::string_view slice(const Version& version, std::size_t from, std::size_t to) {
+    if (from == to) {
+        return {};
+    }
+    const char* begin = version.words[from].data();
+    const char* end = to < version.words.size() ? version.words[to].data() : version.text.data() + version.text.size();
+    return std::string_view(begin, end - begin);
+}
+
+// Words [from, to) of `version` without the whitespace after the last.
+std::string_view span(const Version& version, std::size_t from, std::size_t to) {
+    if (from == to) {
+        return {};
+    }
+    const char* begin = version.words[from].data();
+    std::string_view last = version.words[to - 1];
+    return std::string_view(begin, last.data() + last.size() - begin);
+}
+
+// The whitespace before word `k` of `version`.
+std::string_view gap_before(const Version& version, std::size_t k) {
+    const char* begin = k > 0 ? version.words[k - 1].data() + version.words[k - 1].size() : version.text.data();
+    return std::string_view(begin, version.words[k].data() - begin);
+}
+
+bool same(const Version& a, std::size_t from_a, std::size_t to_a, const Version& b, std::size_t from_b, std::size_t to_b) {
+    return to_a - from_a == to_b - from_b && std::equal(a.words.begin() + from_a, a.words.begin() + to_a, b.words.begin() + from_b);
+}
+
+} // namespace
+
+ThreeWayMerge::ThreeWayMerge(WorkStealingPool& pool, std::pmr::memory_resource* resource) : pool(pool), resource(resource) {}
+
+void ThreeWayMerge::align(const std::pmr::vector<std::uint32_t>& base, const std::pmr::vector<std::uint32_t>& other, std::pmr::vector<std::size_t>& matches) {
+    std::size_t m = base.size();
+    std::size_t n = other.size();
+    std::size_t prefix = 0;
+    while (prefix < m && prefix < n && base[prefix] == other[prefix]) {
+        matches[prefix] = prefix;
+        ++prefix;
+    }
+    std::size_t suffix = 0;
+    while (prefix + suffix < m && prefix + suffix < n && base[m - suffix - 1] == other[n - suffix - 1]) {
+        matches[m - suffix - 1] = n - suffix - 1;
+        ++suffix;
+    }
+
+    // Scratch comes from the heap: this runs on a pool thread, and the request arena is not shared.
+    std::pmr::memory_resource* heap = std::pmr::new_delete_resource();
+    std::pmr::vector<Operation> operations(m + n - 2 * (prefix + suffix), heap);
+    std::size_t count = LongestCommonSubsequence(heap).diffSymbols(base.data() + prefix, m - prefix - suffix, other.data() + prefix,
+                                                                   n - prefix - suffix, operations.data());
+    std::size_t i = prefix;
+    std::size_t j = prefix;
+    for (std::size_t k = 0; k < count; ++k) {
+        switch (operations[k]) {
+        case Operation::EQUAL:
+            matches[i++] = j++;
+            break;
+        case Operation::DELETE:
+            ++i;
+            break;
+        case Operation::INSERT:
+            ++j;
+            break;
+        }
+    }
+}
+
+ThreeWayMerge::Result ThreeWayMerge::merge(const Version& base, const Version& ours, const Version& theirs) {
+    std::pmr::vector<std::uint32_t> base1(resource);
+    std::pmr::vector<std::uint32_t> symbols1(resource);
+    std::pmr::vector<std::uint32_t> base2(resource);
+    std::pmr::vector<std::uint32_t> symbols2(resource);
+    encode_words(base.words, ours.words, base1, symbols1, resource);
+    encode_words(base.words, theirs.words, base2, symbols2, resource);
+    std::pmr::vector<std::size_t> matches1(base.words.size(), none, resource);
+    std::pmr::vector<std::size_t> matches2(base.words.size(), none, resource);
+    pool.parallel_for(2, [&](std::size_t side) {
+        if (side == 0) {
+            align(base1, symbols1, matches1);
+        } else {
+            align(base2, symbols2, matches2);
+        }
+    });
+
+    Result result{std::pmr::string(resource), std::pmr::vector<Conflict>(resource)};
+    result.text.reserve(ours.text.size());
+    result.text.append(ours.words.empty() ? ours.text : ours.text.substr(0, ours.words.front().data() - ours.text.data()));
+    // Appends words [from, to) of `version` and returns where they start. A word that
+    // follows one from the other side without whitespace between gets the space it had.
+    bool joined = false;
+    auto append = [&result, &joined](const Version& version, std::size_t from, std::size_t to) {
+        if (from == to) {
+            return result.text.size();
+        }
+        if (joined) {
+            std::string_view gap = gap_before(version, from);
+            result.text.append(gap.empty() ? std::string_view(" ") : gap);
+        }
+        std::size_t begin = result.text.size();
+        std::string_view words = slice(version, from, to);
+        result.text.append(words);
+        joined = words.size() == span(version, from, to).size();
+        return begin;
+    };
+
+    const std::size_t m = base.words.size();
+    std::size_t b = 0;
+    std::size_t o = 0;
+    std::size_t t = 0;
+    while (b < m || o < ours.words.size() || t < theirs.words.size()) {
+        if (b < m && matches1[b] == o && matches2[b] == t) {
+            append(ours, o, o + 1);
+            ++b;
+            ++o;
+            ++t;
+            continue;
+        }
+        // Up to the next base word that both sides kept.
+        std::size_t next = b;
+        while (next < m && (matches1[next] == none || matches2[next] == none)) {
+            ++next;
+        }
+        std::size_t ours_end = next < m ? matches1[next] : ours.words.size();
+        std::size_t theirs_end = next < m ? matches2[next] : theirs.words.size();
+        bool ours_changed = !same(base, b, next, ours, o, ours_end);
+        bool theirs_changed = !same(base, b, next, theirs, t, theirs_end);
+        if (!theirs_changed || (ours_changed && same(ours, o, ours_end, theirs, t, theirs_end))) {
+            append(ours, o, ours_end);
+        } else if (!ours_changed) {
+            append(theirs, t, theirs_end);
+        } else {
+            std::size_t begin = append(ours, o, ours_end);
+            std::string_view ours_span = span(ours, o, ours_end);
+            result.conflicts.push_back({begin, begin + ours_span.size(), span(base, b, next), ours_span, span(theirs, t, theirs_end)});
+        }
+        b = next;
+        o = ours_end;
+        t = theirs_end;
+    }
+    return result;
+}
@@ -0,0 +1,213 @@
+#include "compare/UnifiedDiff.h"
+
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::string_view no_newline = "\\ No newline at end of file\n";
+
+// "start,count" of a hunk side whose first line is line `first` (from 0). As in diff, an
+// empty side names the line before it and a count of 1 is left out.
+void append_range(std::string& out, std::size_t first, std::size_t count) {
+    out += std::to_string(count == 0 ? first : first + 1);
+    if (count != 1) {
+        out += ',';
+        out += std::to_string(count);
+    }
+}
+
+void append_line(std::string& out, char prefix, std::string_view line) {
+    out += prefix;
+    out += line;
+    if (line.empty() || line.back() != '\n') {
+        out += '\n';
+        out += no_newline;
+    }
+}
+
+// Reads the line at `pos` of `text`, with its '\n', and moves past it.
+std::string_view next_line(std::string_view text, std::size_t& pos) {
+    std::size_t end = text.find('\n', pos);
+    end = end == std::string_view::npos ? text.size() : end + 1;
+    std::string_view line = text.substr(pos, end - pos);
+    pos = end;
+    return line;
+}
+
+// Parses a number at `pos` of `header` and moves past it.
+std::size_t parse_number(std::string_view header, std::size_t& pos) {
+    std::size_t value = 0;
+    auto [end, error] = std::from_chars(header.data() + pos, header.data() + header.size(), value);
+    if (error != std::errc()) {
+        throw std::runtime_error("malformed hunk header");
+    }
+    pos = end - header.data();
+    return value;
+}
+
+// "-start[,count]" or "+start[,count]" at `pos` of a hunk header.
+void parse_range(std::string_view header, std::size_t& pos, char sign, std::size_t& start, std::size_t& count) {
+    if (pos >= header.size() || header[pos] != sign) {
+        throw std::runtime_error("malformed hunk header");
+    }
+    ++pos;
+    start = parse_number(header, pos);
+    count = 1;
+    if (pos < header.size() && header[pos] == ',') {
+        ++pos;
+        count = parse_number(header, pos);
+    }
+}
+
+} // namespace
+
+void write_unified_diff(const std::pmr::vector<std::string_view>& lines1, const std::pmr::vector<std::string_view>& lines2, const Operation* operations,
+                        std::size_t count, std::size_t context, std::string& out) {
+    std::size_t k = 0;
+    std::size_t i = 0;
+    std::size_t j = 0;
+    std::size_t equal_run = 0;
+    while (k < count) {
+        if (operations[k] == Operation::EQUAL) {
+            ++k;
+            ++i;
+            ++j;
+            ++equal_run;
+            continue;
+        }
+        // A hunk runs from `context` lines before this change to `context` lines after the
+        // last change that is at most 2 * context unchanged lines from the one before it.
+        std::size_t lead = std::min(context, equal_run);
+        std::size_t begin = k - lead;
+        std::size_t first1 = i - lead;
+        std::size_t first2 = j - lead;
+        std::size_t end = k;
+        for (std::size_t e = k; e < count;) {
+            if (operations[e] != Operation::EQUAL) {
+                end = ++e;
+                continue;
+            }
+            std::size_t run = e;
+            while (run < count && operations[run] == Operation::EQUAL) {
+                ++run;
+            }
+            if (run == count || run - e > 2 * context) {
+                break;
+            }
+            e = run;
+        }
+        std::size_t stop = std::min(count, end + context);
+
+        std::size_t count1 = 0;
+        std::size_t count2 = 0;
+        for (std::size_t t = begin; t < stop; ++t) {
+            count1 += operations[t] != Operation::INSERT;
+            count2 += operations[t] != Operation::DELETE;
+        }
+        out += "@@ -";
+        append_range(out, first1, count1);
+        out += " +";
+        append_range(out, first2, count2);
+        out += " @@\n";
+        i = first1;
+        j = first2;
+        for (std::size_t t = begin; t < stop; ++t) {
+            switch (operations[t]) {
+            case Operation::EQUAL:
+                append_line(out, ' ', lines1[i++]);
+                ++j;
+                break;
+            case Operation::DELETE:
+                append_line(out, '-', lines1[i++]);
+                break;
+            case Operation::INSERT:
+                append_line(out, '+', lines2[j++]);
+                break;
+            }
+        }
+        k = stop;
+        equal_run = stop - end;
+    }
+}
+
+std::pmr::string apply_unified_diff(std::string_view base, std::string_view patch, std::pmr::memory_resource* resource) {
+    std::pmr::string result(resource);
+    result.reserve(base.size() + patch.size());
+    std::size_t base_pos = 0;
+    std::size_t base_line = 0; // Lines of base read so far
+    std::size_t patch_pos = 0;
+    while (patch_pos < patch.size()) {
+        std::string_view header = next_line(patch, patch_pos);
+        if (header.substr(0, 3) != "@@ ") {
+            continue;
+        }
+        std::size_t pos = 3;
+        std::size_t start1, count1, start2, count2;
+        parse_range(header, pos, '-', start1, count1);
+        if (pos >= header.size() || header[pos] != ' ') {
+            throw std::runtime_error("malformed hunk header");
+        }
+        ++pos;
+        parse_range(header, pos, '+', start2, count2);
+
+        // Copy the unchanged lines up to the hunk; hunks must come in order.
+        std::size_t first = count1 == 0 ? start1 : start1 - 1;
+        if (count1 != 0 && start1 == 0) {
+            throw std::runtime_error("malformed hunk header");
+        }
+        if (first < base_line) {
+            throw std::runtime_error("hunks overlap or are out of order");
+        }
+        while (base_line < first) {
+            if (base_pos >= base.size()) {
+                throw std::runtime_error("hunk starts past the end of the base");
+            }
+            result += next_line(base, base_pos);
+            ++base_line;
+        }
+
+        std::size_t old_lines = 0;
+        std::size_t new_lines = 0;
+        while (old_lines < count1 || new_lines < count2) {
+            if (patch_pos >= patch.size()) {
+                throw std::runtime_error("hunk is shorter than its header");
+            }
+            std::string_view line = next_line(patch, patch_pos);
+            if (line.empty()) {
+                throw std::runtime_error("malformed hunk line");
+            }
+            char kind = line[0];
+            std::string_view content = line.substr(1);
+            // A line without its newline is followed by a "\ No newline" marker.
+            if (patch.substr(patch_pos, 1) == "\\") {
+                next_line(patch, patch_pos);
+                if (!content.empty() && content.back() == '\n') {
+                    content.remove_suffix(1);
+                }
+            }
+            if (kind == ' ' || kind == '-') {
+                if (base_pos >= base.size() || next_line(base, base_pos) != content) {
+                    throw std::runtime_error("patch does not match the base at line " + std::to_string(base_line + 1));
+                }
+                ++base_line;
+                ++old_lines;
+                if (kind == ' ') {
+                    result += content;
+                    ++new_lines;
+                }
+            } else if (kind == '+') {
+                result += content;
+                ++new_lines;
+            } else {
+                throw std::runtime_error("malformed hunk line");
+            }
+            if (old_lines > count1 || new_lines > count2) {
+                throw std::runtime_error("hunk is longer than its header");
+            }
+        }
+    }
+    result.append(base.substr(base_pos));
+    return result;
+}
@@ -0,0 +1,269 @@
+#include "compare/Utf8.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+constexpr std::uint64_t high_bits = 0x8080808080808080ull;
+
+bool ascii_chunk(std::string_view text, std::size_t i) {
+    std::uint64_t chunk;
+    std::memcpy(&chunk, text.data() + i, sizeof(chunk));
+    return (chunk & high_bits) == 0;
+}
+
+// True if all eight bytes at `i` are in 0x21-0x7F: a byte below 0x21 borrows into its own
+// high bit (bytes under it don't borrow), and a byte from 0x80 has it set already.
+bool ascii_graphic_chunk(std::string_view text, std::size_t i) {
+    std::uint64_t chunk;
+    std::memcpy(&chunk, text.data() + i, sizeof(chunk));
+    return (((chunk - 0x2121212121212121ull) | chunk) & high_bits) == 0;
+}
+
+bool ascii_space(unsigned char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Grapheme_Cluster_Break values; Prepend is left out (it only matters for a few scripts).
+enum class Break : std::uint8_t { other, cr, lf, control, extend, zwj, regional_indicator, spacing_mark, l, v, t, lv, lvt, pictographic };
+
+struct Range {
+    char32_t first;
+    char32_t last;
+    Break value;
+};
+
+// Sorted, non-overlapping. ASCII, Latin-1 controls, the Indic blocks and Hangul syllables
+// are handled in code.
+constexpr Range ranges[] = {
+    {0x0300, 0x036F, Break::extend},          {0x0483, 0x0489, Break::extend},          {0x0591, 0x05BD, Break::extend},
+    {0x05BF, 0x05BF, Break::extend},          {0x05C1, 0x05C2, Break::extend},          {0x05C4, 0x05C5, Break::extend},
+    {0x05C7, 0x05C7, Break::extend},          {0x0610, 0x061A, Break::extend},          {0x061C, 0x061C, Break::control},
+    {0x064B, 0x065F, Break::extend},          {0x0670, 0x0670, Break::extend},          {0x06D6, 0x06DC, Break::extend},
+    {0x06DF, 0x06E4, Break::extend},          {0x06E7, 0x06E8, Break::extend},          {0x06EA, 0x06ED, Break::extend},
+    {0x0711, 0x0711, Break::extend},          {0x0730, 0x074A, Break::extend},          {0x07A6, 0x07B0, Break::extend},
+    {0x07EB, 0x07F3, Break::extend},          {0x0816, 0x0819, Break::extend},          {0x081B, 0x0823, Break::extend},
+    {0x0825, 0x0827, Break::extend},          {0x0829, 0x082D, Break::extend},          {0x0859, 0x085B, Break::extend},
+    {0x08D3, 0x08E1, Break::extend},          {0x08E3, 0x08FF, Break::extend},          {0x0E31, 0x0E31, Break::extend},
+    {0x0E33, 0x0E33, Break::spacing_mark},    {0x0E34, 0x0E3A, Break::extend},          {0x0E47, 0x0E4E, Break::extend},
+    {0x0EB1, 0x0EB1, Break::extend},          {0x0EB3, 0x0EB3, Break::spacing_mark},    {0x0EB4, 0x0EBC, Break::extend},
+    {0x0EC8, 0x0ECD, Break::extend},          {0x0F18, 0x0F19, Break::extend},          {0x0F35, 0x0F35, Break::extend},
+    {0x0F37, 0x0F37, Break::extend},          {0x0F39, 0x0F39, Break::extend},          {0x0F3E, 0x0F3F, Break::spacing_mark},
+    {0x0F71, 0x0F84, Break::extend},          {0x0F86, 0x0F87, Break::extend},          {0x0F8D, 0x0FBC, Break::extend},
+    {0x102B, 0x103E, Break::extend},          {0x1056, 0x1059, Break::extend},          {0x1100, 0x115F, Break::l},
+    {0x1160, 0x11A7, Break::v},               {0x11A8, 0x11FF, Break::t},               {0x135D, 0x135F, Break::extend},
+    {0x1712, 0x1714, Break::extend},          {0x17B4, 0x17D3, Break::extend},          {0x180B, 0x180D, Break::extend},
+    {0x180E, 0x180E, Break::control},         {0x1AB0, 0x1AFF, Break::extend},          {0x1B00, 0x1B04, Break::extend},
+    {0x1B34, 0x1B44, Break::extend},          {0x1DC0, 0x1DFF, Break::extend},          {0x200B, 0x200B, Break::control},
+    {0x200C, 0x200C, Break::extend},          {0x200D, 0x200D, Break::zwj},             {0x200E, 0x200F, Break::control},
+    {0x2028, 0x202E, Break::control},         {0x203C, 0x203C, Break::pictographic},    {0x2049, 0x2049, Break::pictographic},
+    {0x2060, 0x206F, Break::control},         {0x20D0, 0x20F0, Break::extend},          {0x2122, 0x2122, Break::pictographic},
+    {0x2139, 0x2139, Break::pictographic},    {0x2194, 0x2199, Break::pictographic},    {0x21A9, 0x21AA, Break::pictographic},
+    {0x231A, 0x231B, Break::pictographic},    {0x2328, 0x2328, Break::pictographic},    {0x23CF, 0x23CF, Break::pictographic},
+    {0x23E9, 0x23F3, Break::pictographic},    {0x23F8, 0x23FA, Break::pictographic},    {0x24C2, 0x24C2, Break::pictographic},
+    {0x25AA, 0x25AB, Break::pictographic},    {0x25B6, 0x25B6, Break::pictographic},    {0x25C0, 0x25C0, Break::pictographic},
+    {0x25FB, 0x25FE, Break::pictographic},    {0x2600, 0x27BF, Break::pictographic},    {0x2934, 0x2935, Break::pictographic},
+    {0x2B05, 0x2B07, Break::pictographic},    {0x2B1B, 0x2B1C, Break::pictographic},    {0x2B50, 0x2B50, Break::pictographic},
+    {0x2B55, 0x2B55, Break::pictographic},    {0x2CEF, 0x2CF1, Break::extend},          {0x2D7F, 0x2D7F, Break::extend},
+    {0x2DE0, 0x2DFF, Break::extend},          {0x302A, 0x302F, Break::extend},          {0x3030, 0x3030, Break::pictographic},
+    {0x303D, 0x303D, Break::pictographic},    {0x3099, 0x309A, Break::extend},          {0x3297, 0x3297, Break::pictographic},
+    {0x3299, 0x3299, Break::pictographic},    {0xA66F, 0xA672, Break::extend},          {0xA674, 0xA67D, Break::extend},
+    {0xA69E, 0xA69F, Break::extend},          {0xA960, 0xA97C, Break::l},               {0xD7B0, 0xD7C6, Break::v},
+    {0xD7CB, 0xD7FB, Break::t},               {0xFB1E, 0xFB1E, Break::extend},          {0xFE00, 0xFE0F, Break::extend},
+    {0xFE20, 0xFE2F, Break::extend},          {0xFEFF, 0xFEFF, Break::control},         {0xFF9E, 0xFF9F, Break::extend},
+    {0xFFF0, 0xFFFB, Break::control},         {0x1F000, 0x1F0FF, Break::pictographic},  {0x1F10D, 0x1F10F, Break::pictographic},
+    {0x1F12F, 0x1F12F, Break::pictographic},  {0x1F16C, 0x1F171, Break::pictographic},  {0x1F17E, 0x1F17F, Break::pictographic},
+    {0x1F18E, 0x1F18E, Break::pictographic},  {0x1F191, 0x1F19A, Break::pictographic},  {0x1F1E6, 0x1F1FF, Break::regional_indicator},
+    {0x1F201, 0x1F20F, Break::pictographic},  {0x1F21A, 0x1F21A, Break::pictographic},  {0x1F22F, 0x1F22F, Break::pictographic},
+    {0x1F232, 0x1F23A, Break::pictographic},  {0x1F23C, 0x1F23F, Break::pictographic},  {0x1F249, 0x1F3FA, Break::pictographic},
+    {0x1F3FB, 0x1F3FF, Break::extend},        {0x1F400, 0x1F53D, Break::pictographic},  {0x1F546, 0x1F64F, Break::pictographic},
+    {0x1F680, 0x1F6FF, Break::pictographic},  {0x1F774, 0x1F77F, Break::pictographic},  {0x1F7D5, 0x1F7FF, Break::pictographic},
+    {0x1F80C, 0x1F80F, Break::pictographic},  {0x1F848, 0x1F84F, Break::pictographic},  {0x1F85A, 0x1F85F, Break::pictographic},
+    {0x1F888, 0x1F88F, Break::pictographic},  {0x1F8AE, 0x1F8FF, Break::pictographic},  {0x1F90C, 0x1F93A, Break::pictographic},
+    {0x1F93C, 0x1F945, Break::pictographic},  {0x1F947, 0x1FAFF, Break::pictographic},  {0x1FC00, 0x1FFFD, Break::pictographic},
+    {0xE0000, 0xE001F, Break::control},       {0xE0020, 0xE007F, Break::extend},        {0xE0080, 0xE00FF, Break::control},
+    {0xE0100, 0xE01EF, Break::extend},        {0xE01F0, 0xE0FFF, Break::control},
+};
+
+Break grapheme_break(char32_t c) {
+    if (c < 0x80) {
+        return c == '\r' ? Break::cr : c == '\n' ? Break::lf : (c < 0x20 || c == 0x7F) ? Break::control : Break::other;
+    }
+    if (c < 0xA0 || c == 0xAD) {
+        return Break::control;
+    }
+    // Devanagari to Malayalam share one layout: signs and vowel signs sit at the same
+    // offsets in every 128-code-point block.
+    if (c >= 0x0900 && c <= 0x0DFF) {
+        char32_t offset = c & 0x7F;
+        bool mark = offset <= 0x03 || (offset >= 0x3A && offset <= 0x4F && offset != 0x3D) || (offset >= 0x51 && offset <= 0x57) ||
+                    offset == 0x62 || offset == 0x63;
+        return mark ? Break::extend : Break::other;
+    }
+    if (c >= 0xAC00 && c <= 0xD7A3) {
+        return (c - 0xAC00) % 28 == 0 ? Break::lv : Break::lvt;
+    }
+    auto it = std::upper_bound(std::begin(ranges), std::end(ranges), c, [](char32_t value, const Range& range) { return value < range.first; });
+    if (it != std::begin(ranges) && c <= (it - 1)->last) {
+        return (it - 1)->value;
+    }
+    return Break::other;
+}
+
+} // namespace
+
+bool utf8_valid(std::string_view text) {
+    std::size_t i = 0;
+    const std::size_t size = text.size();
+    while (i < size) {
+        if (size - i >= 8 && ascii_chunk(text, i)) {
+            i += 8;
+            continue;
+        }
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+        char32_t code_point;
+        std::size_t length = utf8_decode(text, i, code_point);
+        if (code_point == 0xFFFD && length == 1) {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
+std::size_t ascii_word_run(std::string_view text, std::size_t i) {
+    std::size_t start = i;
+    while (text.size() - i >= 8 && ascii_graphic_chunk(text, i)) {
+        i += 8;
+    }
+    return i - start;
+}
+
+std::size_t utf8_decode(std::string_view text, std::size_t i, char32_t& code_point) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (c < 0x80) {
+        code_point = c;
+        return 1;
+    }
+    std::size_t length;
+    char32_t minimum;
+    if ((c & 0xE0) == 0xC0) {
+        length = 2;
+        code_point = c & 0x1F;
+        minimum = 0x80;
+    } else if ((c & 0xF0) == 0xE0) {
+        length = 3;
+        code_point = c & 0x0F;
+        minimum = 0x800;
+    } else if ((c & 0xF8) == 0xF0) {
+        length = 4;
+        code_point = c & 0x07;
+        minimum = 0x10000;
+    } else {
+        code_point = 0xFFFD;
+        return 1;
+    }
+    if (text.size() - i < length) {
+        code_point = 0xFFFD;
+        return 1;
+    }
+    for (std::size_t k = 1; k < length; ++k) {
+        unsigned char next = static_cast<unsigned char>(text[i + k]);
+        if ((next & 0xC0) != 0x80) {
+            code_point = 0xFFFD;
+            return 1;
+        }
+        code_point = (code_point << 6) | (next & 0x3F);
+    }
+    if (code_point < minimum || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+        code_point = 0xFFFD;
+        return 1;
+    }
+    return length;
+}
+
+std::size_t utf8_space_length(std::string_view text, std::size_t i) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (c < 0x80) {
+        return ascii_space(c) ? 1 : 0;
+    }
+    // The non-ASCII spaces, matched on their encodings: U+0085, U+00A0, U+1680,
+    // U+2000-U+200A, U+2028, U+2029, U+202F, U+205F and U+3000.
+    std::size_t remaining = text.size() - i;
+    if (c == 0xC2) {
+        return remaining >= 2 && (text[i + 1] == '\x85' || text[i + 1] == '\xA0') ? 2 : 0;
+    }
+    if (remaining < 3 || c < 0xE1 || c > 0xE3) {
+        return 0;
+    }
+    unsigned char b1 = static_cast<unsigned char>(text[i + 1]);
+    unsigned char b2 = static_cast<unsigned char>(text[i + 2]);
+    bool space = false;
+    if (c == 0xE1) {
+        space = b1 == 0x9A && b2 == 0x80;
+    } else if (c == 0xE2) {
+        space = (b1 == 0x80 && ((b2 >= 0x80 && b2 <= 0x8A) || b2 == 0xA8 || b2 == 0xA9 || b2 == 0xAF)) || (b1 == 0x81 && b2 == 0x9F);
+    } else {
+        space = b1 == 0x80 && b2 == 0x80;
+    }
+    return space ? 3 : 0;
+}
+
+std::size_t grapheme_length(std::string_view text, std::size_t i) {
+    // ASCII other than CR LF is one cluster per byte unless a combining mark follows.
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (c < 0x80 && (i + 1 == text.size() || (static_cast<unsigned char>(text[i + 1]) < 0x80 && !(c == '\r' && text[i + 1] == '\n')))) {
+        return 1;
+    }
+
+    char32_t code_point;
+    std::size_t end = i + utf8_decode(text, i, code_point);
+    Break previous = grapheme_break(code_point);
+    std::size_t regional_indicators = previous == Break::regional_indicator ? 1 : 0;
+    // Inside "Extended_Pictographic Extend*" (GB11 allows a ZWJ and another pictograph next).
+    bool pictographic = previous == Break::pictographic;
+    while (end < text.size()) {
+        std::size_t length = utf8_decode(text, end, code_point);
+        Break next = grapheme_break(code_point);
+        bool join;
+        if (previous == Break::cr && next == Break::lf) {
+            join = true; // GB3
+        } else if (previous == Break::cr || previous == Break::lf || previous == Break::control || next == Break::cr || next == Break::lf ||
+                   next == Break::control) {
+            join = false; // GB4, GB5
+        } else if (previous == Break::l && (next == Break::l || next == Break::v || next == Break::lv || next == Break::lvt)) {
+            join = true; // GB6
+        } else if ((previous == Break::lv || previous == Break::v) && (next == Break::v || next == Break::t)) {
+            join = true; // GB7
+        } else if ((previous == Break::lvt || previous == Break::t) && next == Break::t) {
+            join = true; // GB8
+        } else if (next == Break::extend || next == Break::zwj || next == Break::spacing_mark) {
+            join = true; // GB9, GB9a
+        } else if (previous == Break::zwj && next == Break::pictographic) {
+            join = pictographic; // GB11
+        } else if (previous == Break::regional_indicator && next == Break::regional_indicator) {
+            join = regional_indicators % 2 == 1; // GB12, GB13
+        } else {
+            join = false; // GB999
+        }
+        if (!join) {
+            break;
+        }
+        if (next == Break::pictographic) {
+            pictographic = true;
+        } else if (next != Break::extend && next != Break::zwj) {
+            pictographic = false;
+        }
+        regional_indicators = next == Break::regional_indicator ? regional_indicators + 1 : 0;
+        previous = next;
+        end += length;
+    }
+    return end - i;
+}
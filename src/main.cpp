@@ -1,27 +1,255 @@
+#include "compare/DiffSerializer.h"
+#include "compare/DocumentStore.h"
+#include "compare/LiveDiffHandler.h"
 #include "compare/LongestCommonSubsequence.h"
+#include "compare/NearDuplicateIndex.h"
+#include "compare/ParallelDiff.h"
+#include "compare/Similarity.h"
+#include "compare/ThreeWayMerge.h"
+#include "compare/UnifiedDiff.h"
+#include "compare/Utf8.h"
+#include "Config.h"
+#include "HotRestart.h"
+#include "MimeTypes.h"
+#include "Offload.h"
+#include "RequestArena.h"
 #include "RestController.h"
+#include "session/SessionLog.h"
+#include "session/SessionStore.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
 #include <boost/json.hpp>
+#include <cstdlib>
 #include <iostream>
+#include <thread>
+
+namespace {
+
+// One text of /compare or /similarity: sent inline, or a stored document named by id.
+struct CompareInput {
+    std::shared_ptr<const DocumentStore::Document> document;
+    std::string_view text;
+    enum class Unit { word, grapheme, line };
+    Unit unit = Unit::word; // What the text is split into
+    std::pmr::vector<std::string_view> split;
+    std::pmr::vector<std::uint32_t> lookup;
+    const std::pmr::vector<std::uint32_t>* symbols = nullptr; // Set by encode_inputs()
+
+    explicit CompareInput(std::pmr::memory_resource* resource) : split(resource), lookup(resource) {}
+
+    // Stored words with their interned ids; a stored document split otherwise is split again.
+    bool interned() const { return document && unit == Unit::word; }
+    const std::pmr::vector<std::string_view>& words() const { return interned() ? document->words : split; }
+    // Interned ids of the words; inline text is looked up in the store.
+    const std::pmr::vector<std::uint32_t>& tokens(const DocumentStore& store) {
+        if (interned()) {
+            return document->tokens;
+        }
+        if (lookup.size() != split.size()) {
+            store.lookup(split, lookup);
+        }
+        return lookup;
+    }
+};
+
+// Gives the words of both texts symbols, equal for equal words: the interned ids if either
+// text is stored, otherwise ids for this pair alone.
+void encode_inputs(CompareInput& input1, CompareInput& input2, const DocumentStore& store, std::pmr::memory_resource* resource) {
+    if (input1.interned() || input2.interned()) {
+        input1.symbols = &input1.tokens(store);
+        input2.symbols = &input2.tokens(store);
+    } else {
+        encode_words(input1.split, input2.split, input1.lookup, input2.lookup, resource);
+        input1.symbols = &input1.lookup;
+        input2.symbols = &input2.lookup;
+    }
+}
+
+void json_error(BoostResponse& res, boost::beast::http::status status, const char* body) {
+    res.result(status);
+    res.set(boost::beast::http::field::content_type, "application/json");
+    res.body() = body;
+}
+
+// Reads the text under `text_key`, or the stored document named by `id_key`. Answers the
+// request and returns false if neither is there or the document is unknown.
+bool read_input(const boost::json::object& json, const char* text_key, const char* id_key, DocumentStore& store, LongestCommonSubsequence& lcs,
+                CompareInput& input, BoostResponse& res) {
+    if (const boost::json::value* id = json.if_contains(id_key)) {
+        const boost::json::string& value = id->as_string();
+        input.document = store.get(std::string_view(value.data(), value.size()));
+        if (!input.document) {
+            json_error(res, boost::beast::http::status::not_found, R"({"message": "Unknown document", "status": "error"})");
+            return false;
+        }
+        input.text = input.document->text;
+    } else if (const boost::json::value* text = json.if_contains(text_key)) {
+        const boost::json::string& value = text->as_string();
+        input.text = std::string_view(value.data(), value.size());
+    } else {
+        json_error(res, boost::beast::http::status::bad_request, R"({"message": "Missing required fields", "status": "error"})");
+        return false;
+    }
+    if (input.unit == CompareInput::Unit::grapheme) {
+        input.split = lcs.splitGraphemes(input.text);
+    } else if (input.unit == CompareInput::Unit::line) {
+        input.split = lcs.splitLines(input.text);
+    } else if (!input.document) {
+        input.split = lcs.splitWords(input.text);
+    }
+    return true;
+}
+
+// Either text can be a stored document: base_id instead of str1, target_id instead of str2.
+// "mode" is "word" (the default) or "grapheme", which compares user-perceived characters.
+bool read_inputs(const boost::json::object& json, DocumentStore& store, LongestCommonSubsequence& lcs, CompareInput& input1, CompareInput& input2,
+                 BoostResponse& res) {
+    if (const boost::json::value* value = json.if_contains("mode")) {
+        const boost::json::string& name = value->as_string();
+        std::string_view mode(name.data(), name.size());
+        if (mode != "word" && mode != "grapheme") {
+            json_error(res, boost::beast::http::status::bad_request, R"({"message": "Unknown mode", "status": "error"})");
+            return false;
+        }
+        input1.unit = input2.unit = mode == "grapheme" ? CompareInput::Unit::grapheme : CompareInput::Unit::word;
+    }
+    return read_input(json, "str1", "base_id", store, lcs, input1, res) && read_input(json, "str2", "target_id", store, lcs, input2, res);
+}
+
+// A coroutine route that runs `handler` on a worker of `pool`, so a long diff holds up
+// neither the I/O thread nor the other connections on it. The handler takes its scratch
+// from the worker's own RequestArena::local() and releases it before returning.
+template <class Handler>
+auto offloaded(std::shared_ptr<WorkStealingPool> pool, Handler handler) {
+    return [pool, handler = std::move(handler)](const BoostRequest& req, BoostResponse& res, ResponseStream&) -> boost::asio::awaitable<void> {
+        co_await offload(*pool, [&]() { handler(req, res); });
+    };
+}
+
+} // namespace
 
 int main(int argc, char* argv[]) {
-    const int port = 8080; // This port should match with the port in the Dockerfile
-    const int num_threads = 1;
-    std::cout << "Server running on http://localhost:" << port << "." << std::endl;
-    auto rest_controller = RestController::getInstance("/compare/index.html"); // Default Target
+    Config config;
+    try {
+        config = Config::load(argc, argv);
+        Config::set_current(std::make_shared<const Config>(config));
+        // Extra or replacement mime types, in mime.types format.
+        if (!config.mime_types_file.empty()) {
+            MimeTypes::load(config.mime_types_file);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Configuration error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Server running on http://localhost:" << config.port << "." << std::endl;
+    auto rest_controller = RestController::getInstance(config.default_target);
+    rest_controller->set_static_files(config.default_target, config.ui_prefix);
 
     rest_controller->add_routes(Method::get, "/api/hello", [](const BoostRequest& req, BoostResponse& res) {
         res.result(boost::beast::http::status::ok);
-        res.set(boost::beast::http::field::content_type, "application/json");
         res.body() = R"({"message": "Welcome to the REST API", "status": "success"})";
-    });
+    }, 0, {{boost::beast::http::field::content_type, "application/json"}});
 
     rest_controller->add_routes(Method::get, "/status", [](const BoostRequest& req, BoostResponse& res) {
         res.result(boost::beast::http::status::ok);
-        res.set(boost::beast::http::field::content_type, "text/plain");
         res.body() = "API is running smoothly";
+    }, 0, {{boost::beast::http::field::content_type, "text/plain"}});
+
+    // Cookie sessions: POST creates one from the request body, GET returns its data,
+    // PUT replaces the data and DELETE ends it.
+    auto session_store = std::make_shared<SessionStore>(config.sessions.shards, config.sessions.ttl);
+    // Sessions are persisted only when sessions.data_dir names an existing directory.
+    if (!config.sessions.data_dir.empty()) {
+        SessionLog::Options log_options;
+        log_options.directory = config.sessions.data_dir;
+        auto session_log = std::make_shared<SessionLog>(log_options);
+        session_log->recover([&](const SessionStore::SessionId& id, std::string_view data, SessionStore::Clock::time_point expires) {
+            session_store->restore(id, data, expires);
+        });
+        session_store->set_log(session_log);
+        // After a hot restart the previous process is still draining, so the recovered logs
+        // are left as they are; compaction starts once they grow.
+        bool restarted = HotRestart::inherited_listener().has_value();
+        session_log->start([store = std::weak_ptr<SessionStore>(session_store)](const SessionStore::Visitor& visitor) {
+            auto locked = store.lock();
+            if (locked) {
+                locked->for_each(visitor);
+            }
+            return locked != nullptr;
+        }, !restarted);
+        // The new process recovers from the log, so stop writing to it first. Sessions changed
+        // after that are not handed over.
+        rest_controller->add_restart_hook([session_log](bool handing_over) {
+            if (handing_over) {
+                session_log->suspend();
+            } else {
+                session_log->resume();
+            }
+        });
+    }
+    auto session_id = [](const BoostRequest& req) {
+        auto cookie = req[boost::beast::http::field::cookie];
+        return SessionStore::find_cookie(std::string_view(cookie.data(), cookie.size()), "session_id");
+    };
+    auto session_json = [](BoostResponse& res, boost::beast::http::status status, const boost::json::object& body) {
+        res.result(status);
+        res.set(boost::beast::http::field::content_type, "application/json");
+        res.body() = boost::json::serialize(body);
+    };
+
+    rest_controller->add_routes(Method::post, "/session", [session_store, session_json](const BoostRequest& req, BoostResponse& res) {
+        std::string id = session_store->create(req.body());
+        res.set(boost::beast::http::field::set_cookie,
+                "session_id=" + id + "; Path=/; HttpOnly; SameSite=Strict; Max-Age=" + std::to_string(session_store->ttl().count()));
+        session_json(res, boost::beast::http::status::created, {{"session_id", id}, {"status", "success"}});
+    });
+
+    rest_controller->add_routes(Method::get, "/session", [session_store, session_id, session_json](const BoostRequest& req, BoostResponse& res) {
+        auto data = session_store->get(session_id(req));
+        if (!data) {
+            session_json(res, boost::beast::http::status::unauthorized, {{"message", "No valid session"}, {"status", "error"}});
+            return;
+        }
+        session_json(res, boost::beast::http::status::ok, {{"data", *data}, {"status", "success"}});
+    });
+
+    rest_controller->add_routes(Method::put, "/session", [session_store, session_id, session_json](const BoostRequest& req, BoostResponse& res) {
+        if (!session_store->update(session_id(req), req.body())) {
+            session_json(res, boost::beast::http::status::unauthorized, {{"message", "No valid session"}, {"status", "error"}});
+            return;
+        }
+        session_json(res, boost::beast::http::status::ok, {{"status", "success"}});
+    });
+
+    rest_controller->add_routes(Method::delete_, "/session", [session_store, session_id, session_json](const BoostRequest& req, BoostResponse& res) {
+        session_store->erase(session_id(req));
+        res.set(boost::beast::http::field::set_cookie, "session_id=; Path=/; HttpOnly; SameSite=Strict; Max-Age=0");
+        session_json(res, boost::beast::http::status::ok, {{"status", "success"}});
     });
 
-    rest_controller->add_routes(Method::post, "/compare", [](const BoostRequest& req, BoostResponse& res) {
+    // Workers that run /compare, /merge and /index/query off the I/O threads and split large
+    // diffs; the worker handling a request is one of the compare.threads it splits across.
+    const std::size_t diff_threads = config.compare.threads != 0 ? config.compare.threads : std::max(1u, std::thread::hardware_concurrency());
+    auto diff_pool = std::make_shared<WorkStealingPool>(diff_threads);
+
+    // Documents uploaded once (the raw request body) and then compared by id.
+    auto document_store = std::make_shared<DocumentStore>(config.documents.max_bytes);
+    rest_controller->add_routes(Method::post, "/documents", [document_store, session_json](const BoostRequest& req, BoostResponse& res) {
+        if (!utf8_valid(req.body())) {
+            session_json(res, boost::beast::http::status::bad_request, {{"message", "Body is not valid UTF-8"}, {"status", "error"}});
+            return;
+        }
+        bool created = false;
+        auto document = document_store->put(req.body(), Config::current()->compare.max_tokens, created);
+        if (!document) {
+            session_json(res, boost::beast::http::status::payload_too_large, {{"message", "Document too large"}, {"status", "error"}});
+            return;
+        }
+        session_json(res, created ? boost::beast::http::status::created : boost::beast::http::status::ok,
+                     {{"id", document->id}, {"words", document->words.size()}, {"status", "success"}});
+    }, config.compare.body_limit);
+
+    rest_controller->add_routes(Method::post, "/compare", offloaded(diff_pool, [=](const BoostRequest& req, BoostResponse& res) {
         auto bad_request = [&res]() {
             res.result(boost::beast::http::status::bad_request);
             res.set(boost::beast::http::field::content_type, "application/json");
@@ -29,52 +257,404 @@ int main(int argc, char* argv[]) {
         };
 
         try {
-            boost::json::value json_body = boost::json::parse(req.body());
-            boost::json::object json_obj = json_body.as_object();
+            // Everything below is request scratch: it lives in this worker's arena and is
+            // released in one step when the scope ends.
+            RequestArena& arena = RequestArena::local();
+            RequestArena::Scope arena_scope(arena);
+            boost::json::storage_ptr storage = arena.json_storage();
 
+            boost::json::value json_body = boost::json::parse(req.body(), storage);
+            const boost::json::object& json_obj = json_body.as_object();
+
+            const bool debug = Config::log_enabled(LogLevel::debug);
             // print all elements inside the json object
-            for (auto& element : json_obj) {
-                std::cout << "\t" << element.key() << ": " << element.value() << std::endl;
+            if (debug) {
+                for (auto& element : json_obj) {
+                    std::cout << "\t" << element.key() << ": " << element.value() << std::endl;
+                }
+            }
+
+            // "format": "unified" answers with a line diff in diff -u form instead of the
+            // JSON word diff, with "context" unchanged lines (3 by default) around changes.
+            bool unified = false;
+            if (const boost::json::value* value = json_obj.if_contains("format")) {
+                const boost::json::string& name = value->as_string();
+                std::string_view format(name.data(), name.size());
+                if (format != "json" && format != "unified") {
+                    json_error(res, boost::beast::http::status::bad_request, R"({"message": "Unknown format", "status": "error"})");
+                    return;
+                }
+                unified = format == "unified";
             }
 
-            bool elem1 = json_obj.find("str1") != json_obj.end();
-            bool elem2 = json_obj.find("str2") != json_obj.end();
-            if (!elem1 || !elem2) {
-                bad_request();
+            LongestCommonSubsequence lcs(&arena);
+            CompareInput input1(&arena);
+            CompareInput input2(&arena);
+            if (unified) {
+                input1.unit = input2.unit = CompareInput::Unit::line;
+                if (!read_input(json_obj, "str1", "base_id", *document_store, lcs, input1, res) ||
+                    !read_input(json_obj, "str2", "target_id", *document_store, lcs, input2, res)) {
+                    return;
+                }
+            } else if (!read_inputs(json_obj, *document_store, lcs, input1, input2, res)) {
                 return;
             }
+            std::string_view str1 = input1.text;
+            std::string_view str2 = input2.text;
+            const std::pmr::vector<std::string_view>& words1 = input1.words();
+            const std::pmr::vector<std::string_view>& words2 = input2.words();
 
-            std::string str1 = json_obj["str1"].as_string().c_str();
-            std::string str2 = json_obj["str2"].as_string().c_str();
+            const Config::Compare limits = Config::current()->compare;
+            auto too_large = [&res]() {
+                json_error(res, boost::beast::http::status::payload_too_large, R"({"message": "Too many words to compare", "status": "error"})");
+            };
+            if (words1.size() > limits.max_tokens || words2.size() > limits.max_tokens) {
+                too_large();
+                return;
+            }
+            if (unified) {
+                std::int64_t context = 3;
+                if (const boost::json::value* value = json_obj.if_contains("context")) {
+                    context = value->as_int64();
+                }
+                if (context < 0) {
+                    json_error(res, boost::beast::http::status::bad_request, R"({"message": "context must not be negative", "status": "error"})");
+                    return;
+                }
+                if (words1.size() * words2.size() > limits.max_cells) {
+                    too_large();
+                    return;
+                }
+                encode_inputs(input1, input2, *document_store, &arena);
+                std::pmr::vector<Operation> operations(words1.size() + words2.size(), &arena);
+                std::size_t count = lcs.diffSymbols(input1.symbols->data(), words1.size(), input2.symbols->data(), words2.size(), operations.data());
+                res.result(boost::beast::http::status::ok);
+                res.set(boost::beast::http::field::content_type, "text/x-diff");
+                // Equal texts give an empty body, as diff prints nothing for them.
+                res.body() = "--- str1\n+++ str2\n";
+                std::size_t header_size = res.body().size();
+                write_unified_diff(words1, words2, operations.data(), count, static_cast<std::size_t>(context), res.body());
+                if (res.body().size() == header_size) {
+                    res.body().clear();
+                }
+                return;
+            }
 
-            std::unique_ptr<LongestCommonSubsequence> lcs = std::make_unique<LongestCommonSubsequence>();
-            std::vector<Diff> diffs = lcs->stringDiff(str1, str2);
+            std::pmr::vector<Diff> diffs(&arena);
+            if (words1.size() * words2.size() >= limits.parallel_cells) {
+                encode_inputs(input1, input2, *document_store, &arena);
+                ParallelDiff parallel(*diff_pool, &arena);
+                parallel.plan(*input1.symbols, *input2.symbols);
+                if (parallel.cells() > limits.max_cells) {
+                    too_large();
+                    return;
+                }
+                diffs = parallel.run(words1, words2);
+            } else if (words1.size() * words2.size() > limits.max_cells) {
+                too_large();
+                return;
+            } else if (input1.interned() || input2.interned()) {
+                // Stored words are compared by interned id; an inline text is looked up.
+                diffs = lcs.stringDiffutil(words1, words2, input1.tokens(*document_store), input2.tokens(*document_store));
+            } else {
+                diffs = lcs.stringDiffutil(words1, words2);
+            }
 
             // print diffs in a single line
-            std::cout << "Differences between '" << str1 << "' and '" << str2 << "':" << std::endl;
-            std::cout << "[";
-            boost::json::array responseArray;
-            for (const auto &diff : diffs) {
-                boost::json::object jsonDiffObj;
-                jsonDiffObj["operation"] = diff.get_operation_string();
-                jsonDiffObj["str"] = diff.get_text();
-                responseArray.push_back(jsonDiffObj);
-                std::cout << diff << " ";
-            }
-            std::cout << "]" << std::endl;
+            if (debug) {
+                std::cout << "Differences between '" << str1 << "' and '" << str2 << "':" << std::endl;
+                std::cout << "[";
+                for (const auto &diff : diffs) {
+                    std::cout << diff << " ";
+                }
+                std::cout << "]" << std::endl;
+            }
             res.result(boost::beast::http::status::ok);
             res.set(boost::beast::http::field::content_type, "application/json");
 
-            boost::json::object body_obj;
-            body_obj["result"] = responseArray;
-            res.body() = boost::json::serialize(body_obj);
+            serialize_diffs(diffs, res.body(), storage);
         } catch (const std::exception& e) {
             bad_request();
         }
-    });
+    }), config.compare.body_limit);
+
+    // How different two texts are, without building the diff. "metric" is "lcs" (the
+    // default, in words), "edit_distance" (in words), "jaccard" (over shingles of "shingle"
+    // words, 3 by default) or "minhash" (an estimate of jaccard).
+    // Also used by /similarity, which reuses the signatures of indexed documents.
+    auto near_duplicates = std::make_shared<NearDuplicateIndex>(config.index.max_documents);
+    rest_controller->add_routes(Method::post, "/similarity", [=](const BoostRequest& req, BoostResponse& res) {
+        try {
+            RequestArena& arena = RequestArena::local();
+            RequestArena::Scope arena_scope(arena);
+            boost::json::storage_ptr storage = arena.json_storage();
+
+            boost::json::value json_body = boost::json::parse(req.body(), storage);
+            const boost::json::object& json_obj = json_body.as_object();
+
+            LongestCommonSubsequence lcs(&arena);
+            CompareInput input1(&arena);
+            CompareInput input2(&arena);
+            if (!read_inputs(json_obj, *document_store, lcs, input1, input2, res)) {
+                return;
+            }
+            const std::pmr::vector<std::string_view>& words1 = input1.words();
+            const std::pmr::vector<std::string_view>& words2 = input2.words();
+            // The kernels are linear in space, so only the token count is capped.
+            const std::size_t max_tokens = Config::current()->compare.max_tokens;
+            if (words1.size() > max_tokens || words2.size() > max_tokens) {
+                json_error(res, boost::beast::http::status::payload_too_large, R"({"message": "Too many words to compare", "status": "error"})");
+                return;
+            }
+
+            std::string_view metric = "lcs";
+            if (const boost::json::value* value = json_obj.if_contains("metric")) {
+                if (!value->is_string()) {
+                    json_error(res, boost::beast::http::status::bad_request, R"({"message": "Unknown metric", "status": "error"})");
+                    return;
+                }
+                const boost::json::string& name = value->get_string();
+                metric = std::string_view(name.data(), name.size());
+            }
+            std::size_t shingle = NearDuplicateIndex::shingle_size;
+            if (const boost::json::value* value = json_obj.if_contains("shingle")) {
+                if (!value->is_int64() || value->as_int64() <= 0) {
+                    json_error(res, boost::beast::http::status::bad_request, R"({"message": "shingle must be a positive integer", "status": "error"})");
+                    return;
+                }
+                shingle = static_cast<std::size_t>(value->as_int64());
+            }
+
+            boost::json::value result(storage);
+            if (metric == "lcs" || metric == "edit_distance") {
+                encode_inputs(input1, input2, *document_store, &arena);
+                result = metric == "lcs" ? lcs_length(*input1.symbols, *input2.symbols, &arena) : edit_distance(*input1.symbols, *input2.symbols, &arena);
+            } else if (metric == "jaccard") {
+                result = jaccard(shingles(words1, shingle, &arena), shingles(words2, shingle, &arena));
+            } else if (metric == "minhash") {
+                // An indexed document's signature is reused; anything else is hashed here,
+                // which costs more than the exact jaccard.
+                auto signature = [&](const CompareInput& input) {
+                    if (input.document && shingle == NearDuplicateIndex::shingle_size) {
+                        auto stored = near_duplicates->signature(input.document->id, &arena);
+                        if (!stored.empty()) {
+                            return stored;
+                        }
+                    }
+                    return minhash(shingles(input.words(), shingle, &arena), NearDuplicateIndex::signature_size, &arena);
+                };
+                result = minhash_similarity(signature(input1), signature(input2));
+            } else {
+                json_error(res, boost::beast::http::status::bad_request, R"({"message": "Unknown metric", "status": "error"})");
+                return;
+            }
+
+            boost::json::object body(storage);
+            body.emplace("metric", metric);
+            body.emplace("value", result);
+            body.emplace("words1", words1.size());
+            body.emplace("words2", words2.size());
+            body.emplace("status", "success");
+            res.result(boost::beast::http::status::ok);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = boost::json::serialize(body);
+        } catch (const std::exception& e) {
+            RestController::getInstance()->error_response(boost::beast::http::status::bad_request, std::string("Invalid request: ") + e.what(), res);
+        }
+    }, config.compare.body_limit);
+
+    // Applies "patch", a unified diff as /compare returns it, to "base" (or the stored
+    // document "base_id") and returns the result.
+    rest_controller->add_routes(Method::post, "/apply", [=](const BoostRequest& req, BoostResponse& res) {
+        try {
+            RequestArena& arena = RequestArena::local();
+            RequestArena::Scope arena_scope(arena);
+            boost::json::storage_ptr storage = arena.json_storage();
+
+            boost::json::value json_body = boost::json::parse(req.body(), storage);
+            const boost::json::object& json_obj = json_body.as_object();
+
+            std::string_view base;
+            std::shared_ptr<const DocumentStore::Document> document;
+            if (const boost::json::value* id = json_obj.if_contains("base_id")) {
+                const boost::json::string& value = id->as_string();
+                document = document_store->get(std::string_view(value.data(), value.size()));
+                if (!document) {
+                    json_error(res, boost::beast::http::status::not_found, R"({"message": "Unknown document", "status": "error"})");
+                    return;
+                }
+                base = document->text;
+            } else {
+                const boost::json::string& value = json_obj.at("base").as_string();
+                base = std::string_view(value.data(), value.size());
+            }
+            const boost::json::string& patch = json_obj.at("patch").as_string();
+
+            boost::json::object body(storage);
+            try {
+                std::pmr::string result = apply_unified_diff(base, std::string_view(patch.data(), patch.size()), &arena);
+                body.emplace("result", std::string_view(result));
+            } catch (const std::runtime_error& e) {
+                res.result(boost::beast::http::status::conflict);
+                res.set(boost::beast::http::field::content_type, "application/json");
+                res.body() = boost::json::serialize(boost::json::object{{"message", e.what()}, {"status", "error"}});
+                return;
+            }
+            body.emplace("status", "success");
+            res.result(boost::beast::http::status::ok);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = boost::json::serialize(body);
+        } catch (const std::exception& e) {
+            json_error(res, boost::beast::http::status::bad_request, R"({"message": "Missing required fields", "status": "error"})");
+        }
+    }, config.compare.body_limit);
+
+    // Three-way merge: "base" with the changes of both "ours" and "theirs" (each also by id, as
+    // base_id, ours_id and theirs_id). Returns the merged text and the conflicts in it.
+    rest_controller->add_routes(Method::post, "/merge", offloaded(diff_pool, [=](const BoostRequest& req, BoostResponse& res) {
+        try {
+            RequestArena& arena = RequestArena::local();
+            RequestArena::Scope arena_scope(arena);
+            boost::json::storage_ptr storage = arena.json_storage();
+
+            boost::json::value json_body = boost::json::parse(req.body(), storage);
+            const boost::json::object& json_obj = json_body.as_object();
+
+            LongestCommonSubsequence lcs(&arena);
+            CompareInput base(&arena);
+            CompareInput ours(&arena);
+            CompareInput theirs(&arena);
+            if (!read_input(json_obj, "base", "base_id", *document_store, lcs, base, res) ||
+                !read_input(json_obj, "ours", "ours_id", *document_store, lcs, ours, res) ||
+                !read_input(json_obj, "theirs", "theirs_id", *document_store, lcs, theirs, res)) {
+                return;
+            }
+            // Two diffs against base, each limited like a /compare.
+            const Config::Compare limits = Config::current()->compare;
+            std::size_t m = base.words().size();
+            std::size_t n = std::max(ours.words().size(), theirs.words().size());
+            if (m > limits.max_tokens || n > limits.max_tokens || m * n > limits.max_cells) {
+                json_error(res, boost::beast::http::status::payload_too_large, R"({"message": "Too many words to compare", "status": "error"})");
+                return;
+            }
+
+            ThreeWayMerge::Result merged = ThreeWayMerge(*diff_pool, &arena)
+                                               .merge({base.text, base.words()}, {ours.text, ours.words()}, {theirs.text, theirs.words()});
+
+            boost::json::object body(storage);
+            body.emplace("merged", std::string_view(merged.text));
+            boost::json::array& conflicts = body.emplace("conflicts", boost::json::array_kind).first->value().get_array();
+            for (const ThreeWayMerge::Conflict& conflict : merged.conflicts) {
+                boost::json::object& item = conflicts.emplace_back(boost::json::object_kind).get_object();
+                item.emplace("start", conflict.begin);
+                item.emplace("end", conflict.end);
+                item.emplace("base", conflict.base);
+                item.emplace("ours", conflict.ours);
+                item.emplace("theirs", conflict.theirs);
+            }
+            body.emplace("status", "success");
+            res.result(boost::beast::http::status::ok);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = boost::json::serialize(body);
+        } catch (const std::exception& e) {
+            json_error(res, boost::beast::http::status::bad_request, R"({"message": "Missing required fields", "status": "error"})");
+        }
+    }), config.compare.body_limit);
+
+    // Near-duplicate search. POST /index adds the request body (stored as by POST
+    // /documents); POST /index/query returns the "k" indexed documents most like "str", or
+    // the stored document "id".
+    rest_controller->add_routes(Method::post, "/index", [document_store, near_duplicates, session_json](const BoostRequest& req, BoostResponse& res) {
+        if (!utf8_valid(req.body())) {
+            session_json(res, boost::beast::http::status::bad_request, {{"message", "Body is not valid UTF-8"}, {"status", "error"}});
+            return;
+        }
+        bool created = false;
+        auto document = document_store->put(req.body(), Config::current()->compare.max_tokens, created);
+        if (!document) {
+            session_json(res, boost::beast::http::status::payload_too_large, {{"message", "Document too large"}, {"status", "error"}});
+            return;
+        }
+        bool added = false;
+        if (!near_duplicates->add(document, added)) {
+            session_json(res, boost::beast::http::status::insufficient_storage, {{"message", "Index full"}, {"status", "error"}});
+            return;
+        }
+        session_json(res, added ? boost::beast::http::status::created : boost::beast::http::status::ok, {{"id", document->id}, {"status", "success"}});
+    }, config.compare.body_limit);
+
+    rest_controller->add_routes(Method::post, "/index/query", offloaded(diff_pool, [=](const BoostRequest& req, BoostResponse& res) {
+        try {
+            RequestArena& arena = RequestArena::local();
+            RequestArena::Scope arena_scope(arena);
+            boost::json::storage_ptr storage = arena.json_storage();
+
+            boost::json::value json_body = boost::json::parse(req.body(), storage);
+            const boost::json::object& json_obj = json_body.as_object();
+
+            LongestCommonSubsequence lcs(&arena);
+            CompareInput query(&arena);
+            if (!read_input(json_obj, "str", "id", *document_store, lcs, query, res)) {
+                return;
+            }
+            std::int64_t k = 5;
+            if (const boost::json::value* value = json_obj.if_contains("k")) {
+                k = value->as_int64();
+            }
+            if (k < 1 || k > 1000) {
+                json_error(res, boost::beast::http::status::bad_request, R"({"message": "k must be between 1 and 1000", "status": "error"})");
+                return;
+            }
+            const std::pmr::vector<std::string_view>& words = query.words();
+            if (words.size() > Config::current()->compare.max_tokens) {
+                json_error(res, boost::beast::http::status::payload_too_large, R"({"message": "Too many words to compare", "status": "error"})");
+                return;
+            }
+
+            // The best estimates are verified against the words themselves: the similarity is
+            // the diff ratio 2 * lcs / (m + n).
+            struct Match {
+                const NearDuplicateIndex::Candidate* candidate;
+                double similarity;
+            };
+            auto candidates = near_duplicates->candidates(words, 4 * static_cast<std::size_t>(k), &arena);
+            const std::pmr::vector<std::uint32_t>& tokens = query.tokens(*document_store);
+            std::pmr::vector<Match> matches(&arena);
+            matches.reserve(candidates.size());
+            for (const NearDuplicateIndex::Candidate& candidate : candidates) {
+                std::size_t total = tokens.size() + candidate.document->tokens.size();
+                std::size_t common = lcs_length(tokens, candidate.document->tokens, &arena);
+                matches.push_back({&candidate, total == 0 ? 1.0 : 2.0 * static_cast<double>(common) / static_cast<double>(total)});
+            }
+            std::stable_sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) { return a.similarity > b.similarity; });
+            matches.resize(std::min(matches.size(), static_cast<std::size_t>(k)));
+
+            boost::json::object body(storage);
+            boost::json::array& result = body.emplace("result", boost::json::array_kind).first->value().get_array();
+            for (const Match& match : matches) {
+                boost::json::object& item = result.emplace_back(boost::json::object_kind).get_object();
+                item.emplace("id", match.candidate->document->id);
+                item.emplace("similarity", match.similarity);
+                item.emplace("estimate", match.candidate->estimate);
+            }
+            body.emplace("status", "success");
+            res.result(boost::beast::http::status::ok);
+            res.set(boost::beast::http::field::content_type, "application/json");
+            res.body() = boost::json::serialize(body);
+        } catch (const std::exception& e) {
+            json_error(res, boost::beast::http::status::bad_request, R"({"message": "Missing required fields", "status": "error"})");
+        }
+    }), config.compare.body_limit);
+
+    // Live diff over a WebSocket: the client sends edits, the server answers with the
+    // changed part of the diff (see LiveDiffHandler.h).
+    rest_controller->add_websocket_route("/compare/live", []() {
+        const Config::Compare limits = Config::current()->compare;
+        return std::make_unique<LiveDiffHandler>(LiveDiff::Limits{limits.max_tokens, limits.max_cells});
+    }, config.compare.body_limit);
 
     try {
-        rest_controller->start_server(port, num_threads);
+        rest_controller->start_server(config);
     } catch (const std::exception& e) {
         std::cerr << "Exception: " << e.what() << std::endl;
         return EXIT_FAILURE;
@@ -0,0 +1,367 @@
+#include "session/SessionLog.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Record layout: u32 checksum | u32 payload size | payload, where the payload is
+// u8 type | u64 id[0] | u64 id[1] | i64 expiry (ms since epoch) | data.
+constexpr std::size_t header_size = 8;
+constexpr std::size_t fixed_payload_size = 1 + 8 + 8 + 8;
+
+std::uint32_t checksum(const char* data, std::size_t size) {
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+template <class T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+T get(const char* data) {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// A failed batch is retried from the last good offset to overwrite whatever part of it
+// reached the file.
+constexpr std::chrono::seconds retry_interval{1};
+
+void write_all(int fd, const char* data, std::size_t size, off_t offset, const std::string& path) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, data, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Write error on " + path + ": " + std::strerror(errno));
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+void sync_directory(const std::string& directory) {
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+} // namespace
+
+SessionLog::SessionLog(const Options& options)
+    : options(options),
+      log_path(options.directory + "/sessions.log"),
+      old_log_path(options.directory + "/sessions.log.old"),
+      snapshot_path(options.directory + "/sessions.snapshot") {
+}
+
+SessionLog::~SessionLog() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_available.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    if (log_fd >= 0) {
+        ::close(log_fd);
+    }
+}
+
+void SessionLog::recover(const Visitor& visitor) {
+    std::size_t records = replay(snapshot_path, visitor);
+    records += replay(old_log_path, visitor);
+    records += replay(log_path, visitor);
+    std::cout << "Recovered " << records << " session records from " << options.directory << std::endl;
+}
+
+std::size_t SessionLog::replay(const std::string& path, const Visitor& visitor) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return 0;
+    }
+    std::size_t size = static_cast<std::size_t>(info.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("mmap error on " + path + ": " + std::strerror(errno));
+    }
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const char* data = static_cast<const char*>(mapping);
+    std::size_t offset = 0;
+    std::size_t records = 0;
+    while (offset + header_size <= size) {
+        std::uint32_t expected = get<std::uint32_t>(data + offset);
+        std::uint32_t payload_size = get<std::uint32_t>(data + offset + 4);
+        const char* payload = data + offset + header_size;
+        // A short or corrupt record can only be the torn tail of an interrupted write.
+        if (payload_size < fixed_payload_size || payload_size > size - offset - header_size ||
+            checksum(payload, payload_size) != expected) {
+            break;
+        }
+
+        SessionStore::SessionId id{get<std::uint64_t>(payload + 1), get<std::uint64_t>(payload + 9)};
+        auto type = static_cast<RecordType>(payload[0]);
+        if (type == RecordType::put) {
+            SessionStore::Clock::time_point expires{std::chrono::milliseconds(get<std::int64_t>(payload + 17))};
+            visitor(id, std::string_view(payload + fixed_payload_size, payload_size - fixed_payload_size), expires);
+        } else {
+            visitor(id, std::string_view(), SessionStore::Clock::time_point::min());
+        }
+        offset += header_size + payload_size;
+        ++records;
+    }
+    ::munmap(mapping, size);
+    if (offset < size) {
+        std::cerr << "Dropping " << size - offset << " trailing bytes from " << path << std::endl;
+        if (::truncate(path.c_str(), static_cast<off_t>(offset)) != 0) {
+            std::cerr << "Truncate error on " << path << ": " << std::strerror(errno) << std::endl;
+        }
+    }
+    return records;
+}
+
+void SessionLog::start(SnapshotSource source, bool compact) {
+    snapshot_source = std::move(source);
+    open_log();
+    // Fold whatever was recovered into a fresh snapshot so the logs start empty.
+    compact_requested = compact;
+    running = true;
+    writer = std::thread([this]() { run(); });
+}
+
+void SessionLog::suspend() {
+    if (!writer.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_available.notify_all();
+    writer.join();
+    ::close(log_fd);
+    log_fd = -1;
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = false;
+}
+
+void SessionLog::resume() {
+    if (writer.joinable()) {
+        return;
+    }
+    open_log();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        running = true;
+        failed = false;
+    }
+    writer = std::thread([this]() { run(); });
+}
+
+void SessionLog::encode(std::string& out, RecordType type, const SessionStore::SessionId& id, std::int64_t expires_ms, std::string_view data) {
+    std::size_t start = out.size();
+    put<std::uint32_t>(out, 0);
+    put<std::uint32_t>(out, static_cast<std::uint32_t>(fixed_payload_size + data.size()));
+    out.push_back(static_cast<char>(type));
+    put(out, id[0]);
+    put(out, id[1]);
+    put(out, expires_ms);
+    out.append(data.data(), data.size());
+    std::uint32_t sum = checksum(out.data() + start + header_size, out.size() - start - header_size);
+    std::memcpy(&out[start], &sum, sizeof(sum));
+}
+
+void SessionLog::append_put(const SessionStore::SessionId& id, std::string_view data, SessionStore::Clock::time_point expires) {
+    auto expires_ms = std::chrono::duration_cast<std::chrono::milliseconds>(expires.time_since_epoch()).count();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        encode(pending, RecordType::put, id, expires_ms, data);
+        ++appended;
+    }
+    work_available.notify_one();
+}
+
+void SessionLog::append_erase(const SessionStore::SessionId& id) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        encode(pending, RecordType::erase, id, 0, std::string_view());
+        ++appended;
+    }
+    work_available.notify_one();
+}
+
+bool SessionLog::flush() {
+    std::unique_lock<std::mutex> lock(mtx);
+    std::uint64_t target = appended;
+    work_available.notify_one();
+    durable.wait(lock, [&]() { return committed >= target || failed || !running; });
+    return committed >= target;
+}
+
+void SessionLog::run() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        work_available.wait(lock, [&]() { return stopping || compact_requested || !pending.empty() || !batch.empty(); });
+        if (batch.empty() && pending.empty() && !compact_requested && stopping) {
+            break;
+        }
+
+        // Let a burst of appends accumulate into one commit.
+        if (!stopping && !pending.empty()) {
+            work_available.wait_for(lock, options.commit_interval, [&]() { return stopping; });
+        }
+        // A batch that could not be written is retried together with what came after it.
+        if (batch.empty()) {
+            batch.swap(pending);
+        } else {
+            batch += pending;
+            pending.clear();
+        }
+        std::uint64_t batch_end = appended;
+        bool compact_now = compact_requested;
+        compact_requested = false;
+        bool stop_now = stopping;
+        lock.unlock();
+
+        bool written = true;
+        if (!batch.empty()) {
+            try {
+                write_batch(batch);
+                batch.clear();
+            } catch (const std::exception& e) {
+                std::cerr << "Session log error: " << e.what() << std::endl;
+                written = false;
+            }
+        }
+        if (written && !stop_now && (compact_now || log_bytes >= options.compact_threshold)) {
+            try {
+                compact();
+            } catch (const std::exception& e) {
+                std::cerr << "Session log error: " << e.what() << std::endl;
+            }
+        }
+
+        lock.lock();
+        if (written) {
+            committed = batch_end;
+            durable.notify_all();
+        } else if (stopping) {
+            // Kept for resume(); the destructor drops them.
+            std::cerr << "Stopping with " << batch_end - committed << " session records unwritten" << std::endl;
+            pending.insert(0, batch);
+            failed = true;
+            durable.notify_all();
+            break;
+        } else {
+            compact_requested = compact_requested || compact_now;
+            work_available.wait_for(lock, retry_interval, [&]() { return stopping; });
+        }
+    }
+    running = false;
+    durable.notify_all();
+}
+
+void SessionLog::write_batch(const std::string& batch) {
+    try {
+        write_all(log_fd, batch.data(), batch.size(), static_cast<off_t>(log_bytes), log_path);
+        if (::fdatasync(log_fd) != 0) {
+            throw std::runtime_error("fdatasync error on " + log_path + ": " + std::strerror(errno));
+        }
+    } catch (...) {
+        // Cut off the part that did get written, so that recovery, which stops at the first
+        // bad record, does not lose what is written after it. The retry overwrites it anyway.
+        if (::ftruncate(log_fd, static_cast<off_t>(log_bytes)) != 0) {
+            std::cerr << "Truncate error on " << log_path << ": " << std::strerror(errno) << std::endl;
+        }
+        throw;
+    }
+    log_bytes += batch.size();
+}
+
+void SessionLog::compact() {
+    // Rotate first: records appended from here on go to the new log, and replaying them
+    // on top of the snapshot below is harmless. If an earlier compaction did not finish,
+    // the old log is still needed and the current one is simply kept.
+    if (::access(old_log_path.c_str(), F_OK) != 0) {
+        if (::rename(log_path.c_str(), old_log_path.c_str()) != 0) {
+            throw std::runtime_error("Rename error on " + log_path + ": " + std::strerror(errno));
+        }
+        ::close(log_fd);
+        open_log();
+        sync_directory(options.directory);
+    }
+
+    std::string snapshot;
+    auto now = SessionStore::Clock::now();
+    bool available = snapshot_source([&](const SessionStore::SessionId& id, std::string_view data, SessionStore::Clock::time_point expires) {
+        if (expires > now) {
+            encode(snapshot, RecordType::put, id,
+                   std::chrono::duration_cast<std::chrono::milliseconds>(expires.time_since_epoch()).count(), data);
+        }
+    });
+    if (!available) {
+        return;
+    }
+
+    std::string temporary_path = snapshot_path + ".tmp";
+    int fd = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("Open error on " + temporary_path + ": " + std::strerror(errno));
+    }
+    try {
+        write_all(fd, snapshot.data(), snapshot.size(), 0, temporary_path);
+        if (::fsync(fd) != 0) {
+            throw std::runtime_error("fsync error on " + temporary_path + ": " + std::strerror(errno));
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if (::rename(temporary_path.c_str(), snapshot_path.c_str()) != 0) {
+        throw std::runtime_error("Rename error on " + temporary_path + ": " + std::strerror(errno));
+    }
+    ::unlink(old_log_path.c_str());
+    sync_directory(options.directory);
+}
+
+void SessionLog::open_log() {
+    // Not O_APPEND: batches are written at log_bytes, the end of the last good one.
+    int fd = ::open(log_path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) != 0) {
+        int error = errno;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw std::runtime_error("Open error on " + log_path + ": " + std::strerror(error));
+    }
+    log_fd = fd;
+    log_bytes = static_cast<std::size_t>(info.st_size);
+}
@@ -0,0 +1,175 @@
+#include "session/SessionStore.h"
+#include "session/SessionLog.h"
+
+#include <random>
+
+SessionStore::SessionStore(std::size_t shard_count, std::chrono::seconds ttl)
+    : shard_count(shard_count ? shard_count : 1), time_to_live(ttl), shards(new Shard[this->shard_count]) {
+}
+
+std::string SessionStore::create(std::string data) {
+    thread_local std::random_device random;
+    SessionId id;
+    for (auto& word : id) {
+        word = (static_cast<std::uint64_t>(random()) << 32) | random();
+    }
+
+    Clock::time_point now = Clock::now();
+    Shard& shard = shard_for(id);
+    {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        expire(shard, now);
+        Entry& entry = shard.entries[id];
+        entry = Entry{std::move(data), now + time_to_live};
+        shard.expiry.emplace_back(entry.expires, id);
+        // Appending under the shard lock keeps the log in the same order as the shard.
+        if (log) {
+            log->append_put(id, entry.data, entry.expires);
+        }
+    }
+    return format_id(id);
+}
+
+std::optional<std::string> SessionStore::get(std::string_view text) {
+    auto id = parse_id(text);
+    if (!id) {
+        return std::nullopt;
+    }
+    Shard& shard = shard_for(*id);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto iter = shard.entries.find(*id);
+    if (iter == shard.entries.end()) {
+        return std::nullopt;
+    }
+    if (iter->second.expires <= Clock::now()) {
+        shard.entries.erase(iter);
+        return std::nullopt;
+    }
+    return iter->second.data;
+}
+
+bool SessionStore::update(std::string_view text, std::string data) {
+    auto id = parse_id(text);
+    if (!id) {
+        return false;
+    }
+    Shard& shard = shard_for(*id);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto iter = shard.entries.find(*id);
+    if (iter == shard.entries.end() || iter->second.expires <= Clock::now()) {
+        return false;
+    }
+    iter->second.data = std::move(data);
+    if (log) {
+        log->append_put(*id, iter->second.data, iter->second.expires);
+    }
+    return true;
+}
+
+bool SessionStore::erase(std::string_view text) {
+    auto id = parse_id(text);
+    if (!id) {
+        return false;
+    }
+    Shard& shard = shard_for(*id);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    if (shard.entries.erase(*id) == 0) {
+        return false;
+    }
+    if (log) {
+        log->append_erase(*id);
+    }
+    return true;
+}
+
+void SessionStore::restore(const SessionId& id, std::string_view data, Clock::time_point expires) {
+    Shard& shard = shard_for(id);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    if (expires <= Clock::now()) {
+        shard.entries.erase(id);
+        return;
+    }
+    // Recovered sessions arrive out of expiry order, so the queue may drop some of them late;
+    // lookups still check the expiry.
+    shard.entries[id] = Entry{std::string(data), expires};
+    shard.expiry.emplace_back(expires, id);
+}
+
+void SessionStore::for_each(const Visitor& visitor) const {
+    for (std::size_t i = 0; i < shard_count; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        for (const auto& [id, entry] : shards[i].entries) {
+            visitor(id, entry.data, entry.expires);
+        }
+    }
+}
+
+std::size_t SessionStore::size() const {
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < shard_count; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mtx);
+        total += shards[i].entries.size();
+    }
+    return total;
+}
+
+void SessionStore::expire(Shard& shard, Clock::time_point now) {
+    while (!shard.expiry.empty() && shard.expiry.front().first <= now) {
+        auto iter = shard.entries.find(shard.expiry.front().second);
+        // Entries erased or already expired on lookup leave a stale queue record behind.
+        if (iter != shard.entries.end() && iter->second.expires <= now) {
+            shard.entries.erase(iter);
+        }
+        shard.expiry.pop_front();
+    }
+}
+
+std::optional<SessionStore::SessionId> SessionStore::parse_id(std::string_view text) {
+    if (text.size() != 32) {
+        return std::nullopt;
+    }
+    SessionId id{0, 0};
+    for (std::size_t i = 0; i < 32; ++i) {
+        char c = text[i];
+        std::uint64_t nibble;
+        if (c >= '0' && c <= '9') {
+            nibble = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            nibble = c - 'a' + 10;
+        } else {
+            return std::nullopt;
+        }
+        id[i / 16] = (id[i / 16] << 4) | nibble;
+    }
+    return id;
+}
+
+std::string SessionStore::format_id(const SessionId& id) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text(32, '0');
+    for (std::size_t i = 0; i < 32; ++i) {
+        text[i] = digits[(id[i / 16] >> (60 - 4 * (i % 16))) & 0xf];
+    }
+    return text;
+}
+
+std::string_view SessionStore::find_cookie(std::string_view header, std::string_view name) {
+    while (!header.empty()) {
+        std::size_t end = header.find(';');
+        std::string_view pair = header.substr(0, end);
+        header = end == std::string_view::npos ? std::string_view() : header.substr(end + 1);
+
+        std::size_t start = pair.find_first_not_of(' ');
+        if (start == std::string_view::npos) {
+            continue;
+        }
+        pair.remove_prefix(start);
+        std::size_t eq = pair.find('=');
+        if (eq != std::string_view::npos && pair.substr(0, eq) == name) {
+            std::string_view value = pair.substr(eq + 1);
+            std::size_t last = value.find_last_not_of(' ');
+            return last == std::string_view::npos ? std::string_view() : value.substr(0, last + 1);
+        }
+    }
+    return {};
+}
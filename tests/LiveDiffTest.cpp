@@ -0,0 +1,161 @@
+#include "compare/LiveDiff.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr LiveDiff::Limits limits{100000, 10000000};
+
+// Document `document` as the diff sees it, one token per entry that belongs to it.
+std::vector<std::string_view> tokens(const LiveDiff& live, int document) {
+    Operation other = document == 1 ? Operation::INSERT : Operation::DELETE;
+    std::vector<std::string_view> result;
+    for (const LiveDiff::Entry& entry : live.entries()) {
+        if (entry.operation != other) {
+            result.push_back(live.text(entry));
+        }
+    }
+    return result;
+}
+
+// "-word", "+word" and " word" per entry.
+std::string describe(const LiveDiff& live) {
+    std::string out;
+    for (const LiveDiff::Entry& entry : live.entries()) {
+        out += entry.operation == Operation::DELETE ? '-' : entry.operation == Operation::INSERT ? '+' : ' ';
+        out += live.text(entry);
+        out += ';';
+    }
+    return out;
+}
+
+std::size_t equal_count(const LiveDiff& live) {
+    std::size_t count = 0;
+    for (const LiveDiff::Entry& entry : live.entries()) {
+        count += entry.operation == Operation::EQUAL;
+    }
+    return count;
+}
+
+TEST(LiveDiffTest, EditReportsReplacedEntries) {
+    LiveDiff live(limits);
+    live.set(1, "one two three");
+    live.set(2, "one two three");
+    LiveDiff::Change change = live.edit(2, 4, 7, "2");
+    EXPECT_EQ(change.from, 1u);
+    EXPECT_EQ(change.removed, 1u);
+    EXPECT_EQ(change.inserted, 2u);
+    ASSERT_EQ(live.entries().size(), 4u);
+    EXPECT_EQ(live.entries()[1].operation, Operation::DELETE);
+    EXPECT_EQ(live.text(live.entries()[1]), "two");
+    EXPECT_EQ(live.entries()[2].operation, Operation::INSERT);
+    EXPECT_EQ(live.text(live.entries()[2]), "2");
+}
+
+TEST(LiveDiffTest, RejectsEditOutOfRange) {
+    LiveDiff live(limits);
+    live.set(1, "caf\xC3\xA9");
+    EXPECT_THROW(live.edit(1, 2, 9, "x"), std::runtime_error);
+    EXPECT_THROW(live.edit(1, 4, 5, "x"), std::runtime_error);
+    EXPECT_THROW(live.edit(3, 0, 0, "x"), std::runtime_error);
+    EXPECT_EQ(tokens(live, 1), std::vector<std::string_view>{"caf\xC3\xA9"});
+}
+
+// Both documents start as the same words and every edit replaces whole words with words
+// neither document has had, so the words they share are in the same order in both and
+// the shortest diff is unique: the live diff must be exactly what set() computes.
+TEST(LiveDiffTest, WordEditsMatchFullRecompute) {
+    std::mt19937 random(48);
+    int fresh = 0;
+    std::vector<std::string> words[2];
+    for (int k = 0; k < 40; ++k) {
+        words[0].push_back("w" + std::to_string(fresh++));
+    }
+    words[1] = words[0];
+    auto join = [](const std::vector<std::string>& list) {
+        std::string text;
+        for (const std::string& word : list) {
+            text += text.empty() ? "" : " ";
+            text += word;
+        }
+        return text;
+    };
+
+    LiveDiff live(limits);
+    live.set(1, join(words[0]));
+    live.set(2, join(words[1]));
+    for (int round = 0; round < 1000; ++round) {
+        int document = 1 + static_cast<int>(random() % 2);
+        std::vector<std::string>& list = words[document - 1];
+        std::size_t first = random() % list.size();
+        std::size_t last = first + 1 + random() % std::min<std::size_t>(list.size() - first, 3);
+        std::vector<std::string> replacement;
+        for (std::size_t k = random() % 4 + (list.size() - (last - first) < 10); k > 0; --k) {
+            replacement.push_back("w" + std::to_string(fresh++));
+        }
+
+        std::size_t start = 0;
+        for (std::size_t k = 0; k < first; ++k) {
+            start += list[k].size() + 1;
+        }
+        std::size_t end = start + list[first].size();
+        for (std::size_t k = first + 1; k < last; ++k) {
+            end += list[k].size() + 1;
+        }
+        // Removing words takes one of the spaces around them along, as join() would.
+        if (replacement.empty() && last < list.size()) {
+            ++end;
+        } else if (replacement.empty()) {
+            --start;
+        }
+        live.edit(document, start, end, join(replacement));
+        list.erase(list.begin() + first, list.begin() + last);
+        list.insert(list.begin() + first, replacement.begin(), replacement.end());
+
+        LiveDiff full(limits);
+        full.set(1, join(words[0]));
+        full.set(2, join(words[1]));
+        ASSERT_EQ(describe(live), describe(full)) << "round " << round;
+    }
+}
+
+// With repeated words an edit can make the kept alignment around it worse than the best
+// one, so the live diff may be longer than a recomputed one, but it still spells out both
+// documents and never claims more equal words than there are in common.
+TEST(LiveDiffTest, RandomEditsKeepValidDiff) {
+    std::mt19937 random(48);
+    const char* pieces[] = {"a", "b", "c", "d", " ", " ", "  ", "\n"};
+    auto random_text = [&](std::size_t size) {
+        std::string text;
+        while (text.size() < size) {
+            text += pieces[random() % 8];
+        }
+        return text;
+    };
+
+    LiveDiff live(limits);
+    std::string texts[2] = {random_text(60), random_text(60)};
+    live.set(1, texts[0]);
+    live.set(2, texts[1]);
+    for (int round = 0; round < 1000; ++round) {
+        int document = 1 + static_cast<int>(random() % 2);
+        std::string& text = texts[document - 1];
+        std::size_t start = random() % (text.size() + 1);
+        std::size_t end = start + random() % (std::min<std::size_t>(text.size() - start, 6) + 1);
+        std::string replacement = random_text(random() % 5);
+        live.edit(document, start, end, replacement);
+        text.replace(start, end - start, replacement);
+
+        LiveDiff full(limits);
+        full.set(1, texts[0]);
+        full.set(2, texts[1]);
+        ASSERT_EQ(tokens(live, 1), tokens(full, 1)) << "round " << round;
+        ASSERT_EQ(tokens(live, 2), tokens(full, 2)) << "round " << round;
+        ASSERT_LE(equal_count(live), equal_count(full)) << "round " << round;
+    }
+}
+
+} // namespace
@@ -0,0 +1,78 @@
+#include "compare/LongestCommonSubsequence.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+
+namespace {
+
+// "-word", "+word" and " word" per diff entry, space separated.
+std::string describe(const std::pmr::vector<Diff>& diffs) {
+    std::ostringstream out;
+    for (const auto& diff : diffs) {
+        out << (diff.get_operation() == Operation::DELETE ? '-' : diff.get_operation() == Operation::INSERT ? '+' : ' ') << diff.get_text() << ';';
+    }
+    return out.str();
+}
+
+TEST(LongestCommonSubsequenceTest, KeepsPrefixOnlyTheFirstTextHas) {
+    LongestCommonSubsequence lcs;
+    EXPECT_EQ(describe(lcs.stringDiff("x y a b", "a b")), "-x;-y; a; b;");
+}
+
+TEST(LongestCommonSubsequenceTest, KeepsPrefixOnlyTheSecondTextHas) {
+    LongestCommonSubsequence lcs;
+    EXPECT_EQ(describe(lcs.stringDiff("a b", "x a b")), "+x; a; b;");
+}
+
+TEST(LongestCommonSubsequenceTest, DiffsAgainstEmptyText) {
+    LongestCommonSubsequence lcs;
+    EXPECT_EQ(describe(lcs.stringDiff("", "a b")), "+a;+b;");
+    EXPECT_EQ(describe(lcs.stringDiff("a b", "")), "-a;-b;");
+}
+
+TEST(LongestCommonSubsequenceTest, DiffSymbolsCountsLeftoverOperations) {
+    LongestCommonSubsequence lcs;
+    const std::uint32_t first[] = {7, 8, 1, 2};
+    const std::uint32_t second[] = {1, 2, 9};
+    Operation out[7];
+    std::size_t count = lcs.diffSymbols(first, 4, second, 3, out);
+    ASSERT_EQ(count, 5u);
+    EXPECT_EQ(out[0], Operation::DELETE);
+    EXPECT_EQ(out[1], Operation::DELETE);
+    EXPECT_EQ(out[2], Operation::EQUAL);
+    EXPECT_EQ(out[3], Operation::EQUAL);
+    EXPECT_EQ(out[4], Operation::INSERT);
+}
+
+TEST(LongestCommonSubsequenceTest, DiffRebuildsBothTexts) {
+    std::mt19937 random(26);
+    const char* vocabulary[] = {"a", "b", "c", "d"};
+    for (int round = 0; round < 500; ++round) {
+        std::pmr::vector<std::string_view> words1;
+        std::pmr::vector<std::string_view> words2;
+        for (int k = random() % 8; k > 0; --k) {
+            words1.push_back(vocabulary[random() % 4]);
+        }
+        for (int k = random() % 8; k > 0; --k) {
+            words2.push_back(vocabulary[random() % 4]);
+        }
+
+        LongestCommonSubsequence lcs;
+        std::pmr::vector<Diff> diffs = lcs.stringDiffutil(words1, words2);
+        std::pmr::vector<std::string_view> rebuilt1;
+        std::pmr::vector<std::string_view> rebuilt2;
+        for (const auto& diff : diffs) {
+            if (diff.get_operation() != Operation::INSERT) {
+                rebuilt1.push_back(diff.get_text());
+            }
+            if (diff.get_operation() != Operation::DELETE) {
+                rebuilt2.push_back(diff.get_text());
+            }
+        }
+        ASSERT_EQ(rebuilt1, words1);
+        ASSERT_EQ(rebuilt2, words2);
+    }
+}
+
+} // namespace
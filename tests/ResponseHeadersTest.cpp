@@ -0,0 +1,57 @@
+#include "ResponseHeaders.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using boost::beast::http::field;
+
+std::size_t count(const std::string& text, std::string_view needle) {
+    std::size_t found = 0;
+    for (std::size_t at = text.find(needle); at != std::string::npos; at = text.find(needle, at + 1)) {
+        ++found;
+    }
+    return found;
+}
+
+TEST(ResponseHeadersTest, LaterTemplateFieldReplacesEarlierOne) {
+    auto headers = ResponseHeaders::make_template({{field::server, "REST API"}, {field::content_type, "text/plain"}, {field::content_type, "application/json"}});
+    EXPECT_EQ(headers.text, "Server: REST API\r\nContent-Type: application/json\r\n");
+    EXPECT_EQ(headers.fields, (std::vector<field>{field::server, field::content_type}));
+}
+
+TEST(ResponseHeadersTest, CopiesTemplateWhenResponseSetsOtherFields) {
+    auto headers = ResponseHeaders::make_template({{field::server, "REST API"}, {field::content_type, "application/json"}});
+    ResponseHeaders::Response res{boost::beast::http::status::ok, 11};
+    res.set(field::set_cookie, "a=b");
+    res.body() = "{}";
+
+    std::string out;
+    ResponseHeaders::serialize(res, headers, out);
+    EXPECT_EQ(out.rfind("HTTP/1.1 200 OK\r\nServer: REST API\r\nContent-Type: application/json\r\nSet-Cookie: a=b\r\nDate: ", 0), 0u);
+    EXPECT_NE(out.find("Content-Length: 2\r\n\r\n"), std::string::npos);
+}
+
+TEST(ResponseHeadersTest, ResponseFieldReplacesTemplateField) {
+    auto headers = ResponseHeaders::make_template({{field::server, "REST API"}, {field::content_type, "text/plain"}, {field::vary, "Origin"}});
+    ResponseHeaders::Response res{boost::beast::http::status::not_found, 11};
+    res.set(field::content_type, "application/json");
+
+    std::string out;
+    ResponseHeaders::serialize(res, headers, out);
+    EXPECT_EQ(count(out, "Content-Type:"), 1u);
+    EXPECT_NE(out.find("Content-Type: application/json\r\n"), std::string::npos);
+    EXPECT_NE(out.find("Server: REST API\r\nVary: Origin\r\n"), std::string::npos);
+}
+
+TEST(ResponseHeadersTest, ChunkedResponseHasNoContentLength) {
+    ResponseHeaders::Response res{boost::beast::http::status::ok, 11};
+    res.body() = "partial";
+
+    std::string out;
+    ResponseHeaders::serialize(res, ResponseHeaders::Template(), out, true);
+    EXPECT_NE(out.find("Transfer-Encoding: chunked\r\n"), std::string::npos);
+    EXPECT_EQ(out.find("Content-Length"), std::string::npos);
+}
+
+} // namespace
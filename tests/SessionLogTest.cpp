@@ -0,0 +1,235 @@
+#include "session/SessionLog.h"
+#include "session/SessionStore.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <map>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = SessionStore::Clock;
+
+SessionStore::SessionId session(std::uint64_t n) {
+    return {n, n};
+}
+
+// Writes records in the log's on-disk layout (see SessionLog.cpp), so tests can build
+// logs with torn or corrupt records that the writer itself never produces.
+std::string encode_put(const SessionStore::SessionId& id, std::string_view data, Clock::time_point expires) {
+    std::string payload(1, '\1');
+    std::int64_t expires_ms = std::chrono::duration_cast<std::chrono::milliseconds>(expires.time_since_epoch()).count();
+    payload.append(reinterpret_cast<const char*>(&id[0]), 8);
+    payload.append(reinterpret_cast<const char*>(&id[1]), 8);
+    payload.append(reinterpret_cast<const char*>(&expires_ms), 8);
+    payload.append(data);
+
+    std::uint32_t hash = 2166136261u;
+    for (char c : payload) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    std::uint32_t size = static_cast<std::uint32_t>(payload.size());
+    std::string record(reinterpret_cast<const char*>(&hash), 4);
+    record.append(reinterpret_cast<const char*>(&size), 4);
+    return record + payload;
+}
+
+class SessionLogTest : public testing::Test {
+protected:
+    void SetUp() override {
+        char pattern[] = "/tmp/session_log_test.XXXXXX";
+        ASSERT_NE(::mkdtemp(pattern), nullptr);
+        directory = pattern;
+        options.directory = directory;
+        options.commit_interval = std::chrono::milliseconds(1);
+    }
+
+    void TearDown() override { std::filesystem::remove_all(directory); }
+
+    std::string path(const char* name) const { return directory + "/" + name; }
+
+    void write_file(const char* name, const std::string& content) const {
+        std::ofstream(path(name), std::ios::binary) << content;
+    }
+
+    // Live sessions after recovering the directory, by id.
+    std::map<SessionStore::SessionId, std::string> recover() const {
+        SessionStore store(4, std::chrono::hours(1));
+        SessionLog log(options);
+        log.recover([&](const SessionStore::SessionId& id, std::string_view data, Clock::time_point expires) {
+            store.restore(id, data, expires);
+        });
+        std::map<SessionStore::SessionId, std::string> sessions;
+        store.for_each([&](const SessionStore::SessionId& id, std::string_view data, Clock::time_point) { sessions.emplace(id, data); });
+        return sessions;
+    }
+
+    // Opens the directory the way main() does, runs `mutate` and flushes.
+    void run(const std::function<void(SessionStore&)>& mutate, bool compact = true) const {
+        run([&](SessionStore& store, SessionLog&) { mutate(store); }, compact);
+    }
+
+    void run(const std::function<void(SessionStore&, SessionLog&)>& mutate, bool compact = true) const {
+        auto store = std::make_shared<SessionStore>(4, std::chrono::hours(1));
+        auto log = std::make_shared<SessionLog>(options);
+        log->recover([&](const SessionStore::SessionId& id, std::string_view data, Clock::time_point expires) {
+            store->restore(id, data, expires);
+        });
+        store->set_log(log);
+        log->start([store = std::weak_ptr<SessionStore>(store)](const SessionStore::Visitor& visitor) {
+            auto locked = store.lock();
+            if (locked) {
+                locked->for_each(visitor);
+            }
+            return locked != nullptr;
+        }, compact);
+        mutate(*store, *log);
+        EXPECT_TRUE(log->flush());
+    }
+
+    std::string directory;
+    SessionLog::Options options;
+};
+
+TEST_F(SessionLogTest, RecoversPutsAndErases) {
+    std::string kept;
+    run([&](SessionStore& store) {
+        kept = store.create("kept");
+        std::string updated = store.create("before");
+        store.update(updated, "after");
+        store.erase(store.create("erased"));
+    });
+
+    auto sessions = recover();
+    ASSERT_EQ(sessions.size(), 2u);
+    EXPECT_EQ(sessions[*SessionStore::parse_id(kept)], "kept");
+    EXPECT_EQ(std::count_if(sessions.begin(), sessions.end(), [](const auto& entry) { return entry.second == "after"; }), 1);
+}
+
+TEST_F(SessionLogTest, CutsOffTornRecordAtTheEnd) {
+    auto expires = Clock::now() + std::chrono::hours(1);
+    std::string good = encode_put(session(1), "one", expires) + encode_put(session(2), "two", expires);
+    std::string torn = encode_put(session(3), "three", expires);
+    write_file("sessions.log", good + torn.substr(0, torn.size() - 2));
+
+    auto sessions = recover();
+    EXPECT_EQ(sessions.size(), 2u);
+    EXPECT_EQ(sessions.count(session(3)), 0u);
+    EXPECT_EQ(std::filesystem::file_size(path("sessions.log")), good.size());
+}
+
+TEST_F(SessionLogTest, DropsTrailingRecordWithBadChecksum) {
+    auto expires = Clock::now() + std::chrono::hours(1);
+    std::string good = encode_put(session(1), "one", expires);
+    std::string corrupt = encode_put(session(2), "two", expires);
+    corrupt.back() ^= 1;
+    write_file("sessions.log", good + corrupt);
+
+    auto sessions = recover();
+    ASSERT_EQ(sessions.size(), 1u);
+    EXPECT_EQ(sessions.begin()->second, "one");
+    EXPECT_EQ(std::filesystem::file_size(path("sessions.log")), good.size());
+}
+
+TEST_F(SessionLogTest, KeepsRecordsWrittenAfterTornTail) {
+    auto expires = Clock::now() + std::chrono::hours(1);
+    std::string torn = encode_put(session(3), "three", expires);
+    write_file("sessions.log", encode_put(session(1), "one", expires) + torn.substr(0, 5));
+
+    std::string later;
+    run([&](SessionStore& store) { later = store.create("later"); });
+    run([&](SessionStore& store) { store.update(later, "updated"); });
+
+    auto sessions = recover();
+    ASSERT_EQ(sessions.size(), 2u);
+    EXPECT_EQ(sessions[session(1)], "one");
+    EXPECT_EQ(sessions[*SessionStore::parse_id(later)], "updated");
+}
+
+TEST_F(SessionLogTest, RetriesBatchThatFailedToWrite) {
+    // A file size limit makes writes past it fail with EFBIG, after writing what fits.
+    rlimit unlimited{};
+    ASSERT_EQ(::getrlimit(RLIMIT_FSIZE, &unlimited), 0);
+    auto previous_handler = std::signal(SIGXFSZ, SIG_IGN);
+    rlimit limited = unlimited;
+    limited.rlim_cur = 1000;
+    ASSERT_EQ(::setrlimit(RLIMIT_FSIZE, &limited), 0);
+
+    std::vector<std::string> ids;
+    std::thread lift;
+    run([&](SessionStore& store) {
+        for (int i = 0; i < 3; ++i) {
+            ids.push_back(store.create(std::string(600, static_cast<char>('a' + i))));
+        }
+        // flush() must wait for the retry instead of reporting the failed batch durable.
+        lift = std::thread([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            ::setrlimit(RLIMIT_FSIZE, &unlimited);
+        });
+    });
+    lift.join();
+    ::setrlimit(RLIMIT_FSIZE, &unlimited);
+    std::signal(SIGXFSZ, previous_handler);
+
+    auto sessions = recover();
+    ASSERT_EQ(sessions.size(), 3u);
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(sessions[*SessionStore::parse_id(ids[i])], std::string(600, static_cast<char>('a' + i)));
+    }
+}
+
+TEST_F(SessionLogTest, LeavesLogsAloneWithoutStartupCompaction) {
+    auto expires = Clock::now() + std::chrono::hours(1);
+    std::string log = encode_put(session(1), "one", expires);
+    write_file("sessions.log", log);
+
+    std::string later;
+    run([&](SessionStore& store) { later = store.create("later"); }, false);
+
+    EXPECT_FALSE(std::filesystem::exists(path("sessions.snapshot")));
+    EXPECT_GT(std::filesystem::file_size(path("sessions.log")), log.size());
+    EXPECT_EQ(recover().size(), 2u);
+}
+
+TEST_F(SessionLogTest, HandsOverOnSuspend) {
+    std::string before;
+    std::string during;
+    run([&](SessionStore& store, SessionLog& log) {
+        before = store.create("before");
+        log.suspend();
+        during = store.create("during");
+
+        // What the new process would see.
+        auto sessions = recover();
+        EXPECT_EQ(sessions.size(), 1u);
+        EXPECT_EQ(sessions.count(*SessionStore::parse_id(before)), 1u);
+
+        // A failed restart logs what was kept meanwhile.
+        log.resume();
+    });
+
+    auto sessions = recover();
+    EXPECT_EQ(sessions.size(), 2u);
+    EXPECT_EQ(sessions[*SessionStore::parse_id(during)], "during");
+}
+
+TEST_F(SessionLogTest, ReplaysSnapshotThenLogs) {
+    auto expires = Clock::now() + std::chrono::hours(1);
+    write_file("sessions.snapshot", encode_put(session(1), "snapshot", expires) + encode_put(session(2), "snapshot", expires));
+    write_file("sessions.log.old", encode_put(session(1), "old log", expires));
+    write_file("sessions.log", encode_put(session(2), "log", expires));
+
+    auto sessions = recover();
+    ASSERT_EQ(sessions.size(), 2u);
+    EXPECT_EQ(sessions[session(1)], "old log");
+    EXPECT_EQ(sessions[session(2)], "log");
+}
+
+} // namespace
@@ -0,0 +1,88 @@
+#include "compare/LongestCommonSubsequence.h"
+#include "compare/ThreeWayMerge.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+class ThreeWayMergeTest : public testing::Test {
+protected:
+    ThreeWayMerge::Result merge(std::string_view base, std::string_view ours, std::string_view theirs) {
+        LongestCommonSubsequence lcs;
+        auto base_words = lcs.splitWords(base);
+        auto ours_words = lcs.splitWords(ours);
+        auto theirs_words = lcs.splitWords(theirs);
+        return ThreeWayMerge(pool).merge({base, base_words}, {ours, ours_words}, {theirs, theirs_words});
+    }
+
+    WorkStealingPool pool{2};
+};
+
+TEST_F(ThreeWayMergeTest, TakesEditsOfBothSidesThatDoNotOverlap) {
+    auto result = merge("one two three four five", "one 2 three four five", "one two three four 5");
+    EXPECT_EQ(std::string_view(result.text), "one 2 three four 5");
+    EXPECT_TRUE(result.conflicts.empty());
+}
+
+TEST_F(ThreeWayMergeTest, TakesTheSameEditOnBothSidesOnce) {
+    auto result = merge("one two three", "one 2 three", "one 2 three");
+    EXPECT_EQ(std::string_view(result.text), "one 2 three");
+    EXPECT_TRUE(result.conflicts.empty());
+}
+
+TEST_F(ThreeWayMergeTest, ReportsOverlappingEditsAsConflict) {
+    auto result = merge("one two three four", "one 2 three four", "one zwei drei four");
+    EXPECT_EQ(std::string_view(result.text), "one 2 three four");
+    ASSERT_EQ(result.conflicts.size(), 1u);
+    const ThreeWayMerge::Conflict& conflict = result.conflicts[0];
+    EXPECT_EQ(conflict.base, "two three");
+    EXPECT_EQ(conflict.ours, "2 three");
+    EXPECT_EQ(conflict.theirs, "zwei drei");
+    EXPECT_EQ(std::string_view(result.text).substr(conflict.begin, conflict.end - conflict.begin), "2 three");
+}
+
+// A word brings the whitespace that follows it on its side.
+TEST_F(ThreeWayMergeTest, KeepsWhitespaceOfTheSideEachWordComesFrom) {
+    auto result = merge("a b c", "a\nb c", "a b  C");
+    EXPECT_EQ(std::string_view(result.text), "a\nb C");
+    EXPECT_TRUE(result.conflicts.empty());
+}
+
+// Ours and theirs each replace some of the base's distinct words, never the same ones
+// and never neighbours, so every merge is clean and has both sides' replacements.
+TEST_F(ThreeWayMergeTest, MergesRandomDisjointEdits) {
+    std::mt19937 random(48);
+    for (int round = 0; round < 200; ++round) {
+        std::vector<std::string> base;
+        for (int k = 0; k < 30; ++k) {
+            base.push_back("w" + std::to_string(k));
+        }
+        std::vector<std::string> ours = base;
+        std::vector<std::string> theirs = base;
+        std::vector<std::string> merged = base;
+        for (std::size_t k = 0; k < base.size(); k += 2 + random() % 3) {
+            std::vector<std::string>& side = random() % 2 ? ours : theirs;
+            side[k] = merged[k] = "x" + std::to_string(k);
+        }
+        auto join = [](const std::vector<std::string>& words) {
+            std::string text;
+            for (const std::string& word : words) {
+                text += text.empty() ? "" : " ";
+                text += word;
+            }
+            return text;
+        };
+        std::string base_text = join(base);
+        std::string ours_text = join(ours);
+        std::string theirs_text = join(theirs);
+
+        auto result = merge(base_text, ours_text, theirs_text);
+        ASSERT_EQ(std::string_view(result.text), join(merged)) << "round " << round;
+        ASSERT_TRUE(result.conflicts.empty()) << "round " << round;
+    }
+}
+
+} // namespace
@@ -0,0 +1,64 @@
+#include "compare/LongestCommonSubsequence.h"
+#include "compare/Similarity.h"
+#include "compare/UnifiedDiff.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+
+namespace {
+
+// The unified diff of two texts, as /compare builds it with "unified": true.
+std::string diff(std::string_view text1, std::string_view text2, std::size_t context = 3) {
+    LongestCommonSubsequence lcs;
+    auto lines1 = lcs.splitLines(text1);
+    auto lines2 = lcs.splitLines(text2);
+    std::pmr::vector<std::uint32_t> symbols1;
+    std::pmr::vector<std::uint32_t> symbols2;
+    encode_words(lines1, lines2, symbols1, symbols2, std::pmr::get_default_resource());
+    std::pmr::vector<Operation> operations(lines1.size() + lines2.size());
+    std::size_t count = lcs.diffSymbols(symbols1.data(), lines1.size(), symbols2.data(), lines2.size(), operations.data());
+    std::string out = "--- a\n+++ b\n";
+    write_unified_diff(lines1, lines2, operations.data(), count, context, out);
+    return out;
+}
+
+TEST(UnifiedDiffTest, WritesHunkWithContext) {
+    EXPECT_EQ(diff("a\nb\nc\nd\ne\n", "a\nb\nC\nd\ne\n", 1), "--- a\n+++ b\n@@ -2,3 +2,3 @@\n b\n-c\n+C\n d\n");
+}
+
+TEST(UnifiedDiffTest, MarksMissingNewlineAtEnd) {
+    EXPECT_EQ(diff("a\nb", "a\nb\n", 0), "--- a\n+++ b\n@@ -2 +2 @@\n-b\n\\ No newline at end of file\n+b\n");
+}
+
+TEST(UnifiedDiffTest, EqualTextsHaveNoHunks) {
+    EXPECT_EQ(diff("a\nb\n", "a\nb\n"), "--- a\n+++ b\n");
+}
+
+TEST(UnifiedDiffTest, RejectsPatchThatDoesNotMatchBase) {
+    std::string patch = diff("a\nb\nc\n", "a\nB\nc\n");
+    EXPECT_THROW(apply_unified_diff("a\nx\nc\n", patch), std::runtime_error);
+    EXPECT_THROW(apply_unified_diff("a\n", patch), std::runtime_error);
+    EXPECT_THROW(apply_unified_diff("a\nb\nc\n", "@@ -1 +1\n"), std::runtime_error);
+}
+
+TEST(UnifiedDiffTest, ApplyingDiffGivesSecondText) {
+    std::mt19937 random(48);
+    const char* lines[] = {"a\n", "b\n", "c\n", "\n", "d"};
+    auto random_text = [&]() {
+        std::string text;
+        for (int k = random() % 12; k > 0; --k) {
+            text += lines[random() % 5];
+        }
+        return text;
+    };
+    for (int round = 0; round < 2000; ++round) {
+        std::string text1 = random_text();
+        std::string text2 = random_text();
+        std::size_t context = random() % 4;
+        std::pmr::string applied = apply_unified_diff(text1, diff(text1, text2, context));
+        ASSERT_EQ(std::string_view(applied), text2) << "round " << round << " context " << context;
+    }
+}
+
+} // namespace
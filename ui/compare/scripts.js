@@ -50,3 +50,84 @@ async function compareStrings(event) {
         console.error('Error:', error);
     }
 }
+
+// Live diff: the server keeps both texts and answers every edit with the part of the diff
+// that changed (/compare/live); the Compare button still runs a full diff.
+const liveDiff = {
+    socket: null,
+    sent: {1: null, 2: null}, // Text of each side as the server has it
+    result: [],
+};
+
+function utf8Length(str) {
+    return new TextEncoder().encode(str).length;
+}
+
+function sendEdit(doc, text) {
+    const socket = liveDiff.socket;
+    if (!socket || socket.readyState !== WebSocket.OPEN) {
+        return;
+    }
+    const previous = liveDiff.sent[doc];
+    liveDiff.sent[doc] = text;
+    if (previous === null) {
+        socket.send(JSON.stringify({type: 'set', doc: doc, text: text}));
+        return;
+    }
+    if (previous === text) {
+        return;
+    }
+
+    // Send only the replaced range, with offsets in UTF-8 bytes as the server counts them.
+    const max = Math.min(previous.length, text.length);
+    let start = 0;
+    while (start < max && previous[start] === text[start]) {
+        start++;
+    }
+    let end = 0;
+    while (end < max - start && previous[previous.length - 1 - end] === text[text.length - 1 - end]) {
+        end++;
+    }
+    // Don't split a surrogate pair.
+    if (start > 0 && previous.charCodeAt(start - 1) >= 0xD800 && previous.charCodeAt(start - 1) <= 0xDBFF) {
+        start--;
+    }
+    if (end > 0 && previous.charCodeAt(previous.length - end) >= 0xDC00 && previous.charCodeAt(previous.length - end) <= 0xDFFF) {
+        end--;
+    }
+    const byteStart = utf8Length(previous.slice(0, start));
+    const byteEnd = byteStart + utf8Length(previous.slice(start, previous.length - end));
+    socket.send(JSON.stringify({type: 'edit', doc: doc, start: byteStart, end: byteEnd, text: text.slice(start, text.length - end)}));
+}
+
+function applyPatch(message) {
+    if (message.type !== 'patch') {
+        // The server kept its texts; send both in full with the next edit.
+        console.error('Live diff error: ', message.message);
+        liveDiff.sent = {1: null, 2: null};
+        return;
+    }
+    liveDiff.result = liveDiff.result.slice(0, message.from).concat(message.insert, liveDiff.result.slice(message.from + message.remove));
+    document.getElementById('result').innerHTML = updateColourofStrings(liveDiff.result);
+}
+
+function connectLiveDiff() {
+    const scheme = location.protocol === 'https:' ? 'wss://' : 'ws://';
+    const socket = new WebSocket(scheme + (location.host || 'localhost:8080') + '/compare/live');
+    socket.onopen = () => {
+        liveDiff.sent = {1: null, 2: null};
+        liveDiff.result = [];
+        sendEdit(1, document.getElementById('left-half').textContent);
+        sendEdit(2, document.getElementById('right-half').textContent);
+    };
+    socket.onmessage = (event) => applyPatch(JSON.parse(event.data));
+    socket.onclose = () => {
+        liveDiff.socket = null;
+        setTimeout(connectLiveDiff, 2000);
+    };
+    liveDiff.socket = socket;
+}
+
+document.getElementById('left-half').addEventListener('input', (event) => sendEdit(1, event.target.textContent));
+document.getElementById('right-half').addEventListener('input', (event) => sendEdit(2, event.target.textContent));
+connectLiveDiff();